@@ -18,12 +18,28 @@
 // This program can be run with more than one thread. Most parts of
 // the program have been threaded except for data I/O and random
 // number generation. The program accepts the following compile-time
-// macros: -DUSE_OPENBLAS -DUSE_OPENMP .
+// macros: -DUSE_OPENBLAS -DUSE_OPENMP -DUSE_MEMTRACK . With
+// -DUSE_MEMTRACK, the real heap usage (current and peak bytes per
+// subsystem) is reported after each phase; see Misc/MemTrack.hpp.
+//
+// With -DUSE_MPI (compile with mpicxx), the program runs over MPI
+// processes, e.g., mpirun -np 4 KRR_OneVsAll_RandBin.ex ... Each
+// process bins only its consecutive block of train and test rows; the
+// bin dictionaries are merged into global column indices of the
+// feature matrix Z (see random_binning_feature_dist in
+// randFeature.hpp), without any process holding all the binned rows
+// or all the dictionaries. In PCG, each process computes Z_i'(Z_i p) for
+// its block Z_i and the M-length results are summed with one
+// allreduce per iteration (see Matrices/DistSPointArray.hpp); the
+// test predictions are gathered on process 0, which prints the
+// output. NumThreads is the number of threads per process.
 //
 // Usage:
 //
 //   KRR_OneVsAll_RandBin.ex NumThreads FileTrain FileTest NumClasses 
-//   d r Seed Num_lambda List_lambda Num_sigma List_sigma
+//   d r Seed Num_lambda List_lambda Num_sigma List_sigma MAXIT TOL
+//   verbose [Dedup] [Nested] [Packed] [EarlyStop] [ValFrac] [Patience]
+//   [GCV] [Checkpoint] [CkptEvery]
 //
 //   NumThreads:  Number of threads
 //   FileTrain:   File name (including path) of train data
@@ -38,6 +54,62 @@
 //   List_lambda: List of lambda's (Regularization)
 //   Num_sigma:   Number of sigma's for parameter tuning
 //   List_sigma:  List of sigma's (Kernel function)
+//   MAXIT:       Maximum number of PCG iterations
+//   TOL:         PCG relative residual tolerance
+//   verbose:     Print the PCG residuals and binning statistics
+//   Dedup:       Optional. If 1, the train rows that fall in the same
+//                bin in every grid (identical rows of Z) are merged
+//                into one row scaled by sqrt(count), which leaves Z'Z
+//                and Z'y unchanged. At small sigma, the number of rows
+//                can shrink by orders of magnitude.
+//   Nested:      Optional. If 1, the grids of all the sigma's are
+//                nested coarsenings of the grids of the largest sigma
+//                and the features of all the sigma's are generated in
+//                one pass over the data, before the first lambda (see
+//                random_binning_feature_nested in randFeature.hpp).
+//                Each sigma is rounded to the nearest
+//                sigma_max/2^l, which is the value printed in the
+//                output. Not available with -DUSE_MPI.
+//   Packed:      Optional. If 1, the train and test features are
+//                stored as a PackedBinMatrix (see
+//                Matrices/PackedBinMatrix.hpp): the bin of each row in
+//                each grid takes the bit width of the number of bins of
+//                the grid, instead of an index and a value (12 bytes)
+//                in an SPointArray, and is decoded on the fly in PCG
+//                and in the predictions. The memory of both formats is
+//                printed.
+//   EarlyStop:   Optional. If k > 0, the last ValFrac of the train
+//                rows are held out (not trained on) and, every k PCG
+//                iterations, the mean squared error of their
+//                predictions is computed; PCG stops when it has not
+//                decreased for Patience checks, and the iterate of the
+//                smallest error is used (see
+//                Solvers/ValidationStop.hpp). Not available with
+//                -DUSE_MPI.
+//   ValFrac:     Optional. Fraction of held-out train rows (default
+//                0.1).
+//   Patience:    Optional. Default 2.
+//   GCV:         Optional. If k > 0, lambda is selected among
+//                List_lambda by generalized cross-validation on the
+//                train rows, for each sigma, and the system is solved
+//                for that lambda only. GCV is estimated for all the
+//                lambda's at once from k-step Lanczos (Golub-Kahan)
+//                quadratures of Z: one started at each label column
+//                for the residuals and GCV_PROBES started at random
+//                +-1 vectors for the trace (see Solvers/GCV.hpp). The
+//                GCV of each lambda is printed. Not available with
+//                -DUSE_MPI.
+//   Checkpoint:  Optional. File name of the PCG checkpoints ("-" for
+//                none). The state of the running solve is written
+//                every CkptEvery seconds by a background thread, and
+//                each solution to the log Checkpoint.sol (see
+//                Solvers/Checkpoint.hpp). A run with the same arguments,
+//                e.g., after the job was killed, takes the solutions of
+//                the log and resumes the interrupted solve from its
+//                state; the features are generated again, identically
+//                (same seed). With -DUSE_MPI, process 0 writes and all
+//                the processes read.
+//   CkptEvery:   Optional. Default 600 seconds.
 
 #include "randFeature.hpp"
 #include "LibCMatrix.hpp"
@@ -46,6 +118,7 @@
 typedef enum { IsotropicGaussian, IsotropicLaplace, ProdLaplace } KERNEL;
 
 #define TWO_PI 6.28318530717958647692
+#define GCV_PROBES 8 // random probes of the trace estimate of GCV
 
 //--------------------------------------------------------------------------
 //int ReadData(const char *filename, double **X, int **y, int d, int *n);
@@ -59,6 +132,36 @@ void MultivariateStudentT1(double *a, int n);
 // ytest to a matrix Ytest.
 void ConvertYtrain(const DVector &ytrain, DMatrix &Ytrain, int NumClasses);
 
+#ifdef USE_MPI
+// Gather on process 0 the local rows of y (resp. Y) of all the
+// processes, in the order of the ranks; n is the total number of
+// rows. On the other processes, y (resp. Y) is unchanged.
+void GatherRows(DVector &y, long n);
+void GatherRows(DMatrix &Y, long n);
+#endif
+
+// Convert the rows istart to istart+n-1 of the random binning
+// features (r nonzeros per row, 1-based indices) to an SPointArray of
+// dimension dd. The arrays are allocated (and cleared) by
+// SPointArray::Init inside the library, on the calling thread; the
+// rows are then filled in parallel.
+void ConvertToSPointArray(vector< vector< pair<int,double> > > &instances,
+                          long istart, long n, int r, long dd,
+                          SPointArray &X);
+
+// Same as above for the rows 0 to n-1 grouped by group_binning_rows
+// (see randFeature.hpp): one row per group, the first of the group,
+// scaled by sqrt(count).
+void ConvertToSPointArray(vector< vector< pair<int,double> > > &instances,
+                          const vector<long> &group,
+                          const vector<long> &count, int r, long dd,
+                          SPointArray &X);
+
+// yc(u) = sum of y(i) over the rows i of group u, divided by
+// sqrt(count(u)), so that Zc'*yc = Z'*y for the grouped Zc.
+void GroupLabels(const DVector &y, const vector<long> &group,
+                 const vector<long> &count, DVector &yc);
+
 // If NumClasses = 1 (regression), return relative error. If
 // NumClasses = 2 (binary classification), return accuracy% (between 0
 // and 100).
@@ -74,6 +177,14 @@ double Performance(const DVector &ytest_truth, const DMatrix &Ytest_predict,
 //--------------------------------------------------------------------------
 int main(int argc, char **argv) {
 
+  // Processes
+  int MpiRank = 0, MpiSize = 1;
+#ifdef USE_MPI
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &MpiRank);
+  MPI_Comm_size(MPI_COMM_WORLD, &MpiSize);
+#endif
+
   // Temporary variables
   long int i, j, k, ii, idx = 1;
 
@@ -97,6 +208,32 @@ int main(int argc, char **argv) {
   int MAXIT = atoi(argv[idx++]);
   double TOL = atof(argv[idx++]);
   bool verbose = atoi(argv[idx++]);
+  bool Dedup = idx < argc ? atoi(argv[idx++]) : 0;
+  bool Nested = idx < argc ? atoi(argv[idx++]) : 0;
+  bool Packed = idx < argc ? atoi(argv[idx++]) : 0;
+  int EarlyStop = idx < argc ? atoi(argv[idx++]) : 0;
+  double ValFrac = idx < argc ? atof(argv[idx++]) : 0.1;
+  int Patience = idx < argc ? atoi(argv[idx++]) : 2;
+  int GCVSteps = idx < argc ? atoi(argv[idx++]) : 0;
+  char *CkptFile = idx < argc ? argv[idx++] : NULL;
+  double CkptEvery = idx < argc ? atof(argv[idx++]) : 600.0;
+  if (CkptFile && strcmp(CkptFile, "-") == 0) {
+    CkptFile = NULL;
+  }
+#ifdef USE_MPI
+  if (Nested && MpiRank == 0) {
+    printf("RandBinning: Nested grids are not available with MPI; ignored\n"); fflush(stdout);
+  }
+  Nested = 0;
+  if (EarlyStop && MpiRank == 0) {
+    printf("RandBinning: EarlyStop is not available with MPI; ignored\n"); fflush(stdout);
+  }
+  EarlyStop = 0;
+  if (GCVSteps && MpiRank == 0) {
+    printf("RandBinning: GCV is not available with MPI; ignored\n"); fflush(stdout);
+  }
+  GCVSteps = 0;
+#endif
 
   // Threading
 #ifdef USE_OPENBLAS
@@ -111,6 +248,7 @@ int main(int argc, char **argv) {
 
   PREPARE_CLOCK(1);
   START_CLOCK;
+  MemTrackSetTag(MEM_DATA);
 
   // Read in X = Xtrain (n*d), y = ytrain (n*1),
   //     and X0 = Xtest (m*d), y0 = ytest (m*1)
@@ -120,15 +258,29 @@ int main(int argc, char **argv) {
   DVector ytest;            // Testing labels (ground truth)
 
   if (ReadData(FileTrain, Xtrain, ytrain, d) == 0) {
+#ifdef USE_MPI
+    MPI_Abort(MPI_COMM_WORLD, 1);
+#endif
     return -1;
   }
   if (ReadData(FileTest, Xtest, ytest, d) == 0) {
+#ifdef USE_MPI
+    MPI_Abort(MPI_COMM_WORLD, 1);
+#endif
     return -1;
   }
 
   END_CLOCK;
-  printf("RandBinning: time loading data = %g seconds, n train = %ld, m test = %ld, num threads = %d\n", 
-        ELAPSED_TIME, Xtrain.GetN(), Xtest.GetN(), NumThreads); fflush(stdout);
+  if (MpiRank == 0) {
+    printf("RandBinning: time loading data = %g seconds, n train = %ld, m test = %ld, num threads = %d\n", 
+          ELAPSED_TIME, Xtrain.GetN(), Xtest.GetN(), NumThreads); fflush(stdout);
+  }
+  MemTrackReport("Load");
+#ifdef USE_MPI
+  if (MpiRank == 0) {
+    printf("RandBinning: MPI. num processes = %d\n", MpiSize); fflush(stdout);
+  }
+#endif
 
   // For multiclass classification, need to convert a single vector
   // ytrain to a matrix Ytrain. The "predictions" are stored in the
@@ -138,9 +290,21 @@ int main(int argc, char **argv) {
     ConvertYtrain(ytrain, Ytrain, NumClasses);
   }
 
+  // Checkpoints of the solves, and solutions of a previous run
+  PCGCheckpoint Ckpt(CkptFile, CkptEvery, MpiRank == 0);
+  if (CkptFile && MpiRank == 0) {
+    printf("RandBinning: Checkpoint. file = %s, every %g seconds, solutions logged = %ld\n",
+           CkptFile, CkptEvery, Ckpt.GetNumLogged()); fflush(stdout);
+  }
+
   int Seed = 0; // initialize seed as zero
-  // Loop over List_lambda
-  for (ii = 0; ii < Num_lambda; ii++) {
+  // Nested: the features and statistics of all the sigma's, generated
+  // at the first iteration, and the rounded sigma's
+  vector< vector< vector< pair<int,double> > > > NestedNew;
+  vector<BinningStats> NestedStats;
+  vector<double> NestedSigma;
+  // Loop over List_lambda; with GCV, lambda is selected for each sigma
+  for (ii = 0; ii < (GCVSteps > 0 ? 1 : Num_lambda); ii++) {
     double lambda = List_lambda[ii];
     // Loop over List_sigma
     for (k = 0; k < Num_sigma; k++) {
@@ -150,11 +314,22 @@ int main(int argc, char **argv) {
 
     double TimeTrain = 0;
     double TimeTest = 0;
+    MemTrackResetPeak();
+    MemTrackSetTag(MEM_DATA);
     START_CLOCK;
-    // Generate feature matrix Xdata_randbin given Xdata
+    // Generate feature matrix Xdata_randbin given Xdata; with MPI,
+    // only for the block of train and test rows of this process
     vector< vector< pair<int,double> > > instances_old, instances_new;
     long Xtrain_N = Xtrain.GetN();
-    for(i=0;i<Xtrain_N;i++){
+    long Xtest_N = Xtest.GetN();
+    long Train_i0 = Xtrain_N*MpiRank/MpiSize;
+    long Train_n = Xtrain_N*(MpiRank+1)/MpiSize - Train_i0;
+    long Test_i0 = Xtest_N*MpiRank/MpiSize;
+    long Test_n = Xtest_N*(MpiRank+1)/MpiSize - Test_i0;
+    // EarlyStop: the rows Fit_n to Train_n-1 are held out
+    long Val_n = EarlyStop > 0 ? (long)(Train_n*ValFrac) : 0;
+    long Fit_n = Train_n - Val_n;
+    for(i=Train_i0;i<Train_i0+Train_n;i++){
       instances_old.push_back(vector<pair<int,double> >());
       for(j=0;j<d;j++){
         int index = j+1;
@@ -164,8 +339,7 @@ int main(int argc, char **argv) {
           instances_old.back().push_back(pair<int,double>(index, myXtrain_feature));
       }
     }
-    long Xtest_N = Xtest.GetN();
-    for(i=0;i<Xtest_N;i++){
+    for(i=Test_i0;i<Test_i0+Test_n;i++){
       instances_old.push_back(vector<pair<int,double> >());
       for(j=0;j<d;j++){
         int index = j+1;
@@ -177,56 +351,173 @@ int main(int argc, char **argv) {
     }
     END_CLOCK;
     TimeTrain += ELAPSED_TIME;
-    printf("RandBinning: Train. Time (in seconds) for converting data format: %g\n", ELAPSED_TIME);fflush(stdout);
+    if (MpiRank == 0) {
+      printf("RandBinning: Train. Time (in seconds) for converting data format: %g\n", ELAPSED_TIME);fflush(stdout);
+    }
      
      // add 0 feature for Enxu's code
     START_CLOCK;
     double gamma = 1/sigma;
-    random_binning_feature(d+1, r, instances_old, instances_new, sigma);
+#ifdef USE_MPI
+    long int dd = random_binning_feature_dist(d+1, r, instances_old, instances_new, sigma);
+#else
+    // The bin counts and Z'Y are accumulated while binning, so that the
+    // right-hand sides need no pass over Z
+    BinningStats stats;
+    DMatrix Yfit; // EarlyStop: labels of the rows trained on
+    stats.n = Fit_n;
+    stats.m = NumClasses > 2 ? NumClasses : 1;
+    stats.Y = NumClasses > 2 ? Ytrain.GetPointer() : ytrain.GetPointer();
+    if (NumClasses > 2 && Val_n > 0) {
+      Ytrain.GetBlock(0, Fit_n, 0, NumClasses, Yfit);
+      stats.Y = Yfit.GetPointer();
+    }
+    if (Nested) {
+      if (NestedNew.empty()) {
+        NestedStats.assign(1, stats);
+        random_binning_feature_nested(d+1, r, instances_old, NestedNew,
+                                      vector<double>(List_sigma, List_sigma+Num_sigma),
+                                      NestedSigma, &NestedStats);
+      }
+      // borrowed for this iteration, returned at its end
+      instances_new.swap(NestedNew[k]);
+      std::swap(stats, NestedStats[k]);
+      sigma = NestedSigma[k];
+    }
+    else {
+      random_binning_feature(d+1, r, instances_old, instances_new, sigma, &stats);
+    }
+#endif
     END_CLOCK;
     TimeTrain += ELAPSED_TIME;
-    printf("RandBinning: Train. Time (in seconds) for generating random binning features: %g\n", ELAPSED_TIME);fflush(stdout);
+    if (MpiRank == 0) {
+      printf("RandBinning: Train. Time (in seconds) for generating random binning features: %g\n", ELAPSED_TIME);fflush(stdout);
+    }
+#ifndef USE_MPI
+    if (verbose) {
+      // Bins per grid and train rows per nonempty bin
+      long MinBins = LONG_MAX, MaxBins = 0, Empty = 0, Single = 0;
+      for (j = 0; j < r; j++) {
+        long nb = stats.grid_offset[j+1] - stats.grid_offset[j];
+        MinBins = nb < MinBins ? nb : MinBins;
+        MaxBins = nb > MaxBins ? nb : MaxBins;
+      }
+      for (j = 0; j < stats.nbins; j++) {
+        Empty += stats.count[j] == 0 ? 1 : 0;
+        Single += stats.count[j] == 1 ? 1 : 0;
+      }
+      printf("RandBinning: Train. Bins per grid: min = %ld, max = %ld, avg = %g; bins without train rows = %ld, with one = %ld\n",
+             MinBins, MaxBins, (double)stats.nbins/r, Empty, Single); fflush(stdout);
+    }
+#endif
 
     START_CLOCK;
-    SPointArray Xdata_randbin;  // Generate random binning features
-    long int nnz = r*(Xtrain_N + Xtest_N);
+    MemTrackSetTag(MEM_FEATURES);
+#ifndef USE_MPI
     long int dd = 0;
     for(i = 0; i < instances_new.size(); i++){
       if(dd < instances_new[i][r-1].first)
         dd = instances_new[i][r-1].first;
     }
-    Xdata_randbin.Init(Xtrain_N+Xtest_N, dd, nnz);
-    long int ind = 0;
-    long int *mystart = Xdata_randbin.GetPointerStart();
-    int *myidx = Xdata_randbin.GetPointerIdx();
-    double *myX = Xdata_randbin.GetPointerX();
-    for(i = 0; i < instances_new.size(); i++){
-      if (i == 0)
-        mystart[i] = 0;
-      else
-        mystart[i] = mystart[i-1] + r;
-      for(j = 0; j < instances_new[i].size(); j++){
-        myidx[ind] = instances_new[i][j].first-1;
-        myX[ind] = instances_new[i][j].second;
-        ind++;
-      }
-    }
-    mystart[i] = nnz; // mystart has a length N+1
+#endif
     // generate random binning features for Xtrain and Xtest
     SPointArray Xtrain;         // Training points
     SPointArray Xtest;          // Testing points
-    long Row_start = 0;
-    Xdata_randbin.GetSubset(Row_start, Xtrain_N,Xtrain);
-    Xdata_randbin.GetSubset(Xtrain_N,Xtest_N,Xtest);
-    Xdata_randbin.ReleaseAllMemory();
+    PackedBinMatrix XtrainP;    // Packed: training points
+    PackedBinMatrix XtestP;     // Packed: testing points
+    SPointArray Xval;           // EarlyStop: held-out points
+    PackedBinMatrix XvalP;
+    vector<long> group, count;  // Dedup: group of each train row, size of each group
+    if (Dedup) {
+      long NumRows[2] = { Fit_n, 0 };
+      NumRows[1] = group_binning_rows(instances_new, Fit_n, group, count);
+      if (Packed) {
+        // the first row of each group, scaled by sqrt(count)
+        vector<long> first(count.size());
+        vector<double> factor(count.size());
+        for (i = group.size()-1; i >= 0; i--) {
+          first[group[i]] = i;
+        }
+        for (i = 0; i < (long)count.size(); i++) {
+          factor[i] = sqrt((double)count[i]);
+        }
+        if (!XtrainP.Init(instances_new, first, factor, r, dd)) {
+#ifdef USE_MPI
+          MPI_Abort(MPI_COMM_WORLD, 1);
+#endif
+          return -1;
+        }
+      }
+      else {
+        ConvertToSPointArray(instances_new, group, count, r, dd, Xtrain);
+      }
+#ifdef USE_MPI
+      // distinct rows of each process, summed
+      MPI_Allreduce(MPI_IN_PLACE, NumRows, 2, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+#endif
+      if (MpiRank == 0) {
+        printf("RandBinning: Train. Dedup: n train = %ld, distinct rows = %ld\n", NumRows[0], NumRows[1]); fflush(stdout);
+      }
+    }
+    else if (Packed) {
+      if (!XtrainP.Init(instances_new, 0, Fit_n, r, dd)) {
+#ifdef USE_MPI
+        MPI_Abort(MPI_COMM_WORLD, 1);
+#endif
+        return -1;
+      }
+    }
+    else {
+      ConvertToSPointArray(instances_new, 0, Fit_n, r, dd, Xtrain);
+    }
+    if (Packed) {
+      if (!XtestP.Init(instances_new, Train_n, Test_n, r, dd) ||
+          (Val_n > 0 && !XvalP.Init(instances_new, Fit_n, Val_n, r, dd))) {
+#ifdef USE_MPI
+        MPI_Abort(MPI_COMM_WORLD, 1);
+#endif
+        return -1;
+      }
+    }
+    else {
+      ConvertToSPointArray(instances_new, Train_n, Test_n, r, dd, Xtest);
+      if (Val_n > 0) {
+        ConvertToSPointArray(instances_new, Fit_n, Val_n, r, dd, Xval);
+      }
+    }
+    if (!Nested) {
+      vector< vector< pair<int,double> > >().swap(instances_new);
+    }
     END_CLOCK;
     TimeTrain += ELAPSED_TIME;
-    printf("RandBinning: Train. Time (in seconds) for converting data format back: %g\n", ELAPSED_TIME);fflush(stdout);
+    if (MpiRank == 0) {
+      printf("RandBinning: Train. Time (in seconds) for converting data format back: %g\n", ELAPSED_TIME);fflush(stdout);
+    }
+    if (Packed) {
+      // bytes of this process, against an index and a value per nonzero
+      long Bytes[2] = { XtrainP.GetMemBytes() + XtestP.GetMemBytes(),
+                        (XtrainP.GetN() + XtestP.GetN())*(r*(long)(sizeof(int)+sizeof(double)) + (long)sizeof(long)) };
+      int MinWidth = 64, MaxWidth = 0;
+      for (j = 0; j < r; j++) {
+        MinWidth = XtrainP.GetWidth(j) < MinWidth ? XtrainP.GetWidth(j) : MinWidth;
+        MaxWidth = XtrainP.GetWidth(j) > MaxWidth ? XtrainP.GetWidth(j) : MaxWidth;
+      }
+#ifdef USE_MPI
+      MPI_Allreduce(MPI_IN_PLACE, Bytes, 2, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+#endif
+      if (MpiRank == 0) {
+        printf("RandBinning: Train. Packed: bits per bin = %d to %d, memory = %ld bytes (SPointArray: %ld bytes)\n",
+               MinWidth, MaxWidth, Bytes[0], Bytes[1]); fflush(stdout);
+      }
+    }
+    MemTrackReport("Binning");
+    MemTrackResetPeak();
+    MemTrackSetTag(MEM_MODEL);
 
     /* Set up Training and Testing */
     int m; // number of classes
-    long N = Xtest.GetN(); // number of testing points
-    long M = Xtest.GetD(); // dimension of randome binning features
+    long N = Test_n; // number of testing points
+    long M = dd; // dimension of randome binning features
     DMatrix Ytest_predict; // predictions for multiclasses
     DMatrix W; // weights for multiclasses
     DVector ytest_predict; // prediction for binary classification or regression
@@ -245,9 +536,9 @@ int main(int argc, char **argv) {
     // Create an identity matrix as preconditioner, could be removed later
     SPointArray EYE;
     EYE.Init(M,M,M);
-    mystart = EYE.GetPointerStart();
-    myidx = EYE.GetPointerIdx();
-    myX = EYE.GetPointerX();
+    long int *mystart = EYE.GetPointerStart();
+    int *myidx = EYE.GetPointerIdx();
+    double *myX = EYE.GetPointerX();
     for(i=0;i<M;i++){
       mystart[i] = i;
       myidx[i] = i;
@@ -255,61 +546,395 @@ int main(int argc, char **argv) {
     }
     mystart[i] = M+1; // mystart has a length M+1
 
+    // GCV: the residuals, summed over the label columns, and the trace
+    // of each lambda. With Dedup, Z'y is that of the merged rows, and
+    // |y|^2 that of all the rows trained on.
+    if (GCVSteps > 0) {
+      START_CLOCK;
+      vector<double> Res(Num_lambda, 0.0), Trace(Num_lambda, 0.0);
+      vector<double> Nodes, Weights;
+      for (i = 0; i < m; i++) {
+        if (NumClasses > 2) {
+          Ytrain.GetColumn(i, ytrain);
+        }
+        DVector yfit, yz, b;
+        ytrain.GetBlock(0L, Fit_n, yfit);
+        if (Dedup) {
+          GroupLabels(yfit, group, count, yz);
+        }
+        else {
+          yz = yfit;
+        }
+        if (Packed) {
+          XtrainP.MatVec(yz, b, TRANSPOSE);
+          GCVQuadrature(XtrainP, b, GCVSteps, NORMAL, Nodes, Weights);
+        }
+        else {
+          Xtrain.MatVec(yz, b, TRANSPOSE);
+          GCVQuadrature(Xtrain, b, GCVSteps, NORMAL, Nodes, Weights);
+        }
+        double NormY = yfit.Norm2();
+        for (j = 0; j < Num_lambda; j++) {
+          Res[j] += GCVResidual(NormY*NormY, Nodes, Weights, List_lambda[j]);
+        }
+      }
+      // The probes are drawn on the smaller side of Z, and are zero on
+      // its empty rows (resp. columns)
+      long NumRowsZ = Packed ? XtrainP.GetN() : Xtrain.GetN();
+      MatrixMode ProbeMode = M <= NumRowsZ ? NORMAL : TRANSPOSE;
+      long ProbeN = M <= NumRowsZ ? M : NumRowsZ;
+      DVector Ones(ProbeN == M ? NumRowsZ : M), Used;
+      Ones.SetConstVal(1.0);
+      if (Packed) {
+        XtrainP.MatVec(Ones, Used, ProbeMode == NORMAL ? TRANSPOSE : NORMAL);
+      }
+      else {
+        Xtrain.MatVec(Ones, Used, ProbeMode == NORMAL ? TRANSPOSE : NORMAL);
+      }
+      for (int p = 0; p < GCV_PROBES; p++) {
+        DVector v(ProbeN);
+        double *mv = v.GetPointer();
+        double *mu = Used.GetPointer();
+        for (j = 0; j < ProbeN; j++) {
+          mv[j] = mu[j] == 0.0 ? 0.0 : (random() & 1 ? 1.0 : -1.0);
+        }
+        if (Packed) {
+          GCVQuadrature(XtrainP, v, GCVSteps, ProbeMode, Nodes, Weights);
+        }
+        else {
+          GCVQuadrature(Xtrain, v, GCVSteps, ProbeMode, Nodes, Weights);
+        }
+        for (j = 0; j < Num_lambda; j++) {
+          Trace[j] += GCVTrace(Nodes, Weights, List_lambda[j])/GCV_PROBES;
+        }
+      }
+      long Best = 0;
+      double BestGCV = 0.0;
+      for (j = 0; j < Num_lambda; j++) {
+        double Dof = Fit_n - Trace[j];
+        double gcv = Fit_n*Res[j]/(Dof*Dof);
+        printf("RandBinning: GCV. sigma = %g, lambda = %g, residual = %g, trace = %g, gcv = %g\n",
+               sigma, List_lambda[j], Res[j], Trace[j], gcv); fflush(stdout);
+        if (j == 0 || gcv < BestGCV) {
+          Best = j;
+          BestGCV = gcv;
+        }
+      }
+      lambda = List_lambda[Best];
+      END_CLOCK;
+      TimeTrain += ELAPSED_TIME;
+      printf("RandBinning: Train. Time (in seconds) for GCV: %g, selected lambda = %g\n", ELAPSED_TIME, lambda); fflush(stdout);
+    }
+
     // Start Training L2R-SquareLoss model:
     // solve (Z'Z + lambdaI)w = Z'y, note that we never explicitly form
     // Z'Z since Z is a large sparse matrix N*dd
     START_CLOCK;
+#ifdef USE_MPI
+    DistSPointArray<> Z(Xtrain); // Z'* sums over the processes
+    DistSPointArray<PackedBinMatrix> ZP(XtrainP);
+#else
+    SPointArray &Z = Xtrain;
+    PackedBinMatrix &ZP = XtrainP;
+#endif
     DVector yy; // holding yy = Z'y
+    DVector ytrain_local; // labels of the local rows
+    DVector yval; // EarlyStop: labels of the held-out rows
+    ValidationStop<SPointArray> Stop(Xval, yval, EarlyStop, Patience);
+    ValidationStop<PackedBinMatrix> StopP(XvalP, yval, EarlyStop, Patience);
     for (i = 0; i < m; i++) {
        if (NumClasses > 2){ 
           Ytrain.GetColumn(i, ytrain);
        }
-       Xtrain.MatVec(ytrain, yy, TRANSPOSE);
+#ifdef USE_MPI
+       ytrain.GetBlock(Train_i0, Train_n, ytrain_local);
+       if (Dedup) {
+         DVector y = ytrain_local;
+         GroupLabels(y, group, count, ytrain_local);
+       }
+       if (Packed) {
+         ZP.MatVec(ytrain_local, yy, TRANSPOSE);
+       }
+       else {
+         Z.MatVec(ytrain_local, yy, TRANSPOSE);
+       }
+#else
+       yy.Init(M);
+       yy.SetBlock(0, M, &(stats.ZtY[(long)i*stats.nbins]));
+#endif
        double NormRHS = yy.Norm2();
+       // the solve of each class, sigma and lambda has its key
+       long Key = (ii*Num_sigma + k)*m + i;
+       if (Ckpt.GetSolution(Key, lambda, M, w)) {
+         if (verbose && MpiRank == 0) {
+           printf("RandBinning: Train. Checkpoint: solution restored from the log\n"); fflush(stdout);
+         }
+         if (NumClasses > 2){
+            W.SetColumn(i, w);
+         }
+         continue;
+       }
+       if (Val_n > 0) {
+         ytrain.GetBlock(Fit_n, Val_n, yval);
+       }
+       Stop.Reset();
+       StopP.Reset();
+       Ckpt.SetKey(Key);
        PCG pcg_solver;
-       pcg_solver.Solve<SPointArray, SPointArray>(Xtrain, yy, w, EYE, MAXIT, TOL, 1, lambda);
-       if (verbose) {
-         int Iter = 0;
-         const double *ResHistory = pcg_solver.GetResHistory(Iter);
+       if (Packed) {
+         pcg_solver.Solve(ZP, yy, w, EYE, MAXIT, TOL, 1, lambda, StopP, Ckpt);
+       }
+       else {
+         pcg_solver.Solve(Z, yy, w, EYE, MAXIT, TOL, 1, lambda, Stop, Ckpt);
+       }
+       int Iter = 0;
+       const double *ResHistory = pcg_solver.GetResHistory(Iter);
+       if (verbose && MpiRank == 0) {
          printf("RandBinning: Train. PCG: iteration = %d, Relative residual = %g\n",
             Iter, ResHistory[Iter-1]/NormRHS);fflush(stdout);
        }
        pcg_solver.GetSolution(w);
+       if (EarlyStop > 0) {
+         // the last iterate is checked too, then the best one is taken
+         if (Packed) {
+           StopP.Check(Iter-1, w);
+           StopP.GetSolution(w);
+         }
+         else {
+           Stop.Check(Iter-1, w);
+           Stop.GetSolution(w);
+         }
+         if (verbose) {
+           printf("RandBinning: Train. EarlyStop: best iteration = %d, validation MSE = %g, checks = %d\n",
+                  Packed ? StopP.GetBestIter() : Stop.GetBestIter(),
+                  Packed ? StopP.GetBestError() : Stop.GetBestError(),
+                  Packed ? StopP.GetNumChecks() : Stop.GetNumChecks()); fflush(stdout);
+         }
+       }
+       Ckpt.AddSolution(Key, lambda, w);
        if (NumClasses > 2){
           W.SetColumn(i, w);
        }
     }
     END_CLOCK;
     TimeTrain += ELAPSED_TIME;
-    printf("RandBinning: Train. Time (in seconds) for solving linear system solution: %g\n", ELAPSED_TIME);fflush(stdout);
+    if (MpiRank == 0) {
+      printf("RandBinning: Train. Time (in seconds) for solving linear system solution: %g\n", ELAPSED_TIME);fflush(stdout);
+    }
+    MemTrackReport("Solve");
+    MemTrackSetTag(MEM_OTHER);
 
     // Start Testing L2R-SquareLoss model:
     // y = Xtest*W = z(x)'*w
     START_CLOCK;
     double accuracy = 0.0;
     if (NumClasses > 2){
-       Xtest.MatMat(W,Ytest_predict,NORMAL,NORMAL);
-       accuracy = Performance(ytest, Ytest_predict, NumClasses);
+       if (Packed) {
+         XtestP.MatMat(W,Ytest_predict,NORMAL,NORMAL);
+       }
+       else {
+         Xtest.MatMat(W,Ytest_predict,NORMAL,NORMAL);
+       }
+#ifdef USE_MPI
+       GatherRows(Ytest_predict, Xtest_N);
+#endif
+       if (MpiRank == 0) {
+         accuracy = Performance(ytest, Ytest_predict, NumClasses);
+       }
     }
     else {
-       Xtest.MatVec(w,ytest_predict,NORMAL);
-       accuracy = Performance(ytest, ytest_predict, NumClasses);
+       if (Packed) {
+         XtestP.MatVec(w,ytest_predict,NORMAL);
+       }
+       else {
+         Xtest.MatVec(w,ytest_predict,NORMAL);
+       }
+#ifdef USE_MPI
+       GatherRows(ytest_predict, Xtest_N);
+#endif
+       if (MpiRank == 0) {
+         accuracy = Performance(ytest, ytest_predict, NumClasses);
+       }
     }
     END_CLOCK;
     TimeTest += ELAPSED_TIME;
-    printf("RandBinning: OneVsAll. r = %d, D = %ld, param = %g %g, perf = %g, time = %g %g\n", 
-            r, dd, sigma, lambda, accuracy, TimeTrain, TimeTest); fflush(stdout);
+    if (MpiRank == 0) {
+      printf("RandBinning: OneVsAll. r = %d, D = %ld, param = %g %g, perf = %g, time = %g %g\n", 
+              r, dd, sigma, lambda, accuracy, TimeTrain, TimeTest); fflush(stdout);
+    }
+#ifndef USE_MPI
+    if (Nested) {
+      instances_new.swap(NestedNew[k]);
+      std::swap(stats, NestedStats[k]);
+    }
+#endif
   }// End loop over List_sigma
   }// End loop over List_lambda
 
   // Clean up
+  Ckpt.Flush();
+  if (CkptFile && MpiRank == 0) {
+    printf("RandBinning: Checkpoint. files written = %d, failed = %d\n",
+           Ckpt.GetNumWritten(), Ckpt.GetNumFailed()); fflush(stdout);
+  }
   free(List_sigma);
   free(List_lambda);
 
+#ifdef USE_MPI
+  MPI_Finalize();
+#endif
+
   return 0;
 }
 
 
+#ifdef USE_MPI
+//--------------------------------------------------------------------------
+// Row counts and offsets of the blocks of all the processes, on
+// process 0.
+static void GatherCounts(long nLocal, long n, int *Counts, int *Displs) {
+  int MpiRank, MpiSize;
+  MPI_Comm_rank(MPI_COMM_WORLD, &MpiRank);
+  MPI_Comm_size(MPI_COMM_WORLD, &MpiSize);
+  int c = (int)nLocal;
+  MPI_Gather(&c, 1, MPI_INT, Counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  if (MpiRank == 0) {
+    Displs[0] = 0;
+    for (int p = 1; p < MpiSize; p++) {
+      Displs[p] = Displs[p-1] + Counts[p-1];
+    }
+    if (Displs[MpiSize-1] + Counts[MpiSize-1] != n) {
+      printf("GatherRows. Error: Row counts mismatch.\n");
+    }
+  }
+}
+
+
+//--------------------------------------------------------------------------
+void GatherRows(DVector &y, long n) {
+  int MpiRank, MpiSize;
+  MPI_Comm_rank(MPI_COMM_WORLD, &MpiRank);
+  MPI_Comm_size(MPI_COMM_WORLD, &MpiSize);
+  int *Counts = new int[MpiSize];
+  int *Displs = new int[MpiSize];
+  GatherCounts(y.GetN(), n, Counts, Displs);
+  DVector yAll;
+  if (MpiRank == 0) {
+    yAll.Init(n);
+  }
+  MPI_Gatherv(y.GetPointer(), (int)y.GetN(), MPI_DOUBLE,
+              yAll.GetPointer(), Counts, Displs, MPI_DOUBLE,
+              0, MPI_COMM_WORLD);
+  if (MpiRank == 0) {
+    y = yAll;
+  }
+  delete[] Counts;
+  delete[] Displs;
+}
+
+
+//--------------------------------------------------------------------------
+void GatherRows(DMatrix &Y, long n) {
+  int MpiRank, MpiSize;
+  MPI_Comm_rank(MPI_COMM_WORLD, &MpiRank);
+  MPI_Comm_size(MPI_COMM_WORLD, &MpiSize);
+  int *Counts = new int[MpiSize];
+  int *Displs = new int[MpiSize];
+  long nLocal = Y.GetM();
+  long nCol = Y.GetN();
+  GatherCounts(nLocal, n, Counts, Displs);
+  DMatrix YAll;
+  if (MpiRank == 0) {
+    YAll.Init(n, nCol);
+  }
+  // Column major: gather column by column
+  for (long j = 0; j < nCol; j++) {
+    MPI_Gatherv(Y.GetPointer() + j*nLocal, (int)nLocal, MPI_DOUBLE,
+                MpiRank == 0 ? YAll.GetPointer() + j*n : NULL,
+                Counts, Displs, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+  }
+  if (MpiRank == 0) {
+    Y = YAll;
+  }
+  delete[] Counts;
+  delete[] Displs;
+}
+#endif
+
+
+//--------------------------------------------------------------------------
+void ConvertToSPointArray(vector< vector< pair<int,double> > > &instances,
+                          long istart, long n, int r, long dd,
+                          SPointArray &X) {
+  long nnz = (long)r*n;
+  X.Init(n, dd, nnz);
+  long *mystart = X.GetPointerStart();
+  int *myidx = X.GetPointerIdx();
+  double *myX = X.GetPointerX();
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (long i = 0; i < n; i++) {
+    vector< pair<int,double> > &ins = instances[istart+i];
+    long ind = i*r;
+    mystart[i] = ind;
+    for (int j = 0; j < r; j++, ind++) {
+      myidx[ind] = ins[j].first-1;
+      myX[ind] = ins[j].second;
+    }
+  }
+  mystart[n] = nnz; // mystart has a length N+1
+}
+
+
+//--------------------------------------------------------------------------
+void ConvertToSPointArray(vector< vector< pair<int,double> > > &instances,
+                          const vector<long> &group,
+                          const vector<long> &count, int r, long dd,
+                          SPointArray &X) {
+  long n = count.size();
+  long nnz = (long)r*n;
+  vector<long> first(n);
+  for (long i = group.size()-1; i >= 0; i--) {
+    first[group[i]] = i;
+  }
+  X.Init(n, dd, nnz);
+  long *mystart = X.GetPointerStart();
+  int *myidx = X.GetPointerIdx();
+  double *myX = X.GetPointerX();
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (long u = 0; u < n; u++) {
+    vector< pair<int,double> > &ins = instances[first[u]];
+    double c = sqrt((double)count[u]);
+    long ind = u*r;
+    mystart[u] = ind;
+    for (int j = 0; j < r; j++, ind++) {
+      myidx[ind] = ins[j].first-1;
+      myX[ind] = c*ins[j].second;
+    }
+  }
+  mystart[n] = nnz; // mystart has a length N+1
+}
+
+
+//--------------------------------------------------------------------------
+void GroupLabels(const DVector &y, const vector<long> &group,
+                 const vector<long> &count, DVector &yc) {
+  long n = count.size();
+  yc.Init(n);
+  double *my = y.GetPointer();
+  double *myc = yc.GetPointer();
+  for (long i = 0; i < (long)group.size(); i++) {
+    myc[group[i]] += my[i];
+  }
+  for (long u = 0; u < n; u++) {
+    myc[u] /= sqrt((double)count[u]);
+  }
+}
+
+
 //--------------------------------------------------------------------------
 void UniformRandom01(double *a, int n) {
   int i;
@@ -0,0 +1,560 @@
+// This program tunes the parameters (sigma, lambda, r) of the kernel
+// ridge regression approximated by Random Binning features (see
+// KRR_OneVsAll_RandBin.cpp) by successive halving, instead of
+// evaluating every configuration at the full data size and the full
+// number of PCG iterations.
+//
+// A random fraction ValFrac of the train rows is held out for
+// validation; the other rows are the fit rows. All the configurations
+// of the grid List_sigma x List_lambda x List_r are first trained on a
+// small random subsample of the fit rows (fraction MinFrac) with a
+// small PCG budget (sqrt(MinFrac)*MAXIT iterations), and scored on the
+// validation rows. The best 1/eta of them are promoted to the next
+// rung, where the subsample is eta times larger (and the PCG budget
+// sqrt(eta) times), and so on, until the last rung trains the
+// survivors on all the fit rows with MAXIT iterations. The PCG budget
+// shrinks slower than the subsample because a few iterations from a
+// zero initial guess do not rank the configurations reliably.
+//
+// The test data play no part in the search: the best configuration of
+// the last rung is retrained on all the train rows with MAXIT
+// iterations, and only this model is scored on the test data.
+//
+// The configurations of a rung are run concurrently as NumJobs jobs,
+// each with NumThreads/NumJobs threads (nested OpenMP). The data are
+// read and converted once. A subsample is a prefix of a fixed random
+// permutation of the fit rows. The random binning features depend
+// only on (sigma, r) and the subsample; in each rung they are
+// generated once per pair, for the subsample and the validation rows,
+// and shared by all the lambda's of the pair. The features of a pair
+// are released as soon as none of its configurations survives. The
+// grids are drawn with the same seed as in KRR_OneVsAll_RandBin.ex,
+// but the rows are permuted and binned in different sets, so the
+// scores are not those of a full run.
+//
+// Usage:
+//
+//   KRR_RandBin_Search.ex NumThreads NumJobs FileTrain FileTest
+//   NumClasses d Num_r List_r Num_lambda List_lambda Num_sigma
+//   List_sigma MAXIT TOL eta MinFrac Seed [ValFrac]
+//
+//   NumThreads:  Total number of threads
+//   NumJobs:     Number of configurations trained concurrently
+//   FileTrain:   File name (including path) of train data
+//   FileTest:    File name (including path) of test data, on which
+//                the best configuration is scored
+//   NumClasses:  Number of classes (1: regression)
+//   d:           Data dimension
+//   Num_r:       Number of r's
+//   List_r:      List of r's (number of grids)
+//   Num_lambda:  Number of lambda's
+//   List_lambda: List of lambda's (Regularization)
+//   Num_sigma:   Number of sigma's
+//   List_sigma:  List of sigma's (Kernel function)
+//   MAXIT:       Number of PCG iterations of the last rung
+//   TOL:         PCG relative residual tolerance
+//   eta:         Promotion factor (>= 2)
+//   MinFrac:     Fraction of the fit rows of the first rung
+//   Seed:        Seed of the binning and of the subsampling
+//   ValFrac:     Fraction of the train rows held out to score the
+//                configurations (default 0.1)
+
+#include "randFeature.hpp"
+#include "LibCMatrix.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+//--------------------------------------------------------------------------
+// Random binning features of a subsample for one (sigma, r)
+struct FeatureSet {
+  SPointArray Xtrain; // First n fit rows of the permutation
+  SPointArray Xtest;  // Rows scored (validation, or test at the end)
+  long n;             // Size of the subsample
+  long dd;            // Number of features
+};
+
+// One configuration and its score at the last rung it was run
+struct Config {
+  double sigma;
+  double lambda;
+  int r;
+  double perf;
+};
+
+void ConvertYtrain(const DVector &ytrain, DMatrix &Ytrain, int NumClasses);
+void ConvertToSPointArray(vector< vector< pair<int,double> > > &instances,
+                          long istart, long n, int r, long dd,
+                          SPointArray &X);
+double Performance(const DVector &ytest_truth, const DVector &ytest_predict,
+                   int NumClasses);
+double Performance(const DVector &ytest_truth, const DMatrix &Ytest_predict,
+                   int NumClasses);
+
+// Train on F.Xtrain (labels: the first F.n rows of ytrain/Ytrain)
+// with at most MaxIt PCG iterations and return the performance on
+// F.Xtest (labels ytest).
+double Evaluate(FeatureSet &F, const DVector &ytrain,
+                const DMatrix &Ytrain, const DVector &ytest,
+                int NumClasses, double lambda, int MaxIt, double TOL);
+
+// true if perf a is better than perf b
+bool Better(double a, double b, int NumClasses) {
+  return NumClasses == 1 ? a < b : a > b;
+}
+
+//--------------------------------------------------------------------------
+int main(int argc, char **argv) {
+
+  // Temporary variables
+  long int i, j, idx = 1;
+
+  // Arguments
+  int NumThreads = atoi(argv[idx++]);
+  int NumJobs = atoi(argv[idx++]);
+  char *FileTrain = argv[idx++];
+  char *FileTest = argv[idx++];
+  int NumClasses = atoi(argv[idx++]);
+  int d = atoi(argv[idx++]);
+  int Num_r = atoi(argv[idx++]);
+  vector<int> List_r(Num_r);
+  for (i = 0; i < Num_r; i++) {
+    List_r[i] = atoi(argv[idx++]);
+  }
+  int Num_lambda = atoi(argv[idx++]);
+  vector<double> List_lambda(Num_lambda);
+  for (i = 0; i < Num_lambda; i++) {
+    List_lambda[i] = atof(argv[idx++]);
+  }
+  int Num_sigma = atoi(argv[idx++]);
+  vector<double> List_sigma(Num_sigma);
+  for (i = 0; i < Num_sigma; i++) {
+    List_sigma[i] = atof(argv[idx++]);
+  }
+  int MAXIT = atoi(argv[idx++]);
+  double TOL = atof(argv[idx++]);
+  double eta = atof(argv[idx++]);
+  double MinFrac = atof(argv[idx++]);
+  int Seed = atoi(argv[idx++]);
+  double ValFrac = idx < argc ? atof(argv[idx++]) : 0.1;
+
+  if (NumJobs < 1) {
+    NumJobs = 1;
+  }
+  if (NumJobs > NumThreads) {
+    NumJobs = NumThreads;
+  }
+  if (eta < 2.0) {
+    eta = 2.0;
+  }
+  if (MinFrac <= 0.0 || MinFrac > 1.0) {
+    MinFrac = 1.0;
+  }
+  int ThreadsPerJob = NumThreads/NumJobs;
+
+  // Threading. Concurrent jobs call BLAS with one thread each.
+#ifdef USE_OPENBLAS
+  openblas_set_num_threads(NumJobs > 1 ? 1 : NumThreads);
+#endif
+#ifdef USE_OPENMP
+  omp_set_num_threads(NumThreads);
+  omp_set_max_active_levels(2);
+#endif
+
+  PREPARE_CLOCK(1);
+  struct timespec search_start, search_end;
+  clock_gettime(CLOCK_MONOTONIC, &search_start);
+  START_CLOCK;
+
+  // Read and convert the data once
+  DPointArray Xtrain_d, Xtest_d;
+  DVector ytrain_d, ytest;
+  if (ReadData(FileTrain, Xtrain_d, ytrain_d, d) == 0) {
+    return -1;
+  }
+  if (ReadData(FileTest, Xtest_d, ytest, d) == 0) {
+    return -1;
+  }
+  long Xtrain_N = Xtrain_d.GetN();
+  long Xtest_N = Xtest_d.GetN();
+
+  // Fixed random permutation of the train rows: its first Xval_N rows
+  // are the validation rows, the others the fit rows, and a subsample
+  // of size n is the first n fit rows. The validation rows are stored
+  // first, so that the rows binned in a rung are a prefix of
+  // instances_old.
+  long Xval_N = max(1L, (long)(ValFrac*Xtrain_N));
+  long Xfit_N = Xtrain_N - Xval_N;
+  if (Xfit_N < 1) {
+    printf("RandBinning: Search. Error: no train rows left after holding out %ld validation rows\n", Xval_N);
+    return -1;
+  }
+  vector<long> perm(Xtrain_N);
+  for (i = 0; i < Xtrain_N; i++) {
+    perm[i] = i;
+  }
+  std::mt19937 gen(Seed);
+  std::shuffle(perm.begin(), perm.end(), gen);
+
+  vector< vector< pair<int,double> > > instances_old(Xtrain_N);
+  vector< vector< pair<int,double> > > instances_test(Xtest_N);
+  DVector ytrain(Xtrain_N);
+  double *myXtrain = Xtrain_d.GetPointer();
+  double *myXtest = Xtest_d.GetPointer();
+  for (i = 0; i < Xtrain_N; i++) {
+    ytrain.SetEntry(i, ytrain_d.GetEntry(perm[i]));
+    for (j = 0; j < d; j++) {
+      double v = myXtrain[j*Xtrain_N+perm[i]];
+      if (v != 0)
+        instances_old[i].push_back(pair<int,double>(j+1, v));
+    }
+  }
+  for (i = 0; i < Xtest_N; i++) {
+    for (j = 0; j < d; j++) {
+      double v = myXtest[j*Xtest_N+i];
+      if (v != 0)
+        instances_test[i].push_back(pair<int,double>(j+1, v));
+    }
+  }
+  Xtrain_d.ReleaseAllMemory();
+  Xtest_d.ReleaseAllMemory();
+  DVector yval, yfit;
+  ytrain.GetBlock(0L, Xval_N, yval);
+  ytrain.GetBlock(Xval_N, Xfit_N, yfit);
+  DMatrix Ytrain, Yfit;
+  if (NumClasses > 2) {
+    ConvertYtrain(ytrain, Ytrain, NumClasses);
+    ConvertYtrain(yfit, Yfit, NumClasses);
+  }
+  END_CLOCK;
+  printf("RandBinning: Search. time loading data = %g seconds, n train = %ld, n val = %ld, m test = %ld, num threads = %d, num jobs = %d\n",
+         ELAPSED_TIME, Xfit_N, Xval_N, Xtest_N, NumThreads, NumJobs); fflush(stdout);
+
+  // All the configurations
+  vector<Config> survivors;
+  for (int a = 0; a < Num_sigma; a++) {
+    for (int b = 0; b < Num_lambda; b++) {
+      for (int c = 0; c < Num_r; c++) {
+        Config cfg = { List_sigma[a], List_lambda[b], List_r[c], 0.0 };
+        survivors.push_back(cfg);
+      }
+    }
+  }
+  long NumConfigs = survivors.size();
+
+  // Rungs: the fraction grows by eta up to 1
+  int NumRungs = 1;
+  while (MinFrac*pow(eta, NumRungs-1) < 1.0 - 1e-12) {
+    NumRungs++;
+  }
+
+  map< pair<double,int>, FeatureSet* > cache;
+  double Work = 0.0; // sum of n*MaxIt over all the evaluations
+  double TimeBinning = 0.0;
+
+  for (int k = 0; k < NumRungs; k++) {
+
+    double frac = k == NumRungs-1 ? 1.0 : MinFrac*pow(eta, k);
+    long n = max(1L, (long)(frac*Xfit_N));
+    int MaxIt = max(1, (int)ceil(sqrt(frac)*MAXIT));
+
+    // Release the features no survivor uses, generate the missing ones
+    // for the validation rows and the first n fit rows
+    START_CLOCK;
+    vector< vector< pair<int,double> > > rest;
+    if (n < Xfit_N) {
+      rest.assign(make_move_iterator(instances_old.begin()+Xval_N+n),
+                  make_move_iterator(instances_old.end()));
+      instances_old.resize(Xval_N+n);
+    }
+    for (map< pair<double,int>, FeatureSet* >::iterator it = cache.begin(); it != cache.end(); ) {
+      bool used = false;
+      for (size_t c = 0; c < survivors.size(); c++) {
+        if (survivors[c].sigma == it->first.first && survivors[c].r == it->first.second) {
+          used = true;
+        }
+      }
+      if (used && it->second->n == n) {
+        it++;
+      }
+      else {
+        delete it->second;
+        cache.erase(it++);
+      }
+    }
+    for (size_t c = 0; c < survivors.size(); c++) {
+      pair<double,int> key(survivors[c].sigma, survivors[c].r);
+      if (cache.count(key)) {
+        continue;
+      }
+      int r = key.second;
+      vector< vector< pair<int,double> > > instances_new;
+      srandom(Seed);
+      random_binning_feature(d+1, r, instances_old, instances_new, key.first);
+      FeatureSet *F = new FeatureSet;
+      F->n = n;
+      F->dd = 0;
+      for (i = 0; i < (long)instances_new.size(); i++) {
+        if (F->dd < instances_new[i][r-1].first)
+          F->dd = instances_new[i][r-1].first;
+      }
+      ConvertToSPointArray(instances_new, Xval_N, n, r, F->dd, F->Xtrain);
+      ConvertToSPointArray(instances_new, 0, Xval_N, r, F->dd, F->Xtest);
+      cache[key] = F;
+    }
+    instances_old.insert(instances_old.end(), make_move_iterator(rest.begin()),
+                         make_move_iterator(rest.end()));
+    END_CLOCK;
+    TimeBinning += ELAPSED_TIME;
+
+    // Features of each survivor, looked up before the parallel region
+    // so that the jobs do not touch the map
+    long NumSurvivors = survivors.size();
+    vector<FeatureSet*> Features(NumSurvivors);
+    for (long c = 0; c < NumSurvivors; c++) {
+      Features[c] = cache.at(pair<double,int>(survivors[c].sigma, survivors[c].r));
+    }
+
+    // Train the survivors concurrently
+    START_CLOCK;
+#ifdef USE_OPENMP
+#pragma omp parallel for num_threads(NumJobs) schedule(dynamic,1)
+#endif
+    for (long c = 0; c < NumSurvivors; c++) {
+#ifdef USE_OPENMP
+      omp_set_num_threads(ThreadsPerJob);
+#endif
+      Config &cfg = survivors[c];
+      cfg.perf = Evaluate(*Features[c], yfit, Yfit, yval, NumClasses,
+                          cfg.lambda, MaxIt, TOL);
+    }
+    END_CLOCK;
+    Work += (double)NumSurvivors*n*MaxIt;
+
+    for (long c = 0; c < NumSurvivors; c++) {
+      printf("RandBinning: Search. rung = %d, r = %d, param = %g %g, val perf = %g\n",
+             k, survivors[c].r, survivors[c].sigma, survivors[c].lambda,
+             survivors[c].perf);
+    }
+    printf("RandBinning: Search. rung = %d, n = %ld, maxit = %d, configs = %ld, time = %g\n",
+           k, n, MaxIt, NumSurvivors, ELAPSED_TIME); fflush(stdout);
+
+    // Promote the best 1/eta (stable, so ties keep the grid order)
+    if (k < NumRungs-1) {
+      long keep = max(1L, (long)ceil(NumSurvivors/eta));
+      std::stable_sort(survivors.begin(), survivors.end(),
+                       [NumClasses](const Config &a, const Config &b) {
+                         return Better(a.perf, b.perf, NumClasses); });
+      survivors.resize(keep);
+    }
+  }
+
+  Config best = survivors[0];
+  for (size_t c = 1; c < survivors.size(); c++) {
+    if (Better(survivors[c].perf, best.perf, NumClasses)) {
+      best = survivors[c];
+    }
+  }
+  for (map< pair<double,int>, FeatureSet* >::iterator it = cache.begin(); it != cache.end(); it++) {
+    delete it->second;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &search_end);
+  double TimeSearch = search_end.tv_sec - search_start.tv_sec;
+  TimeSearch += (search_end.tv_nsec - search_start.tv_nsec) / 1e9;
+  printf("RandBinning: Search. configs = %ld, rungs = %d, work/full = %g, time binning = %g, time = %g\n",
+         NumConfigs, NumRungs, Work/((double)NumConfigs*Xfit_N*MAXIT),
+         TimeBinning, TimeSearch);
+  printf("RandBinning: Search. best r = %d, param = %g %g, val perf = %g\n",
+         best.r, best.sigma, best.lambda, best.perf); fflush(stdout);
+
+  // Retrain the best configuration on all the train rows and score it
+  // on the test data, once
+  START_CLOCK;
+  instances_old.insert(instances_old.end(), make_move_iterator(instances_test.begin()),
+                       make_move_iterator(instances_test.end()));
+  vector< vector< pair<int,double> > > instances_new;
+  srandom(Seed);
+  random_binning_feature(d+1, best.r, instances_old, instances_new, best.sigma);
+  instances_old.clear();
+  FeatureSet F;
+  F.n = Xtrain_N;
+  F.dd = 0;
+  for (i = 0; i < (long)instances_new.size(); i++) {
+    if (F.dd < instances_new[i][best.r-1].first)
+      F.dd = instances_new[i][best.r-1].first;
+  }
+  ConvertToSPointArray(instances_new, 0, Xtrain_N, best.r, F.dd, F.Xtrain);
+  ConvertToSPointArray(instances_new, Xtrain_N, Xtest_N, best.r, F.dd, F.Xtest);
+  instances_new.clear();
+#ifdef USE_OPENMP
+  omp_set_num_threads(NumThreads);
+#endif
+#ifdef USE_OPENBLAS
+  openblas_set_num_threads(NumThreads);
+#endif
+  double perf = Evaluate(F, ytrain, Ytrain, ytest, NumClasses,
+                         best.lambda, MAXIT, TOL);
+  END_CLOCK;
+  printf("RandBinning: Search. best r = %d, param = %g %g, test perf = %g, time = %g\n",
+         best.r, best.sigma, best.lambda, perf, ELAPSED_TIME); fflush(stdout);
+
+  return 0;
+}
+
+
+//--------------------------------------------------------------------------
+double Evaluate(FeatureSet &F, const DVector &ytrain,
+                const DMatrix &Ytrain, const DVector &ytest,
+                int NumClasses, double lambda, int MaxIt, double TOL) {
+
+  SPointArray &Xsub = F.Xtrain;
+  long n = F.n;
+  long M = F.dd;
+  int m = NumClasses > 2 ? NumClasses : 1;
+
+  // The preconditioner is not used with ATA = 1
+  SPointArray EYE;
+
+  DMatrix W;
+  DVector w(M);
+  if (NumClasses > 2) {
+    W.Init(M, m);
+  }
+  DVector y, ysub, yy;
+  for (int c = 0; c < m; c++) {
+    if (NumClasses > 2) {
+      Ytrain.GetColumn(c, y);
+      y.GetBlock(0L, n, ysub);
+    }
+    else {
+      ytrain.GetBlock(0L, n, ysub);
+    }
+    Xsub.MatVec(ysub, yy, TRANSPOSE);
+    PCG pcg_solver;
+    pcg_solver.Solve<SPointArray, SPointArray>(Xsub, yy, w, EYE, MaxIt, TOL, 1, lambda);
+    pcg_solver.GetSolution(w);
+    if (NumClasses > 2) {
+      W.SetColumn(c, w);
+    }
+  }
+
+  if (NumClasses > 2) {
+    DMatrix Ytest_predict;
+    F.Xtest.MatMat(W, Ytest_predict, NORMAL, NORMAL);
+    return Performance(ytest, Ytest_predict, NumClasses);
+  }
+  DVector ytest_predict;
+  F.Xtest.MatVec(w, ytest_predict, NORMAL);
+  return Performance(ytest, ytest_predict, NumClasses);
+}
+
+
+//--------------------------------------------------------------------------
+void ConvertToSPointArray(vector< vector< pair<int,double> > > &instances,
+                          long istart, long n, int r, long dd,
+                          SPointArray &X) {
+  long nnz = (long)r*n;
+  X.Init(n, dd, nnz);
+  long *mystart = X.GetPointerStart();
+  int *myidx = X.GetPointerIdx();
+  double *myX = X.GetPointerX();
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (long i = 0; i < n; i++) {
+    vector< pair<int,double> > &ins = instances[istart+i];
+    long ind = i*r;
+    mystart[i] = ind;
+    for (int j = 0; j < r; j++, ind++) {
+      myidx[ind] = ins[j].first-1;
+      myX[ind] = ins[j].second;
+    }
+  }
+  mystart[n] = nnz; // mystart has a length N+1
+}
+
+
+//--------------------------------------------------------------------------
+void ConvertYtrain(const DVector &ytrain, DMatrix &Ytrain, int NumClasses) {
+  Ytrain.Init(ytrain.GetN(), NumClasses);
+  // Lingfei: the y label is supposed to start from 0.
+  for (int i = 0; i < NumClasses; i++) {
+    DVector y = ytrain;
+    double *my = y.GetPointer();
+    for (long j = 0; j < y.GetN(); j++) {
+      my[j] = ((int)my[j])==i ? 1.0 : -1.0;
+    }
+    Ytrain.SetColumn(i, y);
+  }
+}
+
+
+//--------------------------------------------------------------------------
+double Performance(const DVector &ytest_truth, const DVector &ytest_predict,
+                   int NumClasses) {
+
+  long n = ytest_truth.GetN();
+  if (n != ytest_predict.GetN()) {
+    printf("Performance. Error: Vector lengths mismatch. Return NAN");
+    return NAN;
+  }
+  if (NumClasses != 1 && NumClasses != 2) {
+    printf("Performance. Error: Neither regression nor binary classification. Return NAN");
+    return NAN;
+  }
+  double perf = 0.0;
+
+  if (NumClasses == 1) { // Relative error
+    DVector diff;
+    ytest_truth.Subtract(ytest_predict, diff);
+    perf = diff.Norm2()/ytest_truth.Norm2();
+  }
+  else if (NumClasses == 2) { // Accuracy
+    double *y1 = ytest_truth.GetPointer();
+    double *y2 = ytest_predict.GetPointer();
+    for (long i = 0; i < n; i++) {
+      perf += y1[i]*y2[i]>0 ? 1.0:0.0;
+    }
+    perf = perf/n * 100.0;
+  }
+
+  return perf;
+}
+
+
+//--------------------------------------------------------------------------
+double Performance(const DVector &ytest_truth, const DMatrix &Ytest_predict,
+                   int NumClasses) {
+
+  long n = ytest_truth.GetN();
+  if (n != Ytest_predict.GetM() || Ytest_predict.GetN() != NumClasses ) {
+    printf("Performance. Error: Size mismatch. Return NAN");
+    return NAN;
+  }
+  if (NumClasses <= 2) {
+    printf("Performance. Error: Not multiclass classification. Return NAN");
+    return NAN;
+  }
+  double perf = 0.0;
+
+  // Compute ytest_predict
+  DVector ytest_predict(n);
+  double *y = ytest_predict.GetPointer();
+  for (long i = 0; i < n; i++) {
+    DVector row(NumClasses);
+    Ytest_predict.GetRow(i, row);
+    long idx = -1;
+    row.Max(idx);
+    y[i] = (double)idx;
+  }
+
+  // Accuracy
+  double *y1 = ytest_truth.GetPointer();
+  double *y2 = ytest_predict.GetPointer();
+  for (long i = 0; i < n; i++) {
+    perf += ((int)y1[i])==((int)y2[i]) ? 1.0 : 0.0;
+  }
+  perf = perf/n * 100.0;
+
+  return perf;
+}
@@ -0,0 +1,63 @@
+#!/bin/tcsh
+
+# Scaling of the MPI build (make USE_MPI=1) over the number of
+# processes times the number of threads per process, on one node. For
+# each pair, the train time (binning + solve) and the test time are
+# collected from the "RandBinning: OneVsAll." line, together with the
+# PCG solve time.
+
+set MPIRUN      = "mpirun --oversubscribe"
+set WORKING_DIR = ${HOME}/MyHomeScratch/Research/MachineLearning/codes_KRR_randbin/
+set DATA_DIR    = ${HOME}/MyHomeScratch/Research/MachineLearning/data/
+set MAXIT       = 50
+set TOL         = 1e-3
+set VERBOSE     = 1
+set NUM_PROCS   = (1 2 4)
+set NUM_THREADS = (1 2 4)
+set SIGMA       = (0.5)
+set LAMBDA      = (1e-4)
+set DATASET     = covtype
+
+#----------------------------------------------------------------
+# Variables specific to each data set
+
+if ( ${DATASET} == covtype ) then
+
+set TRAIN_FILE        = ${DATA_DIR}/covtype/covtype_freq_10.train
+set TEST_FILE         = ${DATA_DIR}/covtype/covtype.test
+set NUM_CLASSES       = 2
+set DIMENSION         = 54
+set RANK              = 128
+
+else if ( ${DATASET} == SUSY ) then
+
+set TRAIN_FILE        = ${DATA_DIR}/SUSY/SUSY.train
+set TEST_FILE         = ${DATA_DIR}/SUSY/SUSY.test
+set NUM_CLASSES       = 2
+set DIMENSION         = 18
+set RANK              = 244
+
+else if ( ${DATASET} == YearPred ) then
+
+set TRAIN_FILE        = ${DATA_DIR}/YearPred/YearPred.train
+set TEST_FILE         = ${DATA_DIR}/YearPred/YearPred.test
+set NUM_CLASSES       = 1
+set DIMENSION         = 90
+set RANK              = 226
+
+endif
+
+#----------------------------------------------------------------
+# Run all the pairs (processes, threads)
+
+set PROG = ${WORKING_DIR}/KRR_OneVsAll_RandBin.ex
+set OUT_FILE = RandBin_MPI_Scaling_${DATASET}_${RANK}.results
+rm -f ${OUT_FILE}
+echo "DATASET: ${DATASET}" | tee -a ${OUT_FILE}
+
+foreach NP (${NUM_PROCS})
+foreach NT (${NUM_THREADS})
+  echo "NP = ${NP}, NT = ${NT}" | tee -a ${OUT_FILE}
+  ${MPIRUN} -np ${NP} ${PROG} ${NT} ${TRAIN_FILE} ${TEST_FILE} ${NUM_CLASSES} ${DIMENSION} ${RANK} $#LAMBDA ${LAMBDA} $#SIGMA ${SIGMA} ${MAXIT} ${TOL} ${VERBOSE} | grep -E "solving linear system|OneVsAll" | tee -a ${OUT_FILE}
+end
+end
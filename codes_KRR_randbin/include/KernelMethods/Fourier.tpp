@@ -84,8 +84,9 @@ Train(const Kernel &mKernel, double lambda,
       const DVector &ytrain,
       long r, unsigned Seed, double &mem_est) {
 
-  // Seed the RNG
-  srandom(Seed);
+  // Seeds of the parallel RNG streams for w and b
+  unsigned long Seed_w = 2*(unsigned long)Seed;
+  unsigned long Seed_b = 2*(unsigned long)Seed + 1;
 
   // Dimensions
   long N = Xtrain.GetN();
@@ -97,21 +98,21 @@ Train(const Kernel &mKernel, double lambda,
   if (mKernel.GetKernelName() == "IsotropicGaussian") {
 
     // Standard normal scaled by 1/sigma
-    w.SetStandardNormal();
+    w.SetStandardNormal(Seed_w);
     w.Divide(mKernel.GetSigma());
 
   }
   else if (mKernel.GetKernelName() == "IsotropicLaplace") {
 
     // Multivariate student-t of degree 1, scaled by 1/sigma
-    w.SetMultivariateStudentT1();
+    w.SetMultivariateStudentT1(Seed_w);
     w.Divide(mKernel.GetSigma());
 
   }
   else if (mKernel.GetKernelName() == "ProductLaplace") {
 
     // Student-t of degree 1, scaled by 1/sigma
-    w.SetStudentT1();
+    w.SetStudentT1(Seed_w);
     w.Divide(mKernel.GetSigma());
 
   }
@@ -124,7 +125,7 @@ Train(const Kernel &mKernel, double lambda,
 
   // b = rand(1,r)*2*pi
   b.Init(r);
-  b.SetUniformRandom01();
+  b.SetUniformRandom01(Seed_b);
   b.Multiply(2.0*M_PI);
 
   // Z = cos(X*w+repmat(b,n,1)) * sqrt(2/r) * sqrt(s).
@@ -199,8 +200,9 @@ TrainAlt(const Kernel &mKernel, double lambda,
          const PointArray &Xtrain,
          long r, unsigned Seed, double &mem_est) {
 
-  // Seed the RNG
-  srandom(Seed);
+  // Seeds of the parallel RNG streams for w and b
+  unsigned long Seed_w = 2*(unsigned long)Seed;
+  unsigned long Seed_b = 2*(unsigned long)Seed + 1;
 
   // Dimensions
   long N = Xtrain.GetN();
@@ -212,21 +214,21 @@ TrainAlt(const Kernel &mKernel, double lambda,
   if (mKernel.GetKernelName() == "IsotropicGaussian") {
 
     // Standard normal scaled by 1/sigma
-    w.SetStandardNormal();
+    w.SetStandardNormal(Seed_w);
     w.Divide(mKernel.GetSigma());
 
   }
   else if (mKernel.GetKernelName() == "IsotropicLaplace") {
 
     // Multivariate student-t of degree 1, scaled by 1/sigma
-    w.SetMultivariateStudentT1();
+    w.SetMultivariateStudentT1(Seed_w);
     w.Divide(mKernel.GetSigma());
 
   }
   else if (mKernel.GetKernelName() == "ProductLaplace") {
 
     // Student-t of degree 1, scaled by 1/sigma
-    w.SetStudentT1();
+    w.SetStudentT1(Seed_w);
     w.Divide(mKernel.GetSigma());
 
   }
@@ -239,7 +241,7 @@ TrainAlt(const Kernel &mKernel, double lambda,
 
   // b = rand(1,r)*2*pi
   b.Init(r);
-  b.SetUniformRandom01();
+  b.SetUniformRandom01(Seed_b);
   b.Multiply(2.0*M_PI);
 
   // Z = cos(X*w+repmat(b,n,1)) * sqrt(2/r) * sqrt(s).
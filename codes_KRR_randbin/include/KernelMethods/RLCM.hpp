@@ -74,6 +74,17 @@ public:
                bool verbose,
                DMatrix &Ytest_predict);
 
+  // Testing on another set of points after TestAlt. The coefficients
+  // computed in TestAlt, together with the upward pass over the
+  // training tree (which does not depend on the test points), are
+  // kept in the model, so that each call only routes the new test
+  // points through the tree. TestAlt must have been called before.
+  void TestAltCached(const Kernel &mKernel, double lambda,
+                     const PointArray &Xtrain, // Must use permuted Xtrain
+                                               // after training
+                     const PointArray &Xtest,
+                     DMatrix &Ytest_predict);
+
   double TrainPerf(const DVector &ytrain_truth, const DMatrix &Ytrain_predict,
         const int NumClasses);
 
@@ -87,6 +98,11 @@ private:
   double ymean; // Stored in Train but not stored in TrainAlt
   CMatrix invK; // Not stored in Train but stored in TrainAlt
 
+  // Stored in TestAlt and used by TestAltCached
+  DMatrix Calt;         // Coefficients inv(K)*(Y-ymean)
+  DVector ymeanAlt;     // Column means of Y
+  bool UpwardCached;    // Whether K holds the upward pass on Calt
+
 };
 
 #include "RLCM.tpp"
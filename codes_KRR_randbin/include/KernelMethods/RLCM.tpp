@@ -25,9 +25,12 @@ Init(void) {
 template<class Kernel, class Point, class PointArray>
 void RLCM<Kernel, Point, PointArray>::
 ReleaseAllMemory(void) {
-  K.ReleaseAllMemory();
+  K.ReleaseAllMemory(); // Also frees the upward pass kept in the tree
+  UpwardCached = false;
   c.ReleaseAllMemory();
   invK.ReleaseAllMemory();
+  Calt.ReleaseAllMemory();
+  ymeanAlt.ReleaseAllMemory();
   ymean = INITVAL_ymean;
 }
 
@@ -61,6 +64,10 @@ DeepCopy(const RLCM &G) {
   c = G.c;
   ymean = G.ymean;
   invK = G.invK;
+  Calt = G.Calt;
+  ymeanAlt = G.ymeanAlt;
+  // The upward pass is redone lazily by TestAltCached
+  UpwardCached = false;
 }
 
 
@@ -96,6 +103,7 @@ Train(const Kernel &mKernel, double lambda,
   START_CLOCK;
   bool success = K.BuildKernelMatrix<Kernel, Point, PointArray>
     (Xtrain, Perm, iPerm, mKernel, lambda, r, N0);
+  UpwardCached = false;
   END_CLOCK;
   if (verbose) {
     printf("RLCM::Train. Time (in seconds) for construting K: %g\n", ELAPSED_TIME);fflush(stdout);
@@ -219,6 +227,7 @@ TrainAlt(const Kernel &mKernel, double lambda,
   START_CLOCK;
   bool success = K.BuildKernelMatrix<Kernel, Point, PointArray>
     (Xtrain, Perm, iPerm, mKernel, lambda, r, N0);
+  UpwardCached = false;
   END_CLOCK;
   if (verbose) {
     printf("RLCM::TrainAlt. Time (in seconds) for construting K: %g\n", ELAPSED_TIME);fflush(stdout);
@@ -258,10 +267,11 @@ TestAlt(const Kernel &mKernel, double lambda,
         DMatrix &Ytest_predict) {
 
   int m = Ytrain.GetN();
-  double *ymean2 = NULL;
-  New_1D_Array<double, int>(&ymean2, m);
   long N = Xtrain.GetN();
-  DMatrix C(N, m);
+  ymeanAlt.Init(m);
+  double *ymean2 = ymeanAlt.GetPointer();
+  Calt.Init(N, m);
+  DMatrix &C = Calt;
 
   PREPARE_CLOCK(verbose);
 
@@ -320,12 +330,45 @@ TestAlt(const Kernel &mKernel, double lambda,
     printf("RLCM::TestAlt. Training error for %d classes = %g\n", m, 100-Perf);fflush(stdout);
   }
 
+  // K0 = phi(Xtest,Xtrain)
+  // y = K0*c + ymean
+  // The upward pass on C is kept for later calls of TestAltCached
+  UpwardCached = false;
+  TestAltCached(mKernel, lambda, Xtrain, Xtest, Ytest_predict);
+
+}
+
+
+//--------------------------------------------------------------------------
+template<class Kernel, class Point, class PointArray>
+void RLCM<Kernel, Point, PointArray>::
+TestAltCached(const Kernel &mKernel, double lambda,
+              const PointArray &Xtrain,
+              const PointArray &Xtest,
+              DMatrix &Ytest_predict) {
+
+  if (Calt.GetN() == 0) {
+    printf("RLCM::TestAltCached. Error: TestAlt has not been called. Function call takes no effect\n");
+    return;
+  }
+
+  // Upward pass over the training tree; independent of Xtest
+  if (!UpwardCached) {
+    UpwardCached = K.EvalKernelMatAndDoMatMatPrepare
+      <Kernel, Point, PointArray>(Xtrain, Calt);
+    if (!UpwardCached) {
+      return;
+    }
+  }
+
   // K0 = phi(Xtest,Xtrain)
   // y = K0*c
-  K.EvalKernelMatAndDoMatMat<Kernel, Point, PointArray>
-    (Xtrain, Xtest, mKernel, lambda, C, Ytest_predict);
+  K.EvalKernelMatAndDoMatMatApply<Kernel, Point, PointArray>
+    (Xtrain, Xtest, mKernel, lambda, Calt, Ytest_predict);
 
   // y = K0*c + ymean
+  int m = Calt.GetN();
+  double *ymean2 = ymeanAlt.GetPointer();
   for (int i = 0; i < m; i++) {
     DVector ytest_predict;
     Ytest_predict.GetColumn(i, ytest_predict);
@@ -334,9 +377,6 @@ TestAlt(const Kernel &mKernel, double lambda,
 
   }
 
-  // Clean up
-  Delete_1D_Array<double>(&ymean2);
-
 }
 
 // lingfei: for computing training error
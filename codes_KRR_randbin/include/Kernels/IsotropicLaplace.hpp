@@ -31,6 +31,7 @@ public:
   // Hard-coded kernel property
   static std::string const GetKernelName(void) { return "IsotropicLaplace"; }
   bool IsSymmetric(void) const { return true; }
+  static bool UsesDist2(void) { return true; }
 
   // Get kernel parameter sigma
   double GetS(void) const;
@@ -44,6 +45,17 @@ public:
   template<class Point>
   double Eval(const Point &x, const Point &y, double lambda = 0.0) const;
 
+  // Evaluate the kernel for a precomputed distance r between two
+  // points, where r = sum_i (x_i-y_i)^2 (Dist2). Used by the
+  // sparse fast path of DMatrix::BuildKernelMatrix.
+  double EvalDist(double r, double lambda = 0.0) const {
+    double ret = s * exp(-sqrt(r)/sigma);
+    if (r == 0.0) {
+      ret += lambda;
+    }
+    return ret;
+  }
+
 protected:
 
 private:
@@ -5,6 +5,7 @@
 #define _BMATRIX_
 
 #include "Node.hpp"
+#include "SparseOps.hpp"
 
 // When multiplying a block diagonal matrix A with a vector, one needs
 // to distinguish two cases: (ORIGINAL) the usual case; (FACTORED) the
@@ -211,7 +211,7 @@ EvalKernelMatAndDoMatVecDownward(Node *mNode, const PointArray &X,
     // partitioning.
     Point y0;
     y.GetPoint(0, y0);
-    double iprod = y0.InProd(mNode->normal);
+    double iprod = PointInProd(y0, mNode->normal);
     if (iprod < mNode->offset) {
       child = mNode->LeftChild;
     }
@@ -301,7 +301,7 @@ EvalKernelMatAndDoMatMatDownward(Node *mNode, const PointArray &X,
     // partitioning.
     Point y0;
     y.GetPoint(0, y0);
-    double iprod = y0.InProd(mNode->normal);
+    double iprod = PointInProd(y0, mNode->normal);
     if (iprod < mNode->offset) {
       child = mNode->LeftChild;
     }
@@ -5,6 +5,7 @@
 #define _CMATRIX_
 
 #include "Node.hpp"
+#include "SparseOps.hpp"
 
 class CMatrix {
 
@@ -85,6 +86,29 @@ public:
                                 DMatrix &Z             // Z = K'*W
                                 );
 
+  // EvalKernelMatAndDoMatMat split into its phases, for repeated
+  // calls with the same W but different sets of new points Y. The
+  // upward pass over the tree depends only on W; Prepare performs it
+  // and keeps the results (C and D in each node). Apply may then be
+  // called any number of times, each time routing only the points Y
+  // through the tree. Release frees the kept results. The kept
+  // results are invalidated by any other call of Prepare or of
+  // EvalKernelMatAndDoMatMat.
+  template<class Kernel, class Point, class PointArray>
+  bool EvalKernelMatAndDoMatMatPrepare(const PointArray &X, // Points (after permut.)
+                                       const DMatrix &W  // The matrix to multiply
+                                       );
+  template<class Kernel, class Point, class PointArray>
+  void EvalKernelMatAndDoMatMatApply(const PointArray &X,   // Points (after permut.)
+                                     const PointArray &Y,   // New points
+                                     const Kernel &mKernel, // Kernel
+                                     double lambda,         // Regularization
+                                     const DMatrix &W,      // Same W as in Prepare
+                                     DMatrix &Z             // Z = K'*W
+                                     );
+  template<class Kernel, class Point, class PointArray>
+  void EvalKernelMatAndDoMatMatRelease(void);
+
   //-------------------- Inspect tree structure --------------------
 
   void PrintTree(void) const;
@@ -367,7 +367,7 @@ EvalKernelMatAndDoMatVecUpward2(Node *mNode, const PointArray &X,
     // partitioning.
     Point y0;
     y.GetPoint(0, y0);
-    double iprod = y0.InProd(mNode->normal);
+    double iprod = PointInProd(y0, mNode->normal);
     if (iprod < mNode->offset) {
       child = mNode->LeftChild;
     }
@@ -414,14 +414,54 @@ EvalKernelMatAndDoMatMat(const PointArray &X,   // Points (after permut.)
     return;
   }
 
-  long n = Y.GetN();
-  long m = W.GetN();
-  Z.Init(n,m);
+  EvalKernelMatAndDoMatMatPrepare<Kernel, Point, PointArray>(X, W);
+  EvalKernelMatAndDoMatMatApply<Kernel, Point, PointArray>
+    (X, Y, mKernel, lambda, W, Z);
+  EvalKernelMatAndDoMatMatRelease<Kernel, Point, PointArray>();
+
+}
+
+
+//--------------------------------------------------------------------------
+template<class Kernel, class Point, class PointArray>
+bool CMatrix::
+EvalKernelMatAndDoMatMatPrepare(const PointArray &X, // Points (after permut.)
+                                const DMatrix &W  // The matrix to multiply
+                                ) {
+
+  if (Root == NULL) {
+    printf("CMatrix::EvalKernelMatAndDoMatMatPrepare. Error: Matrix is empty. Function call takes no effect\n");
+    return false;
+  }
+  if (W.GetM() != X.GetN()) {
+    printf("CMatrix::EvalKernelMatAndDoMatMatPrepare. Error: Size of W does not match number of points in X. Function call takes no effect\n");
+    return false;
+  }
 
   EvalKernelMatAndDoMatMatInitAugmentedData<Kernel, Point, PointArray>(Root, W);
 
   EvalKernelMatAndDoMatMatUpward1<Kernel, Point, PointArray>(Root, W);
 
+  return true;
+
+}
+
+
+//--------------------------------------------------------------------------
+template<class Kernel, class Point, class PointArray>
+void CMatrix::
+EvalKernelMatAndDoMatMatApply(const PointArray &X,   // Points (after permut.)
+                              const PointArray &Y,   // New points
+                              const Kernel &mKernel, // Kernel
+                              double lambda,         // Regularization
+                              const DMatrix &W,      // Same W as in Prepare
+                              DMatrix &Z             // Z = K'*W
+                              ) {
+
+  long n = Y.GetN();
+  long m = W.GetN();
+  Z.Init(n,m);
+
   // Do mat-mat for one point at a time
   for (long i = 0; i < n; i++) {
     PointArray y;
@@ -432,6 +472,18 @@ EvalKernelMatAndDoMatMat(const PointArray &X,   // Points (after permut.)
     Z.SetRow(i, z0);
   }
 
+}
+
+
+//--------------------------------------------------------------------------
+template<class Kernel, class Point, class PointArray>
+void CMatrix::
+EvalKernelMatAndDoMatMatRelease(void) {
+
+  if (Root == NULL) {
+    return;
+  }
+
   EvalKernelMatAndDoMatMatReleaseAugmentedData<Kernel, Point, PointArray>(Root);
 
 }
@@ -587,7 +639,7 @@ EvalKernelMatAndDoMatMatUpward2(Node *mNode, const PointArray &X,
     // partitioning.
     Point y0;
     y.GetPoint(0, y0);
-    double iprod = y0.InProd(mNode->normal);
+    double iprod = PointInProd(y0, mNode->normal);
     if (iprod < mNode->offset) {
       child = mNode->LeftChild;
     }
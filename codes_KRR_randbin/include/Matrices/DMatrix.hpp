@@ -74,6 +74,14 @@ public:
   void SetStudentT1(void);
   // Each column of A is a multivariate student-t of degree 1
   void SetMultivariateStudentT1(void);
+  // Same as above, but using the parallel counter-based generators
+  // (see ParRandom.hpp) with the given seed. The result depends only
+  // on the seed, not on the number of threads, and the state of
+  // random() is untouched.
+  void SetUniformRandom01(unsigned long Seed);
+  void SetStandardNormal(unsigned long Seed);
+  void SetStudentT1(unsigned long Seed);
+  void SetMultivariateStudentT1(unsigned long Seed);
   // A = diag(b)
   void MakeDiag(const DVector &b);
 
@@ -88,6 +96,9 @@ public:
   //
   //   long GetN(void) const;
   //   void GetPoint(long i, DPoint &x) const;
+  //
+  // For sparse points (SPointArray), a fast path that requires the
+  // kernel to also provide UsesDist2() and EvalDist() is used.
   template<class Kernel, class Point, class PointArray>
   void BuildKernelMatrix(const Kernel &mKernel, const PointArray &X,
                          double lambda = 0.0);
@@ -2,6 +2,38 @@
 #define _DMATRIX_TPP_
 
 
+//--------------------------------------------------------------------------
+inline void DMatrix::SetUniformRandom01(unsigned long Seed) {
+  ParUniformRandom01(GetPointer(), GetM()*GetN(), Seed);
+}
+
+inline void DMatrix::SetStandardNormal(unsigned long Seed) {
+  ParStandardNormal(GetPointer(), GetM()*GetN(), Seed);
+}
+
+inline void DMatrix::SetStudentT1(unsigned long Seed) {
+  ParStudentT1(GetPointer(), GetM()*GetN(), Seed);
+}
+
+// Columns are contiguous (column major)
+inline void DMatrix::SetMultivariateStudentT1(unsigned long Seed) {
+  ParMultivariateStudentT1(GetPointer(), GetM(), GetN(), Seed);
+}
+
+
+//--------------------------------------------------------------------------
+// Fast path of BuildKernelMatrix for a specific point array type. The
+// generic version declines (returns false) so that the point-by-point
+// evaluation is used. Overloads for specific point array types (see
+// SPointArray.hpp) fill the column-major M*N array A and return true.
+template<class Kernel, class PointArray>
+bool BuildKernelMatrixFastPath(const Kernel &mKernel, const PointArray &X,
+                               const PointArray &Y, bool Symmetric,
+                               double lambda, double *A) {
+  return false;
+}
+
+
 //--------------------------------------------------------------------------
 template<class Kernel, class Point, class PointArray>
 void DMatrix::
@@ -13,6 +45,9 @@ BuildKernelMatrix(const Kernel &mKernel, const PointArray &X, double lambda) {
   }
 
   Init(X.GetN(), X.GetN());
+  if (BuildKernelMatrixFastPath(mKernel, X, X, true, lambda, A)) {
+    return;
+  }
   for (long i = 0; i < M; i++) {
     Point x;
     X.GetPoint(i, x);
@@ -37,6 +72,9 @@ BuildKernelMatrix(const Kernel &mKernel, const PointArray &X,
                   const PointArray &Y, double lambda) {
 
   Init(X.GetN(), Y.GetN());
+  if (BuildKernelMatrixFastPath(mKernel, X, Y, false, lambda, A)) {
+    return;
+  }
 
   if (M > N) {
 
@@ -7,6 +7,7 @@
 #define _DVECTOR_
 
 #include "../Misc/Common.hpp"
+#include "../Misc/ParRandom.hpp"
 
 class DVector {
 
@@ -54,6 +55,14 @@ public:
   void SetStudentT1(void);
   // The whole vector is a multivariate student-t of degree 1
   void SetMultivariateStudentT1(void);
+  // Same as above, but using the parallel counter-based generators
+  // (see ParRandom.hpp) with the given seed. The result depends only
+  // on the seed, not on the number of threads, and the state of
+  // random() is untouched.
+  void SetUniformRandom01(unsigned long Seed);
+  void SetStandardNormal(unsigned long Seed);
+  void SetStudentT1(unsigned long Seed);
+  void SetMultivariateStudentT1(unsigned long Seed);
 
   // Permutation
   // a(i) = a(Perm(i))
@@ -154,4 +163,22 @@ private:
 
 };
 
+
+//--------------------------------------------------------------------------
+inline void DVector::SetUniformRandom01(unsigned long Seed) {
+  ParUniformRandom01(GetPointer(), GetN(), Seed);
+}
+
+inline void DVector::SetStandardNormal(unsigned long Seed) {
+  ParStandardNormal(GetPointer(), GetN(), Seed);
+}
+
+inline void DVector::SetStudentT1(unsigned long Seed) {
+  ParStudentT1(GetPointer(), GetN(), Seed);
+}
+
+inline void DVector::SetMultivariateStudentT1(unsigned long Seed) {
+  ParMultivariateStudentT1(GetPointer(), GetN(), 1, Seed);
+}
+
 #endif
@@ -0,0 +1,80 @@
+// The DistSPointArray class implements a sparse matrix Z whose rows
+// are distributed over the processes of an MPI communicator. Each
+// process holds a consecutive block of rows Z_i as an SPointArray
+// (all blocks have the same number of columns). The class provides
+// the MatVec method required by PCG::Solve, so that the normal
+// equation (Z'Z + lambda*I)w = Z'y can be solved with ATA = 1 over the
+// distributed rows:
+//
+//   NORMAL:    y_i = Z_i*b     b is replicated, y_i is local
+//   TRANSPOSE: y = sum_i Z_i'*b_i     b_i is local, y is replicated
+//
+// The sum in TRANSPOSE is an MPI_Allreduce of a vector of length
+// GetD(). Hence, in PCG::Solve, the Gram product Z'(Zp) costs one
+// allreduce per iteration and all the vectors of length GetD() (x, r,
+// p) are replicated; the inner products and the scalars alpha, beta
+// are computed redundantly and identically by all processes.
+//
+// The local block is an SPointArray by default; any row block type
+// with GetD, GetN and MatVec, e.g., PackedBinMatrix, may be given as
+// the template argument. The class does not own the local block.
+// Requires -DUSE_MPI.
+
+#ifndef _DIST_SPOINT_ARRAY_
+#define _DIST_SPOINT_ARRAY_
+
+#include <mpi.h>
+#include "SPointArray.hpp"
+
+template <class LocalMatrix = SPointArray>
+class DistSPointArray {
+
+public:
+
+  DistSPointArray() : Local(NULL), Comm(MPI_COMM_WORLD) {}
+  DistSPointArray(const LocalMatrix &Local_, MPI_Comm Comm_ = MPI_COMM_WORLD)
+    : Local(&Local_), Comm(Comm_) {}
+
+  void Init(const LocalMatrix &Local_, MPI_Comm Comm_ = MPI_COMM_WORLD) {
+    Local = &Local_;
+    Comm = Comm_;
+  }
+
+  //-------------------- Utilities --------------------
+
+  // Get number of columns
+  int GetD(void) const { return Local->GetD(); }
+
+  // Get number of local rows
+  long GetLocalN(void) const { return Local->GetN(); }
+
+  // Get total number of rows
+  long GetN(void) const {
+    long n = Local->GetN(), N = 0;
+    MPI_Allreduce(&n, &N, 1, MPI_LONG, MPI_SUM, Comm);
+    return N;
+  }
+
+  // Get the local block
+  const LocalMatrix& GetLocal(void) const { return *Local; }
+
+  //-------------------- Computations --------------------
+
+  // y = Z*b (ModeA = NORMAL, local rows) or y = Z'*b (ModeA =
+  // TRANSPOSE, summed over all processes)
+  void MatVec(const DVector &b, DVector &y, MatrixMode ModeA) const {
+    Local->MatVec(b, y, ModeA);
+    if (ModeA == TRANSPOSE) {
+      MPI_Allreduce(MPI_IN_PLACE, y.GetPointer(), (int)y.GetN(),
+                    MPI_DOUBLE, MPI_SUM, Comm);
+    }
+  }
+
+private:
+
+  const LocalMatrix *Local;
+  MPI_Comm Comm;
+
+};
+
+#endif
@@ -7,5 +7,9 @@
 #include "CMatrix.hpp"
 #include "DPointArray.hpp"
 #include "SPointArray.hpp"
+#include "PackedBinMatrix.hpp"
+#ifdef USE_MPI
+#include "DistSPointArray.hpp"
+#endif
 
 #endif
@@ -0,0 +1,290 @@
+// The PackedBinMatrix class implements the feature matrix Z of random
+// binning in a compressed form. Each row of Z has one nonzero in each
+// of the r grids, and the bins of grid j occupy a contiguous range of
+// columns Base_j+1, ..., Base_j+NumBins_j. Instead of an (int, double)
+// pair per nonzero as in SPointArray, the column of row i in grid j is
+// stored as the local bin id v = col - Base_j + 1 (v = 0 for no
+// nonzero, e.g., an empty row) in Width_j = ceil(log2(NumBins_j+1))
+// bits. The ids of a grid are packed into one bit stream of 64-bit
+// words, grid by grid (grid-major), and all the nonzeros of a row
+// share one value, Scale_i:
+//
+//   Z(i, Base_j + v - 1) = Scale_i,   v = Id_j(i) > 0
+//
+// Scale_i is stored once if it is the same for all the rows, and per
+// row otherwise (e.g., the rows merged by group_binning_rows are scaled
+// by sqrt(count)). At small sigma a grid has a few hundred bins and
+// an id takes 8 to 10 bits, against 96 bits in SPointArray.
+//
+// The class provides the MatVec method required by PCG::Solve and the
+// MatMat method for the predictions; the ids are decoded on the fly,
+// with one unaligned 64-bit load, a shift and a mask per id:
+//
+//   NORMAL:    y = Z*b      rows in blocks of BlockRows, in parallel
+//   TRANSPOSE: y = Z'*b     grids in parallel (disjoint columns)
+//
+// NORMAL sums the entries of b of a row and multiplies the sum by
+// Scale_i, instead of summing Scale_i*b as SPointArray does, so the
+// results agree with SPointArray up to rounding only.
+
+#ifndef _PACKED_BIN_MATRIX_
+#define _PACKED_BIN_MATRIX_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <utility>
+#include "DVector.hpp"
+#include "DMatrix.hpp"
+
+class PackedBinMatrix {
+
+public:
+
+  PackedBinMatrix() : N(0), D(0), r(0), Scale(0.0) {}
+
+  // Pack the rows istart to istart+n-1 of the random binning features
+  // (r nonzeros per row, 1-based indices, the nonzeros of a row with
+  // the same value) of dimension dd. Returns false if a row has
+  // different nonzero values.
+  bool Init(const std::vector< std::vector< std::pair<int,double> > > &instances,
+            long istart, long n, int r_, long dd) {
+    std::vector<long> rows(n);
+    for (long i = 0; i < n; i++) {
+      rows[i] = istart + i;
+    }
+    return Init(instances, rows, std::vector<double>(), r_, dd);
+  }
+
+  // Same as above for the rows rows[0], rows[1], ..., each scaled by
+  // RowFactor[i] if RowFactor is not empty.
+  bool Init(const std::vector< std::vector< std::pair<int,double> > > &instances,
+            const std::vector<long> &rows,
+            const std::vector<double> &RowFactor, int r_, long dd) {
+    N = rows.size();
+    D = dd;
+    r = r_;
+    Base.assign(r, 0);
+    Width.assign(r, 0);
+    WordStart.assign(r+1, 0);
+    RowScale.assign(N, 0.0);
+
+    // Column range and bit width of each grid; value of each row
+    std::vector<long> MinCol(r, dd), MaxCol(r, -1);
+    for (long i = 0; i < N; i++) {
+      const std::vector< std::pair<int,double> > &ins = instances[rows[i]];
+      double s = 0.0;
+      for (int j = 0; j < r; j++) {
+        if (ins[j].second == 0.0) {
+          continue;
+        }
+        if (s == 0.0) {
+          s = ins[j].second;
+        }
+        else if (ins[j].second != s) {
+          printf("PackedBinMatrix::Init. Error: Row %ld has different nonzero values.\n", rows[i]);
+          return false;
+        }
+        long col = ins[j].first-1;
+        MinCol[j] = col < MinCol[j] ? col : MinCol[j];
+        MaxCol[j] = col > MaxCol[j] ? col : MaxCol[j];
+      }
+      RowScale[i] = RowFactor.empty() ? s : s*RowFactor[i];
+    }
+    // The empty rows have no nonzeros and take any scale
+    Scale = 0.0;
+    bool Uniform = true;
+    for (long i = 0; i < N; i++) {
+      if (Scale == 0.0) {
+        Scale = RowScale[i];
+      }
+      Uniform = Uniform && (RowScale[i] == Scale || RowScale[i] == 0.0);
+    }
+    if (Uniform) {
+      std::vector<double>().swap(RowScale);
+    }
+    for (int j = 0; j < r; j++) {
+      long NumIds = MaxCol[j] >= MinCol[j] ? MaxCol[j] - MinCol[j] + 1 : 0;
+      Base[j] = NumIds > 0 ? MinCol[j] : 0;
+      int w = 0;
+      while (w < 57 && (1L << w) <= NumIds) {
+        w++;
+      }
+      if ((1L << w) <= NumIds) {
+        printf("PackedBinMatrix::Init. Error: Grid %d has too many bins.\n", j);
+        return false;
+      }
+      Width[j] = w;
+      // one padding word, so that the 64-bit loads of Extract stay
+      // within the stream
+      WordStart[j+1] = WordStart[j] + ((long)N*w + 63)/64 + 1;
+    }
+
+    // Pack; threads write whole words of a grid, hence grids in parallel
+    Words.assign(WordStart[r], 0);
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int j = 0; j < r; j++) {
+      int w = Width[j];
+      if (w == 0) {
+        continue;
+      }
+      uint64_t *S = &Words[WordStart[j]];
+      for (long i = 0; i < N; i++) {
+        const std::pair<int,double> &e = instances[rows[i]][j];
+        uint64_t v = e.second == 0.0 ? 0 : (uint64_t)(e.first-1 - Base[j] + 1);
+        long bit = i*w;
+        S[bit >> 6] |= v << (bit & 63);
+        if ((bit & 63) + w > 64) {
+          S[(bit >> 6) + 1] |= v >> (64 - (bit & 63));
+        }
+      }
+    }
+    return true;
+  }
+
+  //-------------------- Utilities --------------------
+
+  // Get number of rows
+  long GetN(void) const { return N; }
+
+  // Get number of columns
+  long GetD(void) const { return D; }
+
+  // Get number of grids (nonzeros per row)
+  int GetR(void) const { return r; }
+
+  // Get number of bits per id of grid j
+  int GetWidth(int j) const { return Width[j]; }
+
+  // Get the memory of the packed ids and of the scales, in bytes
+  long GetMemBytes(void) const {
+    return (long)Words.size()*sizeof(uint64_t) + (long)RowScale.size()*sizeof(double)
+      + (long)r*(sizeof(long) + sizeof(int) + sizeof(long));
+  }
+
+  // Get the id of row i in grid j
+  long GetId(long i, int j) const {
+    return Extract(&Words[WordStart[j]], i, Width[j]);
+  }
+
+  //-------------------- Computations --------------------
+
+  // y = Z*b (ModeA = NORMAL) or y = Z'*b (ModeA = TRANSPOSE)
+  void MatVec(const DVector &b, DVector &y, MatrixMode ModeA) const {
+    if (ModeA == NORMAL) {
+      y.Init(N);
+      MatMatNormal(b.GetPointer(), D, 1, y.GetPointer(), N);
+    }
+    else {
+      y.Init(D);
+      const double *mb = b.GetPointer();
+      double *my = y.GetPointer();
+      std::vector<double> bs(mb, mb + N);
+      for (long i = 0; i < N; i++) {
+        bs[i] *= RowScale.empty() ? Scale : RowScale[i];
+      }
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+      for (int j = 0; j < r; j++) {
+        int w = Width[j];
+        if (w == 0) {
+          continue;
+        }
+        const uint64_t *S = &Words[WordStart[j]];
+        double *yj = my + Base[j] - 1;
+        for (long i = 0; i < N; i++) {
+          long v = Extract(S, i, w);
+          if (v) {
+            yj[v] += bs[i];
+          }
+        }
+      }
+    }
+  }
+
+  // Y = Z*B, only for ModeA = ModeB = NORMAL
+  void MatMat(const DMatrix &B, DMatrix &Y,
+              MatrixMode ModeA, MatrixMode ModeB) const {
+    if (ModeA != NORMAL || ModeB != NORMAL) {
+      printf("PackedBinMatrix::MatMat. Error: Only NORMAL, NORMAL is supported.\n");
+      return;
+    }
+    long m = B.GetN();
+    Y.Init(N, m);
+    MatMatNormal(B.GetPointer(), B.GetM(), m, Y.GetPointer(), N);
+  }
+
+private:
+
+  long N;                         // Number of rows
+  long D;                         // Number of columns
+  int r;                          // Number of grids
+  double Scale;                   // Value of the nonzeros, if uniform
+  std::vector<double> RowScale;   // Value of the nonzeros of each row, or empty
+  std::vector<long> Base;         // Column of id 1 of each grid, 0-based
+  std::vector<int> Width;         // Bits per id of each grid
+  std::vector<long> WordStart;    // First word of each grid, length r+1
+  std::vector<uint64_t> Words;    // Packed ids
+
+  static const long BlockRows = 4096;
+
+  // Id i of the stream S of w-bit ids; the 64-bit load at the byte of
+  // bit i*w holds the whole id since w <= 57
+  static inline long Extract(const uint64_t *S, long i, int w) {
+    long bit = i*w;
+    uint64_t x;
+    memcpy(&x, (const unsigned char *)S + (bit >> 3), sizeof(x));
+    return (long)((x >> (bit & 7)) & ((1ULL << w) - 1));
+  }
+
+  // Y = Z*B for the m columns of B (column major, leading dimension
+  // ldb) into Y (leading dimension ldy), which is zero on entry
+  void MatMatNormal(const double *B, long ldb, long m, double *Y, long ldy) const {
+    long NumBlocks = (N + BlockRows - 1)/BlockRows;
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (long blk = 0; blk < NumBlocks; blk++) {
+      long i0 = blk*BlockRows;
+      long i1 = i0 + BlockRows < N ? i0 + BlockRows : N;
+      for (int j = 0; j < r; j++) {
+        int w = Width[j];
+        if (w == 0) {
+          continue;
+        }
+        const uint64_t *S = &Words[WordStart[j]];
+        const double *Bj = B + Base[j] - 1;
+        if (m == 1) {
+          for (long i = i0; i < i1; i++) {
+            long v = Extract(S, i, w);
+            if (v) {
+              Y[i] += Bj[v];
+            }
+          }
+          continue;
+        }
+        for (long i = i0; i < i1; i++) {
+          long v = Extract(S, i, w);
+          if (v) {
+            for (long c = 0; c < m; c++) {
+              Y[i + c*ldy] += Bj[v + c*ldb];
+            }
+          }
+        }
+      }
+      for (long c = 0; c < m; c++) {
+        double *Yc = Y + c*ldy;
+        for (long i = i0; i < i1; i++) {
+          Yc[i] *= RowScale.empty() ? Scale : RowScale[i];
+        }
+      }
+    }
+  }
+
+};
+
+#endif
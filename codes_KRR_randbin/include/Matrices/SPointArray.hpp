@@ -16,6 +16,7 @@
 #include "SPoint.hpp"
 #include "DPoint.hpp"
 #include "DMatrix.hpp"
+#include "SparseOps.hpp"
 
 class SPointArray {
 
@@ -125,4 +126,15 @@ private:
 
 };
 
+// Sparse fast path of DMatrix::BuildKernelMatrix. The squared norms
+// of the points are computed once, so that each entry of an
+// isotropic kernel costs one sparse inner product. The points are
+// accessed in place instead of being copied out by GetPoint().
+template<class Kernel>
+bool BuildKernelMatrixFastPath(const Kernel &mKernel, const SPointArray &X,
+                               const SPointArray &Y, bool Symmetric,
+                               double lambda, double *A);
+
+#include "SPointArray.tpp"
+
 #endif
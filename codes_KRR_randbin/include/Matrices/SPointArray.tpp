@@ -0,0 +1,78 @@
+#ifndef _SPOINT_ARRAY_TPP_
+#define _SPOINT_ARRAY_TPP_
+
+
+//--------------------------------------------------------------------------
+template<class Kernel>
+bool BuildKernelMatrixFastPath(const Kernel &mKernel, const SPointArray &X,
+                               const SPointArray &Y, bool Symmetric,
+                               double lambda, double *A) {
+
+  long M = X.GetN();
+  long N = Y.GetN();
+  long *xstart = X.GetPointerStart();
+  int *xidx = X.GetPointerIdx();
+  double *xx = X.GetPointerX();
+  long *ystart = Y.GetPointerStart();
+  int *yidx = Y.GetPointerIdx();
+  double *yy = Y.GetPointerX();
+  bool UsesDist2 = Kernel::UsesDist2();
+
+  // Squared norms of the points
+  double *xnorm2 = NULL, *ynorm2 = NULL;
+  if (UsesDist2) {
+    New_1D_Array_Aligned<double, long>(&xnorm2, M);
+    New_1D_Array_Aligned<double, long>(&ynorm2, N);
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (long i = 0; i < M; i++) {
+      xnorm2[i] = SparseSquaredNorm(xx + xstart[i],
+                                    (int)(xstart[i+1] - xstart[i]));
+    }
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (long j = 0; j < N; j++) {
+      ynorm2[j] = SparseSquaredNorm(yy + ystart[j],
+                                    (int)(ystart[j+1] - ystart[j]));
+    }
+  }
+
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(dynamic,16)
+#endif
+  for (long j = 0; j < N; j++) {
+    const int *idx2 = yidx + ystart[j];
+    const double *x2 = yy + ystart[j];
+    int nnz2 = (int)(ystart[j+1] - ystart[j]);
+    long iend = Symmetric ? j+1 : M;
+    for (long i = 0; i < iend; i++) {
+      const int *idx1 = xidx + xstart[i];
+      const double *x1 = xx + xstart[i];
+      int nnz1 = (int)(xstart[i+1] - xstart[i]);
+      double r = 0.0;
+      if (UsesDist2) {
+        double iprod = SparseInProd(idx1, x1, nnz1, idx2, x2, nnz2);
+        r = SparseDist2(xnorm2[i], ynorm2[j], iprod,
+                        idx1, x1, nnz1, idx2, x2, nnz2);
+      }
+      else {
+        r = SparseDist1(idx1, x1, nnz1, idx2, x2, nnz2);
+      }
+      A[j*M+i] = mKernel.EvalDist(r, lambda);
+      if (Symmetric) {
+        A[i*M+j] = A[j*M+i];
+      }
+    }
+  }
+
+  Delete_1D_Array_Aligned<double>(&xnorm2);
+  Delete_1D_Array_Aligned<double>(&ynorm2);
+
+  return true;
+
+}
+
+
+#endif
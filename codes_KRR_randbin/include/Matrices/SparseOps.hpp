@@ -0,0 +1,204 @@
+// This file contains inline kernels for inner products and distances
+// involving sparse data points. They operate directly on the index
+// and value arrays of the sparse format (see the SPoint class) and
+// are used by the template methods that evaluate kernels over many
+// pairs of points, where the per-pair cost matters.
+//
+// Sparse-sparse inner products use a branch-free merge when the two
+// index lists have comparable lengths, and a galloping (exponential)
+// search of the shorter list into the longer one otherwise.
+// Sparse-dense inner products are gathers. Squared Euclidean
+// distances are computed from precomputed squared norms:
+//
+//   |x-y|^2 = |x|^2 + |y|^2 - 2*x'*y,
+//
+// with a fallback to a direct merge when cancellation dominates.
+
+#ifndef _SPARSE_OPS_
+#define _SPARSE_OPS_
+
+#include "../Misc/Common.hpp"
+#include "SPoint.hpp"
+#include "DPoint.hpp"
+
+// Ratio of index list lengths beyond which galloping is used
+#define SPARSE_GALLOP_RATIO 8
+
+
+//--------------------------------------------------------------------------
+// First position k >= lo in idx[0..n-1] with idx[k] >= key (n if none)
+inline int SparseGallop(const int *idx, int lo, int n, int key) {
+  int step = 1, hi = lo;
+  while (hi < n && idx[hi] < key) {
+    lo = hi + 1;
+    hi += step;
+    step <<= 1;
+  }
+  if (hi > n) {
+    hi = n;
+  }
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (idx[mid] < key) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+
+//--------------------------------------------------------------------------
+// x'*y, both sparse. Indices must be sorted increasingly.
+inline double SparseInProd(const int *idx1, const double *x1, int nnz1,
+                           const int *idx2, const double *x2, int nnz2) {
+  if (nnz1 > nnz2) {
+    Swap(idx1, idx2);
+    Swap(x1, x2);
+    Swap(nnz1, nnz2);
+  }
+  double sum = 0.0;
+  if (nnz1 == 0) {
+    return sum;
+  }
+  if ((long)nnz1 * SPARSE_GALLOP_RATIO < (long)nnz2) {
+    int j = 0;
+    for (int i = 0; i < nnz1 && j < nnz2; i++) {
+      j = SparseGallop(idx2, j, nnz2, idx1[i]);
+      if (j < nnz2 && idx2[j] == idx1[i]) {
+        sum += x1[i] * x2[j++];
+      }
+    }
+  }
+  else {
+    int i = 0, j = 0;
+    while (i < nnz1 && j < nnz2) {
+      int a = idx1[i], b = idx2[j];
+      sum += (a == b) ? x1[i] * x2[j] : 0.0;
+      i += (a <= b);
+      j += (b <= a);
+    }
+  }
+  return sum;
+}
+
+
+//--------------------------------------------------------------------------
+// x'*y, x sparse and y dense
+inline double SparseDenseInProd(const int *idx, const double *x, int nnz,
+                                const double *y) {
+  double sum = 0.0;
+#ifdef USE_OPENMP
+#pragma omp simd reduction(+:sum)
+#endif
+  for (int i = 0; i < nnz; i++) {
+    sum += x[i] * y[idx[i]];
+  }
+  return sum;
+}
+
+
+//--------------------------------------------------------------------------
+// x'*x, x sparse
+inline double SparseSquaredNorm(const double *x, int nnz) {
+  double sum = 0.0;
+#ifdef USE_OPENMP
+#pragma omp simd reduction(+:sum)
+#endif
+  for (int i = 0; i < nnz; i++) {
+    sum += x[i] * x[i];
+  }
+  return sum;
+}
+
+
+//--------------------------------------------------------------------------
+// sum_i |x_i-y_i|^2, both sparse, computed by merging the two points.
+// Indices must be sorted increasingly.
+inline double SparseDist2(const int *idx1, const double *x1, int nnz1,
+                          const int *idx2, const double *x2, int nnz2) {
+  double sum = 0.0;
+  int i = 0, j = 0;
+  while (i < nnz1 && j < nnz2) {
+    int a = idx1[i], b = idx2[j];
+    if (a == b) {
+      sum += Square(x1[i++] - x2[j++]);
+    }
+    else if (a < b) {
+      sum += Square(x1[i++]);
+    }
+    else {
+      sum += Square(x2[j++]);
+    }
+  }
+  for (; i < nnz1; i++) {
+    sum += Square(x1[i]);
+  }
+  for (; j < nnz2; j++) {
+    sum += Square(x2[j]);
+  }
+  return sum;
+}
+
+
+//--------------------------------------------------------------------------
+// sum_i |x_i-y_i|^2 from the squared norms and the inner product. When
+// the points are so close that cancellation dominates, the distance
+// is recomputed by merging, so that identical points yield exactly
+// zero (kernels add the regularization only for a zero distance).
+#define SPARSE_DIST2_CANCEL_TOL 1e-8
+inline double SparseDist2(double xnorm2, double ynorm2, double iprod,
+                          const int *idx1, const double *x1, int nnz1,
+                          const int *idx2, const double *x2, int nnz2) {
+  double r2 = xnorm2 + ynorm2 - 2.0 * iprod;
+  if (r2 <= SPARSE_DIST2_CANCEL_TOL * (xnorm2 + ynorm2)) {
+    r2 = SparseDist2(idx1, x1, nnz1, idx2, x2, nnz2);
+  }
+  return r2;
+}
+
+
+//--------------------------------------------------------------------------
+// sum_i |x_i-y_i|, both sparse. Indices must be sorted increasingly.
+inline double SparseDist1(const int *idx1, const double *x1, int nnz1,
+                          const int *idx2, const double *x2, int nnz2) {
+  double sum = 0.0;
+  int i = 0, j = 0;
+  while (i < nnz1 && j < nnz2) {
+    int a = idx1[i], b = idx2[j];
+    if (a == b) {
+      sum += fabs(x1[i++] - x2[j++]);
+    }
+    else if (a < b) {
+      sum += fabs(x1[i++]);
+    }
+    else {
+      sum += fabs(x2[j++]);
+    }
+  }
+  for (; i < nnz1; i++) {
+    sum += fabs(x1[i]);
+  }
+  for (; j < nnz2; j++) {
+    sum += fabs(x2[j]);
+  }
+  return sum;
+}
+
+
+//--------------------------------------------------------------------------
+// x'*y for a point x (sparse or dense) and a dense direction y. Used
+// to route a point through a hyperplane-partitioned tree.
+inline double PointInProd(const SPoint &x, const DPoint &y) {
+  return SparseDenseInProd(x.GetPointerIdx(), x.GetPointerX(), x.GetNNZ(),
+                           y.GetPointer());
+}
+
+inline double PointInProd(const DPoint &x, const DPoint &y) {
+  return x.InProd(y);
+}
+
+
+#endif
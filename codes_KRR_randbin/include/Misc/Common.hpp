@@ -13,6 +13,9 @@
 #include <string>
 #include <limits.h>
 #include <typeinfo>
+#ifdef USE_HUGEPAGES
+#include <sys/mman.h>
+#endif
 #ifdef USE_OPENBLAS
 #include <cblas.h>
 #elif USE_ESSL
@@ -22,6 +25,7 @@
 #elif USE_OPENMP
 #include <omp.h>
 #endif
+#include "MemTrack.hpp"
 
 enum MatrixMode { NORMAL, TRANSPOSE, CONJ_TRANS };
 enum SelectType { LHP, RHP };
@@ -161,6 +165,22 @@ extern "C" {
 //
 // 3b. New a 3D array of size d1*d2*d3
 //   void New_3D_Array(T ****a, T1 d1, T2 d2, T3 d3);
+//
+// 4a. Delete a 1D array allocated by New_1D_Array_Aligned
+//   void Delete_1D_Array_Aligned(T **a);
+//
+// 4b. New a 1D array of length d1 (numeric types only), aligned to
+// CACHE_LINE_SIZE bytes. The zero initialization is done in parallel
+// with a static schedule, so that under the first-touch policy each
+// page is placed on the NUMA node of the thread that will process
+// the corresponding chunk in a loop with the same static schedule.
+// With -DUSE_HUGEPAGES, arrays of at least HUGEPAGE_SIZE bytes are
+// aligned to HUGEPAGE_SIZE and advised to be backed by huge pages.
+// With -DUSE_MEMTRACK the array is charged to the current memory tag.
+// Only arrays allocated on the header side can use it: the storage of
+// DVector, DMatrix and SPointArray (hence the PCG work vectors) is
+// allocated inside the library with New_1D_Array and a serial memset.
+//   void New_1D_Array_Aligned(T **a, T1 d1);
 
 template <class T>
 void Delete_1D_Array(T **a) {
@@ -223,6 +243,45 @@ void New_3D_Array(T ****a, T1 d1, T2 d2, T3 d3) {
 }
 
 
+#define CACHE_LINE_SIZE 64
+#define HUGEPAGE_SIZE   2097152
+
+template <class T>
+void Delete_1D_Array_Aligned(T **a) {
+  MemTrackAlignedFree(*a);
+  (*a) = NULL;
+}
+
+template <class T, class T1>
+void New_1D_Array_Aligned(T **a, T1 d1) {
+  size_t bytes = (size_t)d1 * sizeof(T);
+  size_t alignment = CACHE_LINE_SIZE;
+#ifdef USE_HUGEPAGES
+  if (bytes >= HUGEPAGE_SIZE) {
+    alignment = HUGEPAGE_SIZE;
+  }
+#endif
+  void *p = MemTrackAlignedAlloc(bytes > 0 ? bytes : alignment, alignment);
+  if (p == NULL) {
+    printf("New_1D_Array_Aligned. Error: Cannot allocate %lu bytes.\n",
+           (unsigned long)bytes);
+    (*a) = NULL;
+    return;
+  }
+#ifdef USE_HUGEPAGES
+  if (bytes >= HUGEPAGE_SIZE) {
+    madvise(p, bytes, MADV_HUGEPAGE);
+  }
+#endif
+  (*a) = (T *)p;
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (long i = 0; i < (long)d1; i++) {
+    (*a)[i] = 0;
+  }
+}
+
 //--------------------------------------------------------------------------
 // Templated swap
 template <class T>
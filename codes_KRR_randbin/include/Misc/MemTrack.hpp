@@ -0,0 +1,346 @@
+// This file implements a lightweight accounting of the heap memory
+// actually allocated by the program, to complement the simplified
+// memory models (CMatrix::GetMemEst, Node::GetMemEstTree, mem_est).
+//
+// When compiled with -DUSE_MEMTRACK, the global operators new and
+// delete (plain, nothrow, sized and, with C++17 aligned new,
+// aligned) are replaced. Every allocation made through new (this
+// includes New_1D_Array, DMatrix::Init, DVector::Init inside the
+// library, and all STL containers) and through MemTrackAlignedAlloc
+// (New_1D_Array_Aligned) is charged to the current memory tag, with
+// its real size as reported by the allocator. Current and peak bytes
+// are kept per tag and in total. The cost is two relaxed atomic
+// updates per allocation. Without -DUSE_MEMTRACK, all the routines
+// below are empty or plain wrappers and nothing is replaced.
+//
+// The replaced operators are defined in this header. Hence, with
+// -DUSE_MEMTRACK, this header must be compiled into only one
+// translation unit (the one containing main()).
+//
+// Typical usage in a driver:
+//
+//   MemTrackResetPeak();
+//   {
+//     MemTagScope scope(MEM_SOLVER);
+//     ... // allocations are charged to MEM_SOLVER
+//   }
+//   MemTrackReport("Train");
+
+#ifndef _MEMTRACK_
+#define _MEMTRACK_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+enum MemTag { MEM_OTHER, MEM_DATA, MEM_BINNING, MEM_FEATURES, MEM_SOLVER,
+              MEM_MODEL, MEM_NUM_TAGS };
+
+#ifdef USE_MEMTRACK
+
+#include <malloc.h>
+#include <new>
+#include <atomic>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Bytes in front of each allocation holding its size, tag and offset
+// from the start of the block. Keeps the 16-byte alignment guaranteed
+// by malloc; allocations with a larger alignment are preceded by that
+// many bytes instead.
+#define MEMTRACK_HEADER 16
+
+struct MemTrackCounters {
+  std::atomic<long> Cur[MEM_NUM_TAGS];
+  std::atomic<long> Peak[MEM_NUM_TAGS];
+  std::atomic<long> TotalCur;
+  std::atomic<long> TotalPeak;
+  std::atomic<int> Tag; // Tag of the threads that have not set one
+};
+
+// Zero-initialized before any dynamic initialization, so that
+// allocations made during static initialization are counted too.
+inline MemTrackCounters& MemTrackGet(void) {
+  static MemTrackCounters Counters;
+  return Counters;
+}
+
+// Tag set by the calling thread within a parallel region, or -1
+inline int& MemTrackThreadTag(void) {
+  static thread_local int Tag = -1;
+  return Tag;
+}
+
+inline int MemTrackCurTag(void) {
+  int Tag = MemTrackThreadTag();
+  return Tag >= 0 ? Tag : MemTrackGet().Tag.load(std::memory_order_relaxed);
+}
+
+inline void MemTrackUpdatePeak(std::atomic<long> &Peak, long Cur) {
+  long Old = Peak.load(std::memory_order_relaxed);
+  while (Cur > Old &&
+         !Peak.compare_exchange_weak(Old, Cur, std::memory_order_relaxed)) {
+  }
+}
+
+inline void MemTrackAdd(int Tag, long Bytes) {
+  MemTrackCounters &C = MemTrackGet();
+  long Cur = C.Cur[Tag].fetch_add(Bytes, std::memory_order_relaxed) + Bytes;
+  MemTrackUpdatePeak(C.Peak[Tag], Cur);
+  Cur = C.TotalCur.fetch_add(Bytes, std::memory_order_relaxed) + Bytes;
+  MemTrackUpdatePeak(C.TotalPeak, Cur);
+}
+
+inline void MemTrackSub(int Tag, long Bytes) {
+  MemTrackCounters &C = MemTrackGet();
+  C.Cur[Tag].fetch_sub(Bytes, std::memory_order_relaxed);
+  C.TotalCur.fetch_sub(Bytes, std::memory_order_relaxed);
+}
+
+// Allocate n bytes aligned to Align (a power of two) and charge them
+// to the current tag. Not inlined, so that the compiler does not see
+// the header accesses in front of the objects of the callers.
+__attribute__((noinline))
+void* MemTrackMalloc(size_t n, size_t Align = MEMTRACK_HEADER) {
+  if (Align < MEMTRACK_HEADER) {
+    Align = MEMTRACK_HEADER;
+  }
+  char *p = NULL;
+  if (Align == MEMTRACK_HEADER) {
+    p = (char *)malloc(n + Align);
+  }
+  else if (posix_memalign((void **)&p, Align, n + Align) != 0) {
+    p = NULL;
+  }
+  if (p == NULL) {
+    return NULL;
+  }
+  long Bytes = (long)malloc_usable_size(p);
+  int Tag = MemTrackCurTag();
+  int Offset = (int)Align;
+  char *q = p + Align;
+  memcpy(q - MEMTRACK_HEADER, &Bytes, sizeof(long));
+  memcpy(q - MEMTRACK_HEADER + sizeof(long), &Tag, sizeof(int));
+  memcpy(q - MEMTRACK_HEADER + sizeof(long) + sizeof(int), &Offset, sizeof(int));
+  MemTrackAdd(Tag, Bytes);
+  return q;
+}
+
+__attribute__((noinline))
+void MemTrackFree(void *q) {
+  if (q == NULL) {
+    return;
+  }
+  char *h = (char *)q - MEMTRACK_HEADER;
+  long Bytes = 0;
+  int Tag = 0, Offset = 0;
+  memcpy(&Bytes, h, sizeof(long));
+  memcpy(&Tag, h + sizeof(long), sizeof(int));
+  memcpy(&Offset, h + sizeof(long) + sizeof(int), sizeof(int));
+  MemTrackSub(Tag, Bytes);
+  free((char *)q - Offset);
+}
+
+// Aligned allocation outside new (see New_1D_Array_Aligned); NULL on
+// failure. Free with MemTrackAlignedFree.
+inline void* MemTrackAlignedAlloc(size_t n, size_t Align) {
+  return MemTrackMalloc(n, Align);
+}
+inline void MemTrackAlignedFree(void *p) { MemTrackFree(p); }
+
+void* operator new(size_t n) {
+  void *p = MemTrackMalloc(n);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void* operator new[](size_t n) {
+  void *p = MemTrackMalloc(n);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void* operator new(size_t n, const std::nothrow_t&) noexcept {
+  return MemTrackMalloc(n);
+}
+void* operator new[](size_t n, const std::nothrow_t&) noexcept {
+  return MemTrackMalloc(n);
+}
+void operator delete(void *p) noexcept { MemTrackFree(p); }
+void operator delete[](void *p) noexcept { MemTrackFree(p); }
+void operator delete(void *p, const std::nothrow_t&) noexcept { MemTrackFree(p); }
+void operator delete[](void *p, const std::nothrow_t&) noexcept { MemTrackFree(p); }
+void operator delete(void *p, size_t) noexcept { MemTrackFree(p); }
+void operator delete[](void *p, size_t) noexcept { MemTrackFree(p); }
+
+#ifdef __cpp_aligned_new
+void* operator new(size_t n, std::align_val_t a) {
+  void *p = MemTrackMalloc(n, (size_t)a);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void* operator new[](size_t n, std::align_val_t a) {
+  void *p = MemTrackMalloc(n, (size_t)a);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void* operator new(size_t n, std::align_val_t a, const std::nothrow_t&) noexcept {
+  return MemTrackMalloc(n, (size_t)a);
+}
+void* operator new[](size_t n, std::align_val_t a, const std::nothrow_t&) noexcept {
+  return MemTrackMalloc(n, (size_t)a);
+}
+void operator delete(void *p, std::align_val_t) noexcept { MemTrackFree(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { MemTrackFree(p); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t&) noexcept { MemTrackFree(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t&) noexcept { MemTrackFree(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { MemTrackFree(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { MemTrackFree(p); }
+#endif
+
+// Set the tag to which subsequent allocations of the calling thread
+// are charged, and return the previous one. Outside a parallel region
+// the tag is set for the process: the threads that have not set their
+// own tag, such as the OpenMP threads of the next parallel regions,
+// charge their allocations to it. Within a parallel region the tag is
+// set for the calling thread only, so that concurrent threads do not
+// overwrite each other's tag.
+inline MemTag MemTrackSetTag(MemTag Tag) {
+  MemTag Old = (MemTag)MemTrackCurTag();
+#ifdef _OPENMP
+  if (omp_in_parallel()) {
+    MemTrackThreadTag() = Tag;
+    return Old;
+  }
+#endif
+  MemTrackGet().Tag.store(Tag, std::memory_order_relaxed);
+  return Old;
+}
+
+// Tag of the calling thread itself (-1 if it follows the process
+// tag), to be restored by MemTagScope
+inline int MemTrackGetThreadTag(void) { return MemTrackThreadTag(); }
+inline void MemTrackSetThreadTag(int Tag) { MemTrackThreadTag() = Tag; }
+
+// Get the current and the peak bytes of a tag, or of all tags if Tag
+// is MEM_NUM_TAGS.
+inline long MemTrackGetCur(MemTag Tag) {
+  MemTrackCounters &C = MemTrackGet();
+  return Tag == MEM_NUM_TAGS ? C.TotalCur.load() : C.Cur[Tag].load();
+}
+inline long MemTrackGetPeak(MemTag Tag) {
+  MemTrackCounters &C = MemTrackGet();
+  return Tag == MEM_NUM_TAGS ? C.TotalPeak.load() : C.Peak[Tag].load();
+}
+
+// Start a new phase: peaks are reset to the current values.
+inline void MemTrackResetPeak(void) {
+  MemTrackCounters &C = MemTrackGet();
+  for (int i = 0; i < MEM_NUM_TAGS; i++) {
+    C.Peak[i].store(C.Cur[i].load());
+  }
+  C.TotalPeak.store(C.TotalCur.load());
+}
+
+inline const char* MemTrackTagName(int Tag) {
+  static const char *Names[MEM_NUM_TAGS] =
+    { "other", "data", "binning", "features", "solver", "model" };
+  return Names[Tag];
+}
+
+// Resident set size of the process (VmRSS) and its high-water mark
+// (VmHWM) in bytes, read from /proc/self/status. Return -1 if not
+// available.
+inline void MemTrackGetRSS(long &RSS, long &HWM) {
+  RSS = -1;
+  HWM = -1;
+  FILE *fp = fopen("/proc/self/status", "r");
+  if (fp == NULL) {
+    return;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    long kb = 0;
+    if (sscanf(line, "VmRSS: %ld kB", &kb) == 1) {
+      RSS = kb * 1024;
+    }
+    else if (sscanf(line, "VmHWM: %ld kB", &kb) == 1) {
+      HWM = kb * 1024;
+    }
+  }
+  fclose(fp);
+}
+
+// Print the current and the peak bytes (since the last
+// MemTrackResetPeak) of every tag that has been used, together with
+// the process RSS.
+inline void MemTrackReport(const char *Phase) {
+  for (int i = 0; i < MEM_NUM_TAGS; i++) {
+    if (MemTrackGetPeak((MemTag)i) == 0) {
+      continue;
+    }
+    printf("MemTrack: phase = %s, tag = %s, current = %ld bytes, peak = %ld bytes\n",
+           Phase, MemTrackTagName(i), MemTrackGetCur((MemTag)i),
+           MemTrackGetPeak((MemTag)i));
+  }
+  long RSS = 0, HWM = 0;
+  MemTrackGetRSS(RSS, HWM);
+  printf("MemTrack: phase = %s, total current = %ld bytes, total peak = %ld bytes, rss = %ld bytes, rss peak = %ld bytes\n",
+         Phase, MemTrackGetCur(MEM_NUM_TAGS), MemTrackGetPeak(MEM_NUM_TAGS),
+         RSS, HWM);
+  fflush(stdout);
+}
+
+#else
+
+inline MemTag MemTrackSetTag(MemTag Tag) { return MEM_OTHER; }
+inline int MemTrackGetThreadTag(void) { return -1; }
+inline void MemTrackSetThreadTag(int Tag) {}
+inline long MemTrackGetCur(MemTag Tag) { return 0; }
+inline long MemTrackGetPeak(MemTag Tag) { return 0; }
+inline void MemTrackResetPeak(void) {}
+inline void MemTrackReport(const char *Phase) {}
+
+inline void* MemTrackAlignedAlloc(size_t n, size_t Align) {
+  void *p = NULL;
+  return posix_memalign(&p, Align, n) == 0 ? p : NULL;
+}
+inline void MemTrackAlignedFree(void *p) { free(p); }
+
+#endif
+
+
+//--------------------------------------------------------------------------
+// Charge the allocations within a scope to a tag.
+class MemTagScope {
+
+public:
+
+  MemTagScope(MemTag Tag) {
+    OldThread = MemTrackGetThreadTag();
+    Old = MemTrackSetTag(Tag);
+  }
+  ~MemTagScope() {
+    MemTrackSetTag(Old);
+    MemTrackSetThreadTag(OldThread);
+  }
+
+private:
+
+  MemTag Old;
+  int OldThread;
+
+  MemTagScope(const MemTagScope &G);
+  MemTagScope& operator= (const MemTagScope &G);
+
+};
+
+
+#endif
@@ -5,5 +5,7 @@
 
 #include "Common.hpp"
 #include "LibSVM_FileIO.hpp"
+#include "MemTrack.hpp"
+#include "ParRandom.hpp"
 
 #endif
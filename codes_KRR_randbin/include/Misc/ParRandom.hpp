@@ -0,0 +1,131 @@
+// This file implements parallel random number generators that
+// complement the serial ones in Common.hpp (UniformRandom01,
+// StandardNormal, StudentT1, MultivariateStudentT1), which draw from
+// the global state of random().
+//
+// The generators here are counter based: the k-th number of the
+// stream identified by Seed is a hash (SplitMix64 finalizer) of the
+// pair (Seed, k). Hence every entry of an array is computed
+// independently of the others, the fill loops are parallelized with
+// OpenMP and vectorized, and the output for a fixed seed is the same
+// regardless of the number of threads. The global state of random()
+// is neither used nor modified.
+//
+// Normal numbers are generated by the Box-Muller transform, one pair
+// per two consecutive counters, as in StandardNormal.
+
+#ifndef _PAR_RANDOM_
+#define _PAR_RANDOM_
+
+#include <math.h>
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+typedef unsigned long long RandomKey;
+
+
+//--------------------------------------------------------------------------
+// Scramble a 64-bit word (SplitMix64 finalizer)
+inline RandomKey ParRandomMix(RandomKey z) {
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+
+//--------------------------------------------------------------------------
+// Key of the stream identified by Seed. Nearby seeds yield unrelated
+// keys.
+inline RandomKey ParRandomKey(unsigned long Seed) {
+  return ParRandomMix((RandomKey)Seed * 0x9E3779B97F4A7C15ULL +
+                      0x632BE59BD9B4E019ULL);
+}
+
+
+//--------------------------------------------------------------------------
+// The k-th uniform number of a stream, in the open interval (0,1)
+inline double ParRandomUniform(RandomKey Key, RandomKey k) {
+  RandomKey z = ParRandomMix(Key + k * 0x9E3779B97F4A7C15ULL);
+  return ((double)(z >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+
+//--------------------------------------------------------------------------
+// Generate (0,1) uniform random numbers
+inline void ParUniformRandom01(double *a, long n, unsigned long Seed) {
+  RandomKey Key = ParRandomKey(Seed);
+#ifdef USE_OPENMP
+#pragma omp parallel for simd schedule(static)
+#endif
+  for (long i = 0; i < n; i++) {
+    a[i] = ParRandomUniform(Key, i);
+  }
+}
+
+
+//--------------------------------------------------------------------------
+// Generate Gaussian random numbers. Entries 2i and 2i+1 are the
+// Box-Muller pair from the uniform numbers 2i and 2i+1 of the stream.
+inline void ParStandardNormal(double *a, long n, unsigned long Seed) {
+  RandomKey Key = ParRandomKey(Seed);
+  long n2 = n/2;
+#ifdef USE_OPENMP
+#pragma omp parallel for simd schedule(static)
+#endif
+  for (long i = 0; i < n2; i++) {
+    double U = ParRandomUniform(Key, 2*i);
+    double V = ParRandomUniform(Key, 2*i+1);
+    double common1 = sqrt(-2.0*log(U));
+    double common2 = 2.0*M_PI*V;
+    a[2*i] = common1 * cos(common2);
+    a[2*i+1] = common1 * sin(common2);
+  }
+  if (n%2 == 1) {
+    double U = ParRandomUniform(Key, n-1);
+    double V = ParRandomUniform(Key, n);
+    a[n-1] = sqrt(-2.0*log(U)) * cos(2.0*M_PI*V);
+  }
+}
+
+
+//--------------------------------------------------------------------------
+// Generate student-t of degree 1 random numbers. A student-t of degree
+// 1 is a standard Cauchy, i.e., tan(pi*(U-1/2)) for U uniform.
+inline void ParStudentT1(double *a, long n, unsigned long Seed) {
+  RandomKey Key = ParRandomKey(Seed);
+#ifdef USE_OPENMP
+#pragma omp parallel for simd schedule(static)
+#endif
+  for (long i = 0; i < n; i++) {
+    a[i] = tan(M_PI*(ParRandomUniform(Key, i) - 0.5));
+  }
+}
+
+
+//--------------------------------------------------------------------------
+// Generate nvec random vectors of length n (stored consecutively) of
+// multivariate student-t of degree 1. Let X be a standard normal
+// vector and Y an independent standard normal. Then X/fabs(Y) is a
+// multivariate student-t of degree 1. For each vector, X is taken
+// from the stream of Seed and Y from the stream of ~Seed.
+inline void ParMultivariateStudentT1(double *a, long n, long nvec,
+                                     unsigned long Seed) {
+  ParStandardNormal(a, n*nvec, Seed);
+  RandomKey Key = ParRandomKey(~Seed);
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (long j = 0; j < nvec; j++) {
+    double U = ParRandomUniform(Key, 2*j);
+    double V = ParRandomUniform(Key, 2*j+1);
+    double b = fabs(sqrt(-2.0*log(U)) * cos(2.0*M_PI*V));
+    double *aj = a + j*n;
+    for (long i = 0; i < n; i++) {
+      aj[i] /= b;
+    }
+  }
+}
+
+
+#endif
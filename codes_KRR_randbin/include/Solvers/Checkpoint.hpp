@@ -0,0 +1,351 @@
+// The PCGCheckpoint class writes checkpoints of PCG::Solve, from which
+// a solve interrupted (e.g., by the time limit of a batch job) is
+// resumed, and keeps a log of the finished solutions of a sequence of
+// solves (e.g., one per class), so that they are not solved again.
+//
+// Each solve of the sequence has a key (SetKey). PCG::Solve calls
+//
+//   bool Restore(n, lambda, NormB, MaxIt, Iter, x, r, p, rz, Res);
+//   void operator()(Iter, x, r, p, rz, Res);
+//
+// before the first iteration and after each iteration. Restore loads
+// the state of the checkpoint file if it is that of the key, the size
+// n, lambda and the norm of the right-hand side NormB (relative
+// difference below 1e-10). operator() snapshots the state, at most
+// every Interval seconds, and hands it to a background thread, which
+// writes it to FileName.tmp and renames that to FileName: the file
+// always holds a complete checkpoint, and the solver only pays for a
+// copy of x, r and p. A snapshot taken while the previous one is being
+// written replaces the one waiting, if any. The state is that after an
+// iteration; resuming from it gives the iterates of the uninterrupted
+// solve. The state of a monitor (e.g., ValidationStop) is not saved.
+//
+// State file:
+//   char magic[8]; long Key, n; int Iter, pad
+//   double lambda, NormB, rz
+//   double x[n], r[n], p[n], Res[Iter]
+//
+// Solution log FileName.sol, appended by AddSolution through the same
+// thread (hence after the checkpoints posted before), one record per
+// solution:
+//   char magic[8]; long Key, n; double lambda; double x[n]
+// An incomplete last record (e.g., the job was killed while writing it)
+// is ignored, and cut by the first instance that writes.
+//
+// With FileName = NULL, nothing is read or written. With Write = false
+// (e.g., all the MPI processes but one), the files are read only.
+
+#ifndef _CHECKPOINT_
+#define _CHECKPOINT_
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <cmath>
+#include <map>
+#include <deque>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include "../Matrices/DVector.hpp"
+
+// Background writer of the checkpoint files: the jobs are written in
+// the order in which they are posted
+class CheckpointWriter {
+
+public:
+
+  CheckpointWriter() : Busy(false), Done(false), NumWritten(0), NumFailed(0) {
+    Thread = std::thread(&CheckpointWriter::Run, this);
+  }
+
+  // Writes the jobs posted, then returns
+  ~CheckpointWriter() {
+    {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      Done = true;
+    }
+    Cond.notify_all();
+    Thread.join();
+  }
+
+  // Replace the file Path by Data (atomically, through Path.tmp), or
+  // append Data to it. Data is moved to the writer.
+  void Post(const std::string &Path, std::vector<char> &Data, bool Append) {
+    {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      if (!Append && !Jobs.empty() && !Jobs.back().Append && Jobs.back().Path == Path) {
+        Jobs.back().Data.swap(Data); // newer snapshot of the same file
+      }
+      else {
+        Jobs.push_back(Job());
+        Jobs.back().Path = Path;
+        Jobs.back().Data.swap(Data);
+        Jobs.back().Append = Append;
+      }
+    }
+    Cond.notify_all();
+  }
+
+  // Wait until the jobs posted are written
+  void Flush(void) {
+    std::unique_lock<std::mutex> Lock(Mutex);
+    Cond.wait(Lock, [this]{ return Jobs.empty() && !Busy; });
+  }
+
+  int GetNumWritten(void) { std::lock_guard<std::mutex> Lock(Mutex); return NumWritten; }
+  int GetNumFailed(void) { std::lock_guard<std::mutex> Lock(Mutex); return NumFailed; }
+
+private:
+
+  struct Job {
+    std::string Path;
+    std::vector<char> Data;
+    bool Append;
+  };
+
+  std::deque<Job> Jobs;
+  bool Busy;
+  bool Done;
+  int NumWritten;
+  int NumFailed;
+  std::mutex Mutex;
+  std::condition_variable Cond;
+  std::thread Thread;
+
+  void Run(void) {
+    std::unique_lock<std::mutex> Lock(Mutex);
+    while (true) {
+      Cond.wait(Lock, [this]{ return !Jobs.empty() || Done; });
+      if (Jobs.empty()) {
+        break;
+      }
+      Job J;
+      std::swap(J, Jobs.front());
+      Jobs.pop_front();
+      Busy = true;
+      Lock.unlock();
+      bool Ok = Write(J);
+      Lock.lock();
+      Busy = false;
+      Ok ? NumWritten++ : NumFailed++;
+      Cond.notify_all();
+    }
+  }
+
+  static bool Write(const Job &J) {
+    std::string Tmp = J.Append ? J.Path : J.Path + ".tmp";
+    FILE *fp = fopen(Tmp.c_str(), J.Append ? "ab" : "wb");
+    if (fp == NULL) {
+      return false;
+    }
+    bool Ok = fwrite(J.Data.data(), 1, J.Data.size(), fp) == J.Data.size() &&
+      fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    Ok = fclose(fp) == 0 && Ok;
+    return Ok && (J.Append || rename(Tmp.c_str(), J.Path.c_str()) == 0);
+  }
+
+};
+
+
+class PCGCheckpoint {
+
+public:
+
+  PCGCheckpoint(const char *FileName_ = NULL, double Interval_ = 600.0, bool Write_ = true)
+    : Writer(NULL), Interval(Interval_), Key(0), Last(Clock::now()),
+      Lambda(0.0), NormRHS(0.0) {
+    if (FileName_ == NULL) {
+      return;
+    }
+    FileName = FileName_;
+    ScanLog(Write_);
+    if (Write_) {
+      Writer = new CheckpointWriter();
+    }
+  }
+
+  ~PCGCheckpoint() { delete Writer; }
+
+  // Set the key of the next solve
+  void SetKey(long Key_) { Key = Key_; Last = Clock::now(); }
+
+  // Called by PCG::Solve before the first iteration; lambda and NormB
+  // are saved with the checkpoints of the solve. Res has room for MaxIt
+  // residuals; Iter is at most MaxIt on return.
+  bool Restore(long n, double lambda, double NormB, int MaxIt, int &Iter,
+               DVector &x, DVector &r, DVector &p, double &rz, double *Res) {
+    Lambda = lambda;
+    NormRHS = NormB;
+    if (FileName.empty()) {
+      return false;
+    }
+    FILE *fp = fopen(FileName.c_str(), "rb");
+    if (fp == NULL) {
+      return false;
+    }
+    char Magic[8];
+    long Head[2];
+    int It[2];
+    double Vals[3];
+    bool Ok = fread(Magic, 1, 8, fp) == 8 && memcmp(Magic, "PCGCKPT1", 8) == 0 &&
+      fread(Head, sizeof(long), 2, fp) == 2 && fread(It, sizeof(int), 2, fp) == 2 &&
+      fread(Vals, sizeof(double), 3, fp) == 3 &&
+      Head[0] == Key && Head[1] == n && It[0] > 0 && Vals[0] == lambda &&
+      fabs(Vals[1] - NormB) <= 1e-10*NormB;
+    if (Ok) {
+      x.Init(n);
+      r.Init(n);
+      p.Init(n);
+      std::vector<double> ResAll(It[0]);
+      Ok = fread(x.GetPointer(), sizeof(double), n, fp) == (size_t)n &&
+        fread(r.GetPointer(), sizeof(double), n, fp) == (size_t)n &&
+        fread(p.GetPointer(), sizeof(double), n, fp) == (size_t)n &&
+        fread(&ResAll[0], sizeof(double), It[0], fp) == (size_t)It[0];
+      Iter = It[0] < MaxIt ? It[0] : MaxIt;
+      memcpy(Res, &ResAll[0], Iter*sizeof(double));
+      rz = Vals[2];
+    }
+    fclose(fp);
+    return Ok;
+  }
+
+  // Called by PCG::Solve after each iteration
+  void operator()(int Iter, const DVector &x, const DVector &r, const DVector &p,
+                  double rz, const double *Res) {
+    if (Writer == NULL ||
+        std::chrono::duration<double>(Clock::now() - Last).count() < Interval) {
+      return;
+    }
+    long n = x.GetN();
+    long Head[2] = { Key, n };
+    int It[2] = { Iter, 0 };
+    double Vals[3] = { Lambda, NormRHS, rz };
+    std::vector<char> Buf;
+    Buf.reserve(8 + sizeof(Head) + sizeof(It) + sizeof(Vals) + (3*n + Iter)*sizeof(double));
+    Append(Buf, "PCGCKPT1", 8);
+    Append(Buf, Head, sizeof(Head));
+    Append(Buf, It, sizeof(It));
+    Append(Buf, Vals, sizeof(Vals));
+    Append(Buf, x.GetPointer(), n*sizeof(double));
+    Append(Buf, r.GetPointer(), n*sizeof(double));
+    Append(Buf, p.GetPointer(), n*sizeof(double));
+    Append(Buf, Res, Iter*sizeof(double));
+    Writer->Post(FileName, Buf, false);
+    Last = Clock::now();
+  }
+
+  //-------------------- Solution log --------------------
+
+  // Get the solution of key Key_, lambda and length n from the log
+  bool GetSolution(long Key_, double lambda, long n, DVector &x) const {
+    std::map<long, long>::const_iterator it = LogIndex.find(Key_);
+    if (it == LogIndex.end()) {
+      return false;
+    }
+    FILE *fp = fopen((FileName + ".sol").c_str(), "rb");
+    if (fp == NULL) {
+      return false;
+    }
+    char Magic[8];
+    long Head[2];
+    double LogLambda;
+    bool Ok = fseek(fp, it->second, SEEK_SET) == 0 &&
+      fread(Magic, 1, 8, fp) == 8 && fread(Head, sizeof(long), 2, fp) == 2 &&
+      fread(&LogLambda, sizeof(double), 1, fp) == 1 && LogLambda == lambda && Head[1] == n;
+    if (Ok) {
+      x.Init(n);
+      Ok = fread(x.GetPointer(), sizeof(double), n, fp) == (size_t)n;
+    }
+    fclose(fp);
+    return Ok;
+  }
+
+  // Append the solution of key Key_ and lambda to the log
+  void AddSolution(long Key_, double lambda, const DVector &x) {
+    if (Writer == NULL) {
+      return;
+    }
+    long Head[2] = { Key_, x.GetN() };
+    std::vector<char> Buf;
+    Append(Buf, "PCGSOL01", 8);
+    Append(Buf, Head, sizeof(Head));
+    Append(Buf, &lambda, sizeof(double));
+    Append(Buf, x.GetPointer(), x.GetN()*sizeof(double));
+    Writer->Post(FileName + ".sol", Buf, true);
+  }
+
+  //-------------------- Utilities --------------------
+
+  // Wait until the checkpoints and the solutions posted are written
+  void Flush(void) {
+    if (Writer) {
+      Writer->Flush();
+    }
+  }
+
+  int GetNumWritten(void) { return Writer ? Writer->GetNumWritten() : 0; }
+  int GetNumFailed(void) { return Writer ? Writer->GetNumFailed() : 0; }
+
+  // Get the number of solutions in the log when it was opened
+  long GetNumLogged(void) const { return LogIndex.size(); }
+
+private:
+
+  typedef std::chrono::steady_clock Clock;
+
+  CheckpointWriter *Writer;
+  std::string FileName;
+  double Interval;
+  long Key;
+  Clock::time_point Last;
+  double Lambda;                 // problem of the current solve
+  double NormRHS;
+  std::map<long, long> LogIndex; // offset of the record of each key
+
+  PCGCheckpoint(const PCGCheckpoint &);
+  PCGCheckpoint& operator= (const PCGCheckpoint &);
+
+  static void Append(std::vector<char> &Buf, const void *Data, size_t Bytes) {
+    size_t Off = Buf.size();
+    Buf.resize(Off + Bytes);
+    if (Bytes > 0) {
+      memcpy(&Buf[Off], Data, Bytes);
+    }
+  }
+
+  // Index the complete records of the solution log, and cut an
+  // incomplete last one if Cut
+  void ScanLog(bool Cut) {
+    std::string Log = FileName + ".sol";
+    FILE *fp = fopen(Log.c_str(), "rb");
+    if (fp == NULL) {
+      return;
+    }
+    fseek(fp, 0, SEEK_END);
+    long Size = ftell(fp), Off = 0;
+    fseek(fp, 0, SEEK_SET);
+    char Magic[8];
+    long Head[2];
+    while (fread(Magic, 1, 8, fp) == 8 && memcmp(Magic, "PCGSOL01", 8) == 0 &&
+           fread(Head, sizeof(long), 2, fp) == 2 && Head[1] >= 0) {
+      long End = Off + 8 + (long)sizeof(Head) + (long)sizeof(double)*(1 + Head[1]);
+      if (End > Size) {
+        break;
+      }
+      LogIndex[Head[0]] = Off;
+      Off = End;
+      fseek(fp, Off, SEEK_SET);
+    }
+    fclose(fp);
+    if (Cut && Off < Size && truncate(Log.c_str(), Off) != 0) {
+      printf("PCGCheckpoint. Error: Cannot cut the incomplete record of %s.\n", Log.c_str());
+    }
+  }
+
+};
+
+#endif
@@ -0,0 +1,188 @@
+// Generalized cross-validation (GCV) of ridge regression
+//
+//   w(lambda) = (Z'Z + lambda*I)^{-1} Z'y,   H(lambda) = Z (Z'Z + lambda*I)^{-1} Z'
+//
+//   GCV(lambda) = n |y - Z*w(lambda)|^2 / (n - trace(H(lambda)))^2
+//
+// for a whole list of lambda's, without solving the system for any of
+// them. Both terms are quadratic forms v'f(G)v of a Gram matrix G:
+// b'psi(Z'Z)b for the residual (b = Z'y, see GCVResidual) and v'g(G)v
+// for the trace (v = random +-1 probes, Hutchinson estimator
+// trace(H) = E[v'g(G)v], see GCVTrace). Each form is approximated by
+// the Gauss quadrature of k steps of the Lanczos process on G started
+// at v (Golub and Meurant):
+//
+//   v'f(G)v ~ sum_i Weights[i] f(Nodes[i])
+//
+// where Nodes are the eigenvalues of the k x k tridiagonal matrix T of
+// the Lanczos process and Weights are |v|^2 times the squared first
+// components of its eigenvectors. The nodes and weights do not depend
+// on lambda: each run costs k products with Z and with Z', after which
+// GCV is evaluated for any number of lambda's in O(k) each.
+//
+// The Gauss quadrature is poor for a v with a large component in the
+// null space of G and a lambda below the smallest Ritz value. Hence
+// the residual is computed on G = Z'Z from b = Z'y, which has no null
+// component, and the trace probes should be drawn on the smaller side
+// of Z and be zero on its empty rows or columns.
+//
+// MatrixA must have the method
+//   void MatVec(const DVector &b, DVector &y, MatrixMode ModeA) const;
+// for ModeA = NORMAL and TRANSPOSE (e.g., SPointArray,
+// PackedBinMatrix). The Lanczos vectors are fully reorthogonalized.
+
+#ifndef _GCV_
+#define _GCV_
+
+#include <vector>
+#include <cmath>
+#include <string.h>
+#include "../Matrices/DVector.hpp"
+
+// Eigenvalues (in Nodes) and first components of the eigenvectors (in
+// First) of the symmetric n x n matrix T (row major, destroyed), by
+// cyclic Jacobi rotations
+inline void GCVSymEig(std::vector<double> &T, int n, std::vector<double> &Nodes,
+                      std::vector<double> &First) {
+  std::vector<double> Q((long)n*n, 0.0);
+  for (int i = 0; i < n; i++) {
+    Q[(long)i*n+i] = 1.0;
+  }
+  for (int sweep = 0; sweep < 100; sweep++) {
+    double Off = 0.0, Diag = 0.0;
+    for (int i = 0; i < n; i++) {
+      Diag += T[(long)i*n+i]*T[(long)i*n+i];
+      for (int j = i+1; j < n; j++) {
+        Off += T[(long)i*n+j]*T[(long)i*n+j];
+      }
+    }
+    if (Off <= 1e-30*Diag) {
+      break;
+    }
+    for (int p = 0; p < n; p++) {
+      for (int q = p+1; q < n; q++) {
+        double apq = T[(long)p*n+q];
+        if (apq == 0.0) {
+          continue;
+        }
+        double theta = (T[(long)q*n+q] - T[(long)p*n+p])/(2.0*apq);
+        double t = (theta >= 0 ? 1.0 : -1.0)/(fabs(theta) + sqrt(theta*theta + 1.0));
+        double c = 1.0/sqrt(t*t + 1.0), s = t*c;
+        for (int k = 0; k < n; k++) { // columns p, q
+          double akp = T[(long)k*n+p], akq = T[(long)k*n+q];
+          T[(long)k*n+p] = c*akp - s*akq;
+          T[(long)k*n+q] = s*akp + c*akq;
+        }
+        for (int k = 0; k < n; k++) { // rows p, q
+          double apk = T[(long)p*n+k], aqk = T[(long)q*n+k];
+          T[(long)p*n+k] = c*apk - s*aqk;
+          T[(long)q*n+k] = s*apk + c*aqk;
+        }
+        for (int k = 0; k < n; k++) { // eigenvectors: columns of Q
+          double qkp = Q[(long)k*n+p], qkq = Q[(long)k*n+q];
+          Q[(long)k*n+p] = c*qkp - s*qkq;
+          Q[(long)k*n+q] = s*qkp + c*qkq;
+        }
+      }
+    }
+  }
+  Nodes.resize(n);
+  First.resize(n);
+  for (int i = 0; i < n; i++) {
+    Nodes[i] = T[(long)i*n+i];
+    First[i] = Q[i];
+  }
+}
+
+
+// Gauss quadrature nodes and weights of v'f(G)v from k steps of the
+// Lanczos process on the Gram matrix G = Z'Z (ModeA = NORMAL, v of
+// length M) or G = ZZ' (ModeA = TRANSPOSE, v of length N), started at
+// v. Fewer than k nodes are returned if the process breaks down.
+template<class MatrixA>
+void GCVQuadrature(const MatrixA &Z, const DVector &v, int k, MatrixMode ModeA,
+                   std::vector<double> &Nodes, std::vector<double> &Weights) {
+  Nodes.clear();
+  Weights.clear();
+  long n = v.GetN();
+  double NormV = v.Norm2();
+  if (NormV == 0.0 || k <= 0) {
+    return;
+  }
+  MatrixMode ModeB = ModeA == NORMAL ? TRANSPOSE : NORMAL;
+
+  std::vector< std::vector<double> > Q; // Lanczos vectors
+  std::vector<double> alpha, beta;      // T(i,i) and T(i,i+1)
+  DVector q(n), Zq, Gq;
+  memcpy(q.GetPointer(), v.GetPointer(), n*sizeof(double));
+  q.Multiply(1.0/NormV);
+  for (int i = 0; i < k; i++) {
+    Q.push_back(std::vector<double>(q.GetPointer(), q.GetPointer()+n));
+    Z.MatVec(q, Zq, ModeA);
+    Z.MatVec(Zq, Gq, ModeB);
+    double *pg = Gq.GetPointer();
+    alpha.push_back(q.InProd(Gq));
+    // orthogonalize against all the Lanczos vectors, twice
+    for (int pass = 0; pass < 2; pass++) {
+      for (size_t j = 0; j < Q.size(); j++) {
+        const double *qj = &Q[j][0];
+        double d = 0.0;
+        for (long t = 0; t < n; t++) {
+          d += qj[t]*pg[t];
+        }
+        for (long t = 0; t < n; t++) {
+          pg[t] -= d*qj[t];
+        }
+      }
+    }
+    double b = Gq.Norm2();
+    if (i+1 == k || b <= 1e-12*fabs(alpha[0])) {
+      break;
+    }
+    beta.push_back(b);
+    Gq.Multiply(1.0/b);
+    q = Gq;
+  }
+
+  int m = alpha.size();
+  std::vector<double> T((long)m*m, 0.0), First;
+  for (int i = 0; i < m; i++) {
+    T[(long)i*m+i] = alpha[i];
+    if (i+1 < m) {
+      T[(long)i*m+i+1] = T[(long)(i+1)*m+i] = beta[i];
+    }
+  }
+  GCVSymEig(T, m, Nodes, First);
+  Weights.resize(m);
+  for (int i = 0; i < m; i++) {
+    Weights[i] = NormV*NormV*First[i]*First[i];
+  }
+}
+
+
+// Estimate of |y - Z*w(lambda)|^2 = |y|^2 - b'psi(Z'Z)b, with b = Z'y
+// and psi(t) = (t + 2*lambda)/(t + lambda)^2, from the quadrature of b
+// on Z'Z
+inline double GCVResidual(double NormY2, const std::vector<double> &Nodes,
+                          const std::vector<double> &Weights, double lambda) {
+  double s = 0.0;
+  for (size_t i = 0; i < Nodes.size(); i++) {
+    s += Weights[i]*(Nodes[i] + 2.0*lambda)/((Nodes[i] + lambda)*(Nodes[i] + lambda));
+  }
+  return NormY2 - s;
+}
+
+
+// Estimate of v'g(G)v, g(t) = t/(t + lambda), from the quadrature of v
+// on G = Z'Z or ZZ': the contribution of v to trace(H(lambda)), since
+// trace(H) = trace(g(Z'Z)) = trace(g(ZZ'))
+inline double GCVTrace(const std::vector<double> &Nodes,
+                       const std::vector<double> &Weights, double lambda) {
+  double s = 0.0;
+  for (size_t i = 0; i < Nodes.size(); i++) {
+    s += Weights[i]*Nodes[i]/(Nodes[i] + lambda);
+  }
+  return s;
+}
+
+#endif
@@ -10,6 +10,7 @@
 #define _PCG_
 
 #include "../Matrices/DVector.hpp"
+#include "../Misc/MemTrack.hpp"
 
 class PCG {
 
@@ -39,6 +40,29 @@ public:
              double lambda // Enable sparse matrix with regulaizer A = C'C + lambda*I
              );
 
+  // Same as above, with a monitor that is called after each iteration
+  // with the number of iterations and the current iterate:
+  //   bool operator()(int Iter, const DVector &x);
+  // The iterations stop when it returns true (e.g., see
+  // ValidationStop.hpp).
+  template<class MatrixA, class MatrixM, class Monitor>
+  void Solve(MatrixA &A, DVector &b, DVector &x0, MatrixM &M,
+             int MaxIt, double RTol, bool ATA, double lambda,
+             Monitor &Stop);
+
+  // Same as above, with checkpoints of the state (x, r, p, rz and the
+  // residuals) after each iteration, from which the solve is resumed
+  // instead of started from x0 (see Checkpoint.hpp):
+  //   bool Restore(long n, double lambda, double NormB, int MaxIt,
+  //                int &Iter, DVector &x, DVector &r, DVector &p,
+  //                double &rz, double *Res);
+  //   void operator()(int Iter, const DVector &x, const DVector &r,
+  //                   const DVector &p, double rz, const double *Res);
+  template<class MatrixA, class MatrixM, class Monitor, class Checkpoint>
+  void Solve(MatrixA &A, DVector &b, DVector &x0, MatrixM &M,
+             int MaxIt, double RTol, bool ATA, double lambda,
+             Monitor &Stop, Checkpoint &Ckpt);
+
   // Get the norm of the right hand side b.
   double GetNormRHS(void) const;
 
@@ -54,6 +78,21 @@ protected:
 
 private:
 
+  // Monitor of the plain Solve: never stops
+  struct NoMonitor {
+    bool operator()(int Iter, const DVector &x) { return false; }
+  };
+
+  // Checkpoint of the Solve without one: never resumes nor saves
+  struct NoCheckpoint {
+    bool Restore(long n, double lambda, double NormB, int MaxIt, int &Iter,
+                 DVector &x, DVector &r, DVector &p, double &rz, double *Res) {
+      return false;
+    }
+    void operator()(int Iter, const DVector &x, const DVector &r,
+                    const DVector &p, double rz, const double *Res) {}
+  };
+
   double NormB;
   DVector x;
   int mIter;
@@ -14,47 +14,80 @@ Solve(MatrixA &A,  // Martix A
       bool ATA,     // Enable different matrix type such as A = C'C
       double lambda // Enable sparse matrix with regulaizer A = C'C + lambda*I
       ) {
+  NoMonitor Stop;
+  Solve(A, b, x0, M, MaxIt, RTol, ATA, lambda, Stop);
+}
+
+
+//--------------------------------------------------------------------------
+template<class MatrixA, class MatrixM, class Monitor>
+void PCG::
+Solve(MatrixA &A, DVector &b, DVector &x0, MatrixM &M,
+      int MaxIt, double RTol, bool ATA, double lambda,
+      Monitor &Stop) {
+  NoCheckpoint Ckpt;
+  Solve(A, b, x0, M, MaxIt, RTol, ATA, lambda, Stop, Ckpt);
+}
+
+
+//--------------------------------------------------------------------------
+template<class MatrixA, class MatrixM, class Monitor, class Checkpoint>
+void PCG::
+Solve(MatrixA &A, DVector &b, DVector &x0, MatrixM &M,
+      int MaxIt, double RTol, bool ATA, double lambda,
+      Monitor &Stop, Checkpoint &Ckpt) {
+
+  MemTagScope MemScope(MEM_SOLVER);
 
   NormB = b.Norm2();
   double Tol = RTol * NormB;
   Delete_1D_Array<double>(&mRes);
   New_1D_Array<double, int>(&mRes, MaxIt);
 
-  mIter = 0;
-
-  // r = b - Ax
-  x = x0;
-  DVector Ax;
-  if (ATA){
-    DVector Ax_temp;
-    A.MatVec(x,Ax_temp,NORMAL);
-    A.MatVec(Ax_temp,Ax,TRANSPOSE);
-    x.Multiply(lambda,Ax_temp);
-    Ax.Add(Ax_temp);
-  }
-  else{
-    A.MatVec(x, Ax, NORMAL);
-  }
-  DVector r;
-  b.Subtract(Ax, r);
-  mRes[mIter++] = r.Norm2();
+  DVector r, z, p;
+  double rz;
 
-  if (mRes[0] < Tol) {
-    return;
+  // Resume from the state after iteration mIter-1
+  if (Ckpt.Restore(b.GetN(), lambda, NormB, MaxIt, mIter, x, r, p, rz, mRes)) {
+    if (mRes[mIter-1] < Tol) {
+      return;
+    }
   }
+  else {
+    mIter = 0;
 
-  // z = M(r)
-  DVector z;
-  if (ATA)
-    z = r;
-  else
-    M.MatVec(r, z, NORMAL);
+    // r = b - Ax
+    x = x0;
+    DVector Ax;
+    if (ATA){
+      DVector Ax_temp;
+      A.MatVec(x,Ax_temp,NORMAL);
+      A.MatVec(Ax_temp,Ax,TRANSPOSE);
+      x.Multiply(lambda,Ax_temp);
+      Ax.Add(Ax_temp);
+    }
+    else{
+      A.MatVec(x, Ax, NORMAL);
+    }
+    b.Subtract(Ax, r);
+    mRes[mIter++] = r.Norm2();
 
-  // p = z
-  DVector p = z;
+    if (mRes[0] < Tol) {
+      return;
+    }
 
-  // rz = r'*z
-  double rz = r.InProd(z);
+    // z = M(r)
+    if (ATA)
+      z = r;
+    else
+      M.MatVec(r, z, NORMAL);
+
+    // p = z
+    p = z;
+
+    // rz = r'*z
+    rz = r.InProd(z);
+  }
 
   while (mIter < MaxIt) {
 
@@ -89,6 +122,10 @@ Solve(MatrixA &A,  // Martix A
       mIter++;
       break;
     }
+    if (Stop(mIter, x)) {
+      mIter++;
+      break;
+    }
 
     // z = M(r)
     if (ATA)
@@ -111,6 +148,8 @@ Solve(MatrixA &A,  // Martix A
 
     mIter++;
 
+    Ckpt(mIter, x, r, p, rz, mRes);
+
   }
 
 }
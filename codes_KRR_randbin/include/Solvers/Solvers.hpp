@@ -4,5 +4,8 @@
 #define _SOLVERS_
 
 #include "PCG.hpp"
+#include "ValidationStop.hpp"
+#include "GCV.hpp"
+#include "Checkpoint.hpp"
 
 #endif
@@ -0,0 +1,100 @@
+// The ValidationStop class is a monitor for PCG::Solve that implements
+// early stopping on held-out rows. Every Every iterations, the current
+// iterate x is scored by the mean squared error of the predictions
+// Zv*x against the held-out targets yv:
+//
+//   err = |Zv*x - yv|^2 / n_v
+//
+// and the solve stops when err has not decreased for Patience
+// consecutive checks. The iterate of the smallest error is kept and
+// returned by GetSolution. A check costs one MatVec with Zv, i.e., a
+// fraction n_v/(2n) of a PCG iteration with ATA.
+//
+// MatrixV must have the method
+//   void MatVec(const DVector &b, DVector &y, MatrixMode ModeA) const;
+// for ModeA = NORMAL (e.g., SPointArray, PackedBinMatrix). With Every
+// = 0, the monitor never checks nor stops. The class does not own Zv
+// and yv.
+
+#ifndef _VALIDATION_STOP_
+#define _VALIDATION_STOP_
+
+#include "../Matrices/DVector.hpp"
+
+template<class MatrixV>
+class ValidationStop {
+
+public:
+
+  ValidationStop(const MatrixV &Zv_, const DVector &yv_, int Every_, int Patience_)
+    : Zv(&Zv_), yv(&yv_), Every(Every_), Patience(Patience_) { Reset(); }
+
+  // Forget the checks of the previous solve, e.g., before the solve of
+  // another right-hand side with targets yv_
+  void Reset(void) {
+    BestErr = -1.0;
+    BestIter = 0;
+    NumChecks = 0;
+    NumWorse = 0;
+  }
+  void Reset(const DVector &yv_) { yv = &yv_; Reset(); }
+
+  // Called by PCG::Solve after iteration Iter
+  bool operator()(int Iter, const DVector &x) {
+    if (Every <= 0 || Iter % Every != 0) {
+      return false;
+    }
+    return Check(Iter, x);
+  }
+
+  // Score x (the iterate of iteration Iter) now; returns true if the
+  // error has not decreased for Patience checks
+  bool Check(int Iter, const DVector &x) {
+    DVector pred;
+    Zv->MatVec(x, pred, NORMAL);
+    pred.Subtract(*yv);
+    double Norm = pred.Norm2();
+    double Err = yv->GetN() > 0 ? Norm*Norm/yv->GetN() : 0.0;
+    NumChecks++;
+    if (BestErr < 0.0 || Err < BestErr) {
+      BestErr = Err;
+      BestIter = Iter;
+      Best = x;
+      NumWorse = 0;
+    }
+    else {
+      NumWorse++;
+    }
+    return NumWorse >= Patience;
+  }
+
+  //-------------------- Utilities --------------------
+
+  // Get the iterate of the smallest error; Sol is unchanged if no
+  // check was done
+  void GetSolution(DVector &Sol) const {
+    if (NumChecks > 0) {
+      Sol = Best;
+    }
+  }
+
+  double GetBestError(void) const { return BestErr; }
+  int GetBestIter(void) const { return BestIter; }
+  int GetNumChecks(void) const { return NumChecks; }
+
+private:
+
+  const MatrixV *Zv;
+  const DVector *yv;
+  int Every;
+  int Patience;
+
+  double BestErr;
+  int BestIter;
+  int NumChecks;
+  int NumWorse;
+  DVector Best;
+
+};
+
+#endif
@@ -15,6 +15,14 @@
 #include <set>
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <type_traits>
+#include "Misc/MemTrack.hpp"
+#ifdef USE_MPI
+#include <mpi.h>
+#include "Misc/ParRandom.hpp"
+#endif
 
 using namespace std;
 
@@ -104,10 +112,32 @@ vector<int>* compute_bin_num( vector<pair<int,double> >* ins, double* delta, dou
 	return code;
 }
 
-void random_binning_feature(int d, int D, vector< vector< pair<int,double> > >& ins_old, vector< vector< pair<int,double> > >& ins_new, double gamma ){
+//Statistics that random_binning_feature can accumulate while it bins
+//the rows, so that no further pass over the features is needed: for
+//the first n rows of ins_old (the train rows), with labels Y (n*m,
+//column major, e.g., a DMatrix), the number of rows in each bin and
+//Z'Y, where Z is the matrix of the binning features. The bin of
+//feature index k (1-based) is at count[k-1] and ZtY[c*nbins+k-1] for
+//label column c; the bins of grid j are grid_offset[j]+1, ...,
+//grid_offset[j+1].
+struct BinningStats{
+	//input
+	long n;
+	int m;
+	const double* Y;
+	//output
+	long nbins;
+	vector<long> count;
+	vector<double> ZtY;
+	vector<int> grid_offset;
+};
+
+//draw the D grids: widths delta[i] ~ Gamma(2, 1/gamma) and offsets
+//u[i] ~ U(0, delta[i]), from the state of rand()
+void random_binning_grids(int d, int D, double gamma, double**& delta, double**& u){
 
-	double** delta = new double*[D];
-	double** u = new double*[D];
+	delta = new double*[D];
+	u = new double*[D];
 
 	Gamma gamma_dist(gamma);
 
@@ -121,26 +151,248 @@ void random_binning_feature(int d, int D, vector< vector< pair<int,double> > >&
 			u[i][j] = ((double)rand()/RAND_MAX)*delta[i][j];
 		}
 	}
+}
+
+//Assemble ins_new from the local bin indices features[j][i] (1-based)
+//of the rows in each grid j, which has nbins_grid[j] bins: the
+//indices of grid j are shifted by the number of bins of the grids
+//before j and the values scaled by 1/sqrt(D). With stats, the per
+//grid counts and label sums (m per bin) are scattered likewise.
+void binning_assemble(int D, vector< vector<pair<int,double> > >& features, const vector<int>& nbins_grid, vector< vector<long> >& grid_count, vector< vector<double> >& grid_sum, vector< vector< pair<int,double> > >& ins_new, BinningStats* stats){
+
+	int N = ins_new.size();
+	vector<int> offset(D+1, 0);
+	for(int j=0;j<D;j++)
+		offset[j+1] = offset[j] + nbins_grid[j];
+	double scale = sqrt(1.0/D);
+
+	//scatter the statistics of grid j to the bins offset[j]+1,...
+	if( stats ){
+		int m = stats->m;
+		long nbins = offset[D];
+		stats->nbins = nbins;
+		stats->count.assign(nbins, 0);
+		stats->ZtY.assign(nbins*m, 0.0);
+		stats->grid_offset = offset;
+#pragma omp parallel for schedule(dynamic)
+		for(int j=0;j<D;j++){
+			for(long b=0;b<grid_count[j].size();b++){
+				long k = offset[j] + b;
+				stats->count[k] = grid_count[j][b];
+				for(int c=0;c<m;c++)
+					stats->ZtY[c*nbins+k] = scale * grid_sum[j][b*m+c];
+			}
+		}
+	}
+
+	//convert to data_new, shifting the indices of grid j by offset[j]
+#pragma omp parallel for schedule(static)
+	for(int i=0;i<N;i++){
+		vector<pair<int,double> >* ins = &(ins_new[i]);
+		ins->resize(D);
+		for(int j=0;j<D;j++){
+			pair<int,double>* fea = &(features[j][i]);
+			(*ins)[j] = make_pair(fea->first + offset[j], scale*fea->second);
+		}
+	}
+}
+
+//Packed bin keys for low-dimensional data. Over the range of the data,
+//the code of dimension t in a grid lies in [lo[t], lo[t]+2^bits[t]), so
+//the d codes of a row fit in one or two 64-bit words (no field crosses
+//a word). The words are the key of a hash dictionary, which replaces
+//the heap vector<int> compared by VectComp and the allocation per row.
+//The bins are numbered in the order of their first rows, as with
+//CodeIndexMap, so the features are the same. Dimensions up to
+//RANDBIN_PACKED_MAX_DIM get a specialized binning loop with a
+//compile-time bound.
+#ifndef RANDBIN_PACKED_MAX_DIM
+#define RANDBIN_PACKED_MAX_DIM 16
+#endif
+
+struct PackedKey2{
+	unsigned long long w[2];
+	bool operator==(const PackedKey2& b) const { return w[0] == b.w[0] && w[1] == b.w[1]; }
+};
+
+struct PackedKeyHash{
+	static unsigned long long mix(unsigned long long z){
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+	size_t operator()(unsigned long long k) const { return mix(k); }
+	size_t operator()(const PackedKey2& k) const { return mix(k.w[0] ^ mix(k.w[1] + 0x9E3779B97F4A7C15ULL)); }
+};
+
+//layout of the packed key of one grid: field t starts at bit pos[t];
+//words = 0 if the codes need more than 128 bits
+struct PackedLayout{
+	int words;
+	vector<long long> lo;
+	vector<int> pos;
+};
+
+//range [xmin[t], xmax[t]] of dimension t over the rows, including the
+//implicit zeros
+void binning_data_range(int d, vector< vector< pair<int,double> > >& ins_old, vector<double>& xmin, vector<double>& xmax){
+
+	xmin.assign(d, 0.0);
+	xmax.assign(d, 0.0);
+	for(long i=0;i<ins_old.size();i++){
+		for(vector<pair<int,double> >::iterator it=ins_old[i].begin(); it!=ins_old[i].end(); it++){
+			if( it->first >= d )
+				continue;
+			xmin[it->first] = min(xmin[it->first], it->second);
+			xmax[it->first] = max(xmax[it->first], it->second);
+		}
+	}
+}
+
+PackedLayout packed_layout(int d, const vector<double>& xmin, const vector<double>& xmax, const double* delta, const double* u){
+
+	PackedLayout lay;
+	lay.lo.resize(d);
+	lay.pos.resize(d);
+	int pos = 0;
+	for(int t=0;t<d;t++){
+		//same expression as compute_bin_num, which is monotone in x
+		double lo = floor((xmin[t]-u[t])/delta[t]);
+		double hi = floor((xmax[t]-u[t])/delta[t]);
+		int bits = 0;
+		while( bits < 63 && hi - lo >= (double)(1ULL << bits) )
+			bits++;
+		if( (pos & 63) + bits > 64 )
+			pos = (pos | 63) + 1;
+		lay.lo[t] = (long long)lo;
+		lay.pos[t] = pos;
+		pos += bits;
+	}
+	lay.words = pos <= 64 ? 1 : pos <= 128 ? 2 : 0;
+	return lay;
+}
+
+template<int DIM, int W>
+inline void packed_bin_key(const vector<pair<int,double> >& ins, int d, const double* delta, const double* u, const PackedLayout& lay, unsigned long long* w){
+
+	const int n = DIM > 0 ? DIM : d;
+	const long long* lo = &(lay.lo[0]);
+	const int* pos = &(lay.pos[0]);
+	w[0] = 0;
+	if( W == 2 )
+		w[1] = 0;
+	vector<pair<int,double> >::const_iterator it = ins.begin();
+	for(int t=0;t<n;t++){
+		double x = 0.0;
+		if( it != ins.end() && it->first == t ){
+			x = it->second;
+			it++;
+		}
+		unsigned long long c = (unsigned long long)( (long long)floor((x-u[t])/delta[t]) - lo[t] );
+		w[W == 2 ? (pos[t] >> 6) : 0] |= c << (pos[t] & 63);
+	}
+}
+
+//bin the rows in one grid with packed keys of W words, as the loop of
+//random_binning_feature; returns the number of bins
+template<int DIM, int W>
+int bin_grid_packed(int d, vector< vector< pair<int,double> > >& ins_old, const double* delta, const double* u, const PackedLayout& lay, vector<pair<int,double> >& fea, BinningStats* stats, long n_lab, vector<long>* count, vector<double>* sum){
+
+	typedef typename conditional<W == 1, unsigned long long, PackedKey2>::type Key;
+	unordered_map<Key, int, PackedKeyHash> code_ind_map;
+	int m = stats ? stats->m : 0;
+	int N = ins_old.size();
+	Key key;
+	for(int i=0;i<N;i++){
+		if( ins_old[i].size() == 0 )
+			continue;
+
+		packed_bin_key<DIM, W>(ins_old[i], d, delta, u, lay, (unsigned long long*)&key);
+		pair<typename unordered_map<Key, int, PackedKeyHash>::iterator, bool> ins = code_ind_map.insert(make_pair(key, (int)code_ind_map.size()));
+		int ind = ins.first->second;
+		if( stats ){
+			if( ins.second ){
+				count->push_back(0);
+				sum->resize(sum->size()+m, 0.0);
+			}
+			if( i < n_lab ){
+				(*count)[ind]++;
+				for(int c=0;c<m;c++)
+					(*sum)[(long)ind*m+c] += stats->Y[c*stats->n+i];
+			}
+		}
+		fea[i] = make_pair(ind + 1, 1.0);
+	}
+	return code_ind_map.size();
+}
+
+//dispatch to the binning loop specialized for d = DIM, ..., 1, or to the
+//generic one
+template<int DIM, int W>
+struct PackedDispatch{
+	static int run(int d, vector< vector< pair<int,double> > >& ins_old, const double* delta, const double* u, const PackedLayout& lay, vector<pair<int,double> >& fea, BinningStats* stats, long n_lab, vector<long>* count, vector<double>* sum){
+		if( d == DIM )
+			return bin_grid_packed<DIM, W>(d, ins_old, delta, u, lay, fea, stats, n_lab, count, sum);
+		return PackedDispatch<DIM-1, W>::run(d, ins_old, delta, u, lay, fea, stats, n_lab, count, sum);
+	}
+};
+
+template<int W>
+struct PackedDispatch<0, W>{
+	static int run(int d, vector< vector< pair<int,double> > >& ins_old, const double* delta, const double* u, const PackedLayout& lay, vector<pair<int,double> >& fea, BinningStats* stats, long n_lab, vector<long>* count, vector<double>* sum){
+		return bin_grid_packed<0, W>(d, ins_old, delta, u, lay, fea, stats, n_lab, count, sum);
+	}
+};
+
+void random_binning_feature(int d, int D, vector< vector< pair<int,double> > >& ins_old, vector< vector< pair<int,double> > >& ins_new, double gamma, BinningStats* stats = NULL ){
+
+	MemTagScope mem_scope(MEM_BINNING);
+
+	double** delta;
+	double** u;
+	random_binning_grids(d, D, gamma, delta, u);
 
 	int N = ins_old.size();
 	vector< vector<pair<int,double> > > features;
 	features.resize(D);
-	for(int j=0;j<D;j++)
-		features[j].resize(N);
 	ins_new.resize(N);
+	//first touch of each row by the thread that fills it
+#pragma omp parallel for schedule(static)
 	for(int i=0;i<N;i++)
 		ins_new[i].resize(D);
-	int* offset = new int[D];
-	offset[0] = 0;
-
-	int j_offset = 0;
-	double sqrt_D = sqrt(D);
+	vector<int> nbins_grid(D);
+
+	//per grid: count and label sums of each local bin
+	vector< vector<long> > grid_count;
+	vector< vector<double> > grid_sum;
+	int m = stats ? stats->m : 0;
+	long n_lab = stats ? min(stats->n, (long)N) : 0;
+	if( stats ){
+		grid_count.resize(D);
+		grid_sum.resize(D);
+	}
+	vector<double> xmin, xmax;
+	binning_data_range(d, ins_old, xmin, xmax);
 #pragma omp parallel for
 	for(int j=0; j<D; j++){
 
 		double* delta_j = delta[j];
 		double* u_j = u[j];
 		vector<pair<int,double> >* fea = &(features[j]);
+		fea->resize(N); //first touch by the thread binning grid j
+
+		//packed keys if the codes of the grid fit in 128 bits
+		PackedLayout lay = packed_layout(d, xmin, xmax, delta_j, u_j);
+		vector<long>* count = stats ? &(grid_count[j]) : NULL;
+		vector<double>* sum = stats ? &(grid_sum[j]) : NULL;
+		if( lay.words == 1 ){
+			nbins_grid[j] = PackedDispatch<RANDBIN_PACKED_MAX_DIM, 1>::run(d, ins_old, delta_j, u_j, lay, *fea, stats, n_lab, count, sum);
+			continue;
+		}
+		if( lay.words == 2 ){
+			nbins_grid[j] = PackedDispatch<RANDBIN_PACKED_MAX_DIM, 2>::run(d, ins_old, delta_j, u_j, lay, *fea, stats, n_lab, count, sum);
+			continue;
+		}
 
 		CodeIndexMap code_ind_map;
 		CodeIndexMapIter it;
@@ -156,10 +408,19 @@ void random_binning_feature(int d, int D, vector< vector< pair<int,double> > >&
 				ind = code_ind_map.size();
 				code_ind_map.insert(make_pair(code, ind));
 				//cerr << "ind=" << ind << endl;
+				if( stats ){
+					grid_count[j].push_back(0);
+					grid_sum[j].resize(grid_sum[j].size()+m, 0.0);
+				}
 			}else{
 				ind = it->second;
 				delete code;
 			}
+			if( stats && i < n_lab ){
+				grid_count[j][ind]++;
+				for(int c=0;c<m;c++)
+					grid_sum[j][(long)ind*m+c] += stats->Y[c*stats->n+i];
+			}
 
 			//(*fea)[i] = make_pair(ind + 1, 1.0/sqrt_D) ;
 			(*fea)[i] = make_pair(ind + 1, 1.0) ;
@@ -170,29 +431,381 @@ void random_binning_feature(int d, int D, vector< vector< pair<int,double> > >&
     }
 		
     //cerr << "code size=" << code_ind_map.size() << endl;
-		if(j<D-1)
-			offset[j+1] = code_ind_map.size();
+		nbins_grid[j] = code_ind_map.size();
+	}
+
+	binning_assemble(D, features, nbins_grid, grid_count, grid_sum, ins_new, stats);
+
+	for(int i = 0; i < D; i++){
+		delete[] delta[i];
+		delete[] u[i];
 	}
+	delete[] delta;
+	delete[] u;
+}
 
-	//compute offset
-	for(int j=1;j<D;j++){
-		offset[j] = offset[j] + offset[j-1];
+//Multi-resolution version of random_binning_feature for a sweep of
+//gammas: one pass over ins_old bins the rows for all of them. The grids
+//of the largest gamma (the finest) are drawn as in random_binning_grids;
+//the grid of gamma[k] is the exact coarsening of each fine grid by a
+//factor 2^l in every dimension, l = round(log2(gamma_max/gamma[k])).
+//Since floor(floor(x)/2^l) = floor(x/2^l), the coarse code of a row is
+//(fine code + s) >> l, where s is a random integer in [0, 2^L) per
+//grid and dimension, L the largest level; it makes the offset of the
+//coarse bins uniform over their width, as for independent grids. Hence
+//the widths of level l are drawn from Gamma(2, 2^l/gamma_max), i.e.,
+//gamma[k] is rounded to the nearest gamma_max/2^l, which is returned
+//in gamma_used[k]. Each row is binned once per grid, in the fine
+//dictionary; the bins of each level are derived once per distinct bin
+//of the next finer level, instead of binning the rows once per gamma. ins_new[k] (and (*stats)[k], with the same
+//n, m, Y as (*stats)[0]) holds the features of gamma[k]. The levels are
+//not independent: they share the fine grids.
+void random_binning_feature_nested(int d, int D, vector< vector< pair<int,double> > >& ins_old, vector< vector< vector< pair<int,double> > > >& ins_new, const vector<double>& gamma, vector<double>& gamma_used, vector<BinningStats>* stats = NULL ){
+
+	MemTagScope mem_scope(MEM_BINNING);
+
+	int K = gamma.size();
+	double gamma_max = *max_element(gamma.begin(), gamma.end());
+	vector<int> level(K), order(K);
+	int L = 0;
+	gamma_used.resize(K);
+	for(int k=0;k<K;k++){
+		level[k] = max(0, (int)floor(log2(gamma_max/gamma[k]) + 0.5));
+		level[k] = min(level[k], 30);
+		gamma_used[k] = gamma_max / (double)(1L << level[k]);
+		L = max(L, level[k]);
+		order[k] = k;
 	}
+	//from the finest level to the coarsest
+	stable_sort(order.begin(), order.end(), [&level](int a, int b){ return level[a] < level[b]; });
 
-	for(int j=1;j<D;j++){
-		vector<pair<int,double> >* fea = &(features[j]);
-		int offset_j = offset[j];
-		for(vector<pair<int,double> >::iterator it=fea->begin(); it!=fea->end(); it++)
-			it->first += offset_j;
+	double** delta;
+	double** u;
+	random_binning_grids(d, D, gamma_max, delta, u);
+	vector< vector<long long> > shift(D, vector<long long>(d));
+	for(int j=0;j<D;j++)
+		for(int t=0;t<d;t++)
+			shift[j][t] = (long long)( (double)rand()/((double)RAND_MAX+1.0) * (double)(1L << L) );
+
+	int N = ins_old.size();
+	ins_new.resize(K);
+	vector< vector< vector<pair<int,double> > > > features(K, vector< vector<pair<int,double> > >(D));
+	vector< vector<int> > nbins_grid(K, vector<int>(D));
+	vector< vector< vector<long> > > grid_count(K);
+	vector< vector< vector<double> > > grid_sum(K);
+	BinningStats* st = stats ? &((*stats)[0]) : NULL;
+	int m = st ? st->m : 0;
+	long n_lab = st ? min(st->n, (long)N) : 0;
+	for(int k=0;k<K;k++){
+		ins_new[k].resize(N);
+		if( st ){
+			grid_count[k].resize(D);
+			grid_sum[k].resize(D);
+		}
 	}
+#pragma omp parallel for
+	for(int j=0; j<D; j++){
 
-	//convert to data_new
+		//the rows are looked up in the fine dictionary only; the bin of
+		//each level is derived once per distinct bin of the next finer
+		//level (up), and stored per fine bin in parent
+		CodeIndexMap fine_ind_map;
+		vector<CodeIndexMap> code_ind_map(K);
+		vector< vector<int> > parent(K), up(K);
+		CodeIndexMapIter it;
+		for(int k=0;k<K;k++)
+			features[k][j].resize(N);
+		for(int i=0;i<N;i++){
+			if( ins_old[i].size() == 0 )
+				continue;
+
+			vector<int>* code = compute_bin_num( &(ins_old[i]), delta[j], u[j], d );
+			int f;
+			if( (it=fine_ind_map.find(code)) == fine_ind_map.end() ){
+				f = fine_ind_map.size();
+				fine_ind_map.insert(make_pair(code, f));
+				const vector<int>* prev = code;
+				bool is_new = true;
+				int ind = -1;
+				for(int q=0;q<K;q++){
+					int k = order[q];
+					if( !is_new ){
+						ind = up[q-1][ind];
+						parent[k].push_back(ind);
+						continue;
+					}
+					vector<int>* coarse = new vector<int>(d);
+					for(int t=0;t<d;t++){
+						if( q == 0 )
+							(*coarse)[t] = (int)( ((long long)(*prev)[t] + shift[j][t]) >> level[k] );
+						else
+							(*coarse)[t] = (*prev)[t] >> (level[k] - level[order[q-1]]);
+					}
+					CodeIndexMapIter it2;
+					if( (it2=code_ind_map[k].find(coarse)) == code_ind_map[k].end() ){
+						ind = code_ind_map[k].size();
+						code_ind_map[k].insert(make_pair(coarse, ind));
+						prev = coarse;
+						if( st ){
+							grid_count[k][j].push_back(0);
+							grid_sum[k][j].resize(grid_sum[k][j].size()+m, 0.0);
+						}
+					}else{
+						ind = it2->second;
+						delete coarse;
+						is_new = false;
+					}
+					if( q > 0 )
+						up[q-1].push_back(ind); //bin of level q-1 was new
+					parent[k].push_back(ind);
+				}
+			}else{
+				f = it->second;
+				delete code;
+			}
+			for(int k=0;k<K;k++){
+				int ind = parent[k][f];
+				if( st && i < n_lab ){
+					grid_count[k][j][ind]++;
+					for(int c=0;c<m;c++)
+						grid_sum[k][j][(long)ind*m+c] += st->Y[c*st->n+i];
+				}
+				features[k][j][i] = make_pair(ind + 1, 1.0);
+			}
+		}
+		for(it=fine_ind_map.begin(); it!=fine_ind_map.end(); it++)
+			delete (it->first);
+		for(int k=0;k<K;k++){
+			for(it=code_ind_map[k].begin(); it!=code_ind_map[k].end(); it++)
+				delete (it->first);
+			nbins_grid[k][j] = code_ind_map[k].size();
+		}
+	}
+
+	if( stats ){
+		BinningStats st0 = (*stats)[0];
+		stats->assign(K, st0);
+	}
+	for(int k=0;k<K;k++){
+		binning_assemble(D, features[k], nbins_grid[k], grid_count[k], grid_sum[k], ins_new[k], stats ? &((*stats)[k]) : NULL);
+		vector< vector<pair<int,double> > >().swap(features[k]);
+	}
+
+	for(int i = 0; i < D; i++){
+		delete[] delta[i];
+		delete[] u[i];
+	}
+	delete[] delta;
+	delete[] u;
+}
+
+//Group the rows 0,...,n-1 of ins_new (as produced by
+//random_binning_feature) that fall in the same bin in every grid, i.e.,
+//that have the same signature and hence the same row of Z. On return,
+//group[i] is the group of row i, in the order of the first row of each
+//group, and count[u] is the number of rows of group u. Returns the
+//number of groups. The signatures are hashed in parallel; rows with
+//equal hashes are compared in full, so hash collisions do not merge
+//distinct rows.
+long group_binning_rows(vector< vector< pair<int,double> > >& ins_new, long n, vector<long>& group, vector<long>& count){
+
+	vector< pair<unsigned long long,long> > h(n);
+#pragma omp parallel for schedule(static)
+	for(long i=0;i<n;i++){
+		unsigned long long z = 0x9E3779B97F4A7C15ULL;
+		for(int j=0;j<ins_new[i].size();j++){
+			z ^= (unsigned long long)(unsigned int)ins_new[i][j].first + 0x632BE59BD9B4E019ULL + (z << 6) + (z >> 2);
+			z *= 0xBF58476D1CE4E5B9ULL;
+		}
+		h[i] = make_pair(z, i);
+	}
+	sort(h.begin(), h.end());
+
+	//split each run of equal hashes by the full signature
+	vector<long> first(n); //first row with the same signature
+	for(long a=0;a<n;){
+		long b = a+1;
+		while( b < n && h[b].first == h[a].first )
+			b++;
+		for(long k=a;k<b;k++){
+			long i = h[k].second;
+			first[i] = i;
+			for(long l=a;l<k;l++){
+				long i2 = h[l].second;
+				if( first[i2] == i2 && ins_new[i2].size() == ins_new[i].size() &&
+					equal(ins_new[i].begin(), ins_new[i].end(), ins_new[i2].begin(),
+						[](const pair<int,double>& x, const pair<int,double>& y){ return x.first == y.first; }) ){
+					first[i] = min(i, i2);
+					break;
+				}
+			}
+		}
+		a = b;
+	}
+
+	//number the groups in the order of their first rows
+	group.assign(n, -1);
+	count.clear();
+	for(long i=0;i<n;i++){
+		long f = first[i];
+		if( f == i ){
+			group[i] = count.size();
+			count.push_back(0);
+		}else{
+			group[i] = group[f];
+		}
+		count[group[i]]++;
+	}
+	return count.size();
+}
+
+#ifdef USE_MPI
+//key of the bin code of grid j: two independent 64-bit hashes, so that
+//distinct (grid, code) pairs collide with negligible probability
+struct BinKey{
+	RandomKey h1, h2;
+	bool operator<(const BinKey& b) const { return h1 < b.h1 || (h1 == b.h1 && h2 < b.h2); }
+	bool operator==(const BinKey& b) const { return h1 == b.h1 && h2 == b.h2; }
+};
+
+BinKey bin_key(int j, const vector<int>& code){
+
+	BinKey k;
+	k.h1 = ParRandomKey(2*(unsigned long)j);
+	k.h2 = ParRandomKey(2*(unsigned long)j+1);
+	for(int i=0;i<code.size();i++){
+		RandomKey c = (RandomKey)(unsigned int)code[i];
+		k.h1 = ParRandomMix(k.h1 ^ (c + 0x9E3779B97F4A7C15ULL));
+		k.h2 = ParRandomMix(k.h2 + c * 0xD1B54A32D192ED03ULL);
+	}
+	return k;
+}
+
+//Distributed version of random_binning_feature over the processes of
+//comm. ins_old holds the rows of this process only; all processes
+//must call it with the same d, D, gamma and state of rand(), so that
+//they draw the same grids. Each process bins its rows with local
+//dictionaries, one per grid. The bins are then numbered globally: the
+//key (see bin_key) of every local bin is sent to the process that
+//owns it (h1 mod #processes) with one all-to-all; each owner numbers
+//its distinct keys after the bins of the lower ranks, and returns the
+//global index of every key it received with a second all-to-all.
+//Hence no process holds all the rows or all the dictionaries. The
+//global indices are consistent across the processes but, unlike
+//random_binning_feature, not grouped by grid. Returns the total number
+//of bins.
+long random_binning_feature_dist(int d, int D, vector< vector< pair<int,double> > >& ins_old, vector< vector< pair<int,double> > >& ins_new, double gamma, MPI_Comm comm = MPI_COMM_WORLD){
+
+	MemTagScope mem_scope(MEM_BINNING);
+
+	int rank, P;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &P);
+
+	double** delta;
+	double** u;
+	random_binning_grids(d, D, gamma, delta, u);
+
+	int N = ins_old.size();
+	vector< vector<int> > local_ind(D);   //local bin of each row, per grid
+	vector< vector<BinKey> > keys(D);     //key of each local bin, per grid
+#pragma omp parallel for
+	for(int j=0; j<D; j++){
+
+		local_ind[j].assign(N, -1);
+		CodeIndexMap code_ind_map;
+		CodeIndexMapIter it;
+		vector<int>* code;
+		for(int i=0;i<N;i++){
+			if( ins_old[i].size() == 0 )
+				continue;
+
+			code = compute_bin_num( &(ins_old[i]), delta[j], u[j], d );
+			int ind;
+			if( (it=code_ind_map.find(code)) == code_ind_map.end() ){
+				ind = code_ind_map.size();
+				code_ind_map.insert(make_pair(code, ind));
+				keys[j].push_back(bin_key(j, *code));
+			}else{
+				ind = it->second;
+				delete code;
+			}
+			local_ind[j][i] = ind;
+		}
+		for(it=code_ind_map.begin(); it!=code_ind_map.end(); it++){
+			delete (it->first);
+		}
+	}
+
+	//send the keys to their owners
+	vector<int> send_cnt(P, 0), recv_cnt(P), send_displ(P+1, 0), recv_displ(P+1, 0);
+	for(int j=0;j<D;j++)
+		for(int b=0;b<keys[j].size();b++)
+			send_cnt[keys[j][b].h1 % P] += 2;
+	MPI_Alltoall(&(send_cnt[0]), 1, MPI_INT, &(recv_cnt[0]), 1, MPI_INT, comm);
+	for(int p=0;p<P;p++){
+		send_displ[p+1] = send_displ[p] + send_cnt[p];
+		recv_displ[p+1] = recv_displ[p] + recv_cnt[p];
+	}
+	vector<RandomKey> send_buf(send_displ[P]+1), recv_buf(recv_displ[P]+1);
+	vector<int> pos(send_displ.begin(), send_displ.end()-1);
+	for(int j=0;j<D;j++)
+		for(int b=0;b<keys[j].size();b++){
+			int p = keys[j][b].h1 % P;
+			send_buf[pos[p]++] = keys[j][b].h1;
+			send_buf[pos[p]++] = keys[j][b].h2;
+		}
+	MPI_Alltoallv(&(send_buf[0]), &(send_cnt[0]), &(send_displ[0]), MPI_UNSIGNED_LONG_LONG,
+		&(recv_buf[0]), &(recv_cnt[0]), &(recv_displ[0]), MPI_UNSIGNED_LONG_LONG, comm);
+
+	//number the distinct keys owned by this process
+	long nrecv = recv_displ[P]/2;
+	vector<BinKey> owned(nrecv);
+	for(long k=0;k<nrecv;k++){
+		owned[k].h1 = recv_buf[2*k];
+		owned[k].h2 = recv_buf[2*k+1];
+	}
+	sort(owned.begin(), owned.end());
+	owned.erase(unique(owned.begin(), owned.end()), owned.end());
+	long nowned = owned.size(), base = 0, total = 0;
+	MPI_Exscan(&nowned, &base, 1, MPI_LONG, MPI_SUM, comm);
+	if( rank == 0 )
+		base = 0;
+	MPI_Allreduce(&nowned, &total, 1, MPI_LONG, MPI_SUM, comm);
+
+	//return the global index of every key received
+	vector<int> id_send(nrecv+1), id_recv(send_displ[P]/2+1);
+	for(long k=0;k<nrecv;k++){
+		BinKey key;
+		key.h1 = recv_buf[2*k];
+		key.h2 = recv_buf[2*k+1];
+		id_send[k] = base + (lower_bound(owned.begin(), owned.end(), key) - owned.begin()) + 1;
+	}
+	for(int p=0;p<P;p++){
+		send_cnt[p] /= 2; send_displ[p] /= 2;
+		recv_cnt[p] /= 2; recv_displ[p] /= 2;
+	}
+	MPI_Alltoallv(&(id_send[0]), &(recv_cnt[0]), &(recv_displ[0]), MPI_INT,
+		&(id_recv[0]), &(send_cnt[0]), &(send_displ[0]), MPI_INT, comm);
+
+	//remap the local bins, in the order in which the keys were sent
+	vector< vector<int> > remap(D);
+	for(int p=0;p<P;p++)
+		pos[p] = send_displ[p];
 	for(int j=0;j<D;j++){
+		remap[j].resize(keys[j].size());
+		for(int b=0;b<keys[j].size();b++)
+			remap[j][b] = id_recv[pos[keys[j][b].h1 % P]++];
+	}
 
-		vector<pair<int,double> >* fea = &(features[j]);
-		int i=0;
-		for(vector<pair<int,double> >::iterator it=fea->begin(); it!=fea->end(); it++, i++){
-			ins_new[i][j] = make_pair(it->first, sqrt(1.0/D)*it->second);
+	double scale = sqrt(1.0/D);
+	ins_new.resize(N);
+#pragma omp parallel for schedule(static)
+	for(int i=0;i<N;i++){
+		ins_new[i].resize(D);
+		for(int j=0;j<D;j++){
+			int ind = local_ind[j][i];
+			ins_new[i][j] = ind < 0 ? make_pair(1, 0.0) : make_pair(remap[j][ind], scale); //empty row: zero value
 		}
 	}
 
@@ -200,10 +813,12 @@ void random_binning_feature(int d, int D, vector< vector< pair<int,double> > >&
 		delete[] delta[i];
 		delete[] u[i];
 	}
-	delete[] offset;
 	delete[] delta;
 	delete[] u;
+
+	return total;
 }
+#endif
 
 void random_fourier_feature(int d, int D, vector< vector< pair<int,double> > >& ins_old, vector< vector< pair<int,double> > >& ins_new, double gamma ){
 	
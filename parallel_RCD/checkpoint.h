@@ -0,0 +1,199 @@
+//Checkpoints of rcd (see rcd.h), written asynchronously.
+//
+//CkptWriter owns a background thread that writes the buffers posted to
+//it to file.tmp, then renames file.tmp to file, so that the file always
+//holds a complete checkpoint (a preemption during a write leaves the
+//previous one). post() only swaps buffers with the writer; when a
+//checkpoint is posted while the previous one is still being written,
+//it replaces the one waiting, if any, so that at most one write is
+//behind the solver.
+//
+//RcdCheckpoint is the state of rcd at the end of an iteration (stopped:
+//rcd stopped there, before nIter, e.g., by early stopping):
+//  char magic[8]; int d, n, iter, stopped, max_id, num_worse, has_best
+//  double lambda, best_err
+//  int    ids[d]           (feature id at each position)
+//  double w[d]             (weights at each position)
+//  double factors[n]       (inner products of the rows with w)
+//  double w_best[max_id+1] (validation: weights of the smallest error,
+//                           if has_best)
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "omp.h"
+#include "util.h"
+
+using namespace std;
+
+class CkptWriter{
+	public:
+	CkptWriter(const char* file_): file(file_), pending(false), busy(false), done(false), num_written(0), num_failed(0){
+		th = thread(&CkptWriter::run, this);
+	}
+
+	//writes the pending checkpoint, if any, before returning
+	~CkptWriter(){
+		{
+			lock_guard<mutex> lock(mtx);
+			done = true;
+		}
+		cv.notify_all();
+		th.join();
+	}
+
+	//hand buf over to the writer; buf gets an old buffer back, for reuse
+	void post(vector<char>& buf){
+		{
+			lock_guard<mutex> lock(mtx);
+			next.swap(buf);
+			pending = true;
+		}
+		cv.notify_all();
+	}
+
+	//wait until the posted checkpoints are written
+	void flush(){
+		unique_lock<mutex> lock(mtx);
+		cv.wait(lock, [this]{ return !pending && !busy; });
+	}
+
+	int written(){ lock_guard<mutex> lock(mtx); return num_written; }
+	int failed(){ lock_guard<mutex> lock(mtx); return num_failed; }
+
+	private:
+	string file;
+	vector<char> next, cur;
+	bool pending, busy, done;
+	int num_written, num_failed;
+	mutex mtx;
+	condition_variable cv;
+	thread th;
+
+	void run(){
+		unique_lock<mutex> lock(mtx);
+		while( true ){
+			cv.wait(lock, [this]{ return pending || done; });
+			if( !pending )
+				break;
+			cur.swap(next);
+			pending = false;
+			busy = true;
+			lock.unlock();
+			bool ok = write_file();
+			lock.lock();
+			busy = false;
+			ok ? num_written++ : num_failed++;
+			cv.notify_all();
+		}
+	}
+
+	bool write_file(){
+		string tmp = file + ".tmp";
+		FILE* fp = fopen(tmp.c_str(), "wb");
+		if( fp == NULL )
+			return false;
+		bool ok = fwrite(&(cur[0]), 1, cur.size(), fp) == cur.size() && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+		ok = fclose(fp) == 0 && ok;
+		return ok && rename(tmp.c_str(), file.c_str()) == 0;
+	}
+};
+
+//Checkpoint hook of rcd: with every = t, the state is posted to the
+//writer at the end of the first iteration after t seconds from the
+//previous checkpoint (the cost on the solver is a copy of w and the
+//factors), and at the end of rcd. rcd resumes from the file when it
+//exists and matches the problem (d, n, lambda and the feature ids).
+class RcdCheckpoint{
+	public:
+	RcdCheckpoint(const char* file_, double every_): file(file_), every(every_), writer(file_){
+		last = omp_get_wtime();
+	}
+
+	bool due(){
+		return omp_get_wtime()-last >= every;
+	}
+
+	void save(int iter, bool stopped, vector<Feature*>& features, const double* w, const double* factors, int n, double lambda, int max_id, const vector<double>& w_best, double best_err, int num_worse){
+		int d = features.size();
+		int head[7] = {d, n, iter, stopped, max_id, num_worse, !w_best.empty()};
+		double vals[2] = {lambda, best_err};
+		buf.clear();
+		append("RCDCKPT1", 8);
+		append(head, sizeof(head));
+		append(vals, sizeof(vals));
+		size_t off = buf.size();
+		buf.resize(off + (size_t)d*sizeof(int));
+		for(int i=0;i<d;i++){
+			int id = features[i]->id;
+			memcpy(&(buf[off + (size_t)i*sizeof(int)]), &id, sizeof(int));
+		}
+		append(w, (size_t)d*sizeof(double));
+		append(factors, (size_t)n*sizeof(double));
+		if( !w_best.empty() )
+			append(&(w_best[0]), (size_t)(max_id+1)*sizeof(double));
+		writer.post(buf);
+		last = omp_get_wtime();
+	}
+
+	//read the state of a checkpoint of the same problem; ids, w and
+	//factors have room for d, d and n values. Returns false if there is
+	//none.
+	bool restore(int d, int n, double lambda, int max_id, int& iter, bool& stopped, int* ids, double* w, double* factors, vector<double>& w_best, double& best_err, int& num_worse){
+		FILE* fp = fopen(file.c_str(), "rb");
+		if( fp == NULL )
+			return false;
+		char magic[8];
+		int head[7];
+		double vals[2];
+		bool ok = fread(magic, 1, 8, fp) == 8 && memcmp(magic, "RCDCKPT1", 8) == 0 &&
+			fread(head, sizeof(int), 7, fp) == 7 && fread(vals, sizeof(double), 2, fp) == 2 &&
+			head[0] == d && head[1] == n && head[4] == max_id && vals[0] == lambda &&
+			fread(ids, sizeof(int), d, fp) == (size_t)d &&
+			fread(w, sizeof(double), d, fp) == (size_t)d &&
+			fread(factors, sizeof(double), n, fp) == (size_t)n;
+		if( ok && head[6] ){
+			w_best.resize(max_id+1);
+			ok = fread(&(w_best[0]), sizeof(double), max_id+1, fp) == (size_t)(max_id+1);
+		}
+		fclose(fp);
+		if( !ok ){
+			w_best.clear();
+			return false;
+		}
+		if( !head[6] )
+			w_best.clear();
+		iter = head[2];
+		stopped = head[3] != 0;
+		num_worse = head[5];
+		best_err = vals[1];
+		return true;
+	}
+
+	void flush(){ writer.flush(); }
+	int written(){ return writer.written(); }
+	int failed(){ return writer.failed(); }
+
+	private:
+	string file;
+	double every, last;
+	vector<char> buf;
+	CkptWriter writer;
+
+	void append(const void* p, size_t bytes){
+		size_t off = buf.size();
+		buf.resize(off + bytes);
+		if( bytes > 0 )
+			memcpy(&(buf[off]), p, bytes);
+	}
+};
+
+#endif
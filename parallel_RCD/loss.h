@@ -7,6 +7,7 @@ using namespace std;
 class LossFunc{
 	
 	public:
+	virtual ~LossFunc(){}
 	virtual double fval(double v, double y)=0;
 	virtual double deriv(double v, double y)=0;
 	virtual double sec_deriv_ubound()=0;
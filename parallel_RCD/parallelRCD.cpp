@@ -43,7 +43,7 @@ double accuracy( vector<Instance*>& data, vector<double>& labels, double* w, int
 int main(int argc, char** argv){
 
 	if( argc < 1+6 ){
-		cerr << "./parallelRCD [data] [testdata] [L1_lambda] [loss(0:square,1:L2-hinge,2:logistic)] [num_threads] [num_iter] (stop_obj)" << endl;
+		cerr << "./parallelRCD [data] [testdata] [L1_lambda] [loss(0:square,1:L2-hinge,2:logistic)] [num_threads] [num_iter] (stop_obj) (checkpoint) (checkpoint_every(s))" << endl;
 		exit(0);
 	}
 
@@ -58,6 +58,14 @@ int main(int argc, char** argv){
 	if( argc >= 1+7 ){
 		stop_obj = atof(argv[7]);
 	}
+	//checkpoint file of rcd, written every checkpoint_every seconds
+	//(default 600); a run with an existing checkpoint resumes from it
+	char* ckptFname = NULL;
+	double ckpt_every = 600.0;
+	if( argc >= 1+8 && strcmp(argv[8], "-") != 0 )
+		ckptFname = argv[8];
+	if( argc >= 1+9 )
+		ckpt_every = atof(argv[9]);
 	
 	omp_set_num_threads(nThreads);
 	
@@ -84,7 +92,12 @@ int main(int argc, char** argv){
 		loss = new LogisticLoss();
 
 	double* w = new double[d];
-	rcd(features,labels,n,loss,lambda,w,nThreads, nIter, stop_obj);
+	RcdCheckpoint* ckpt = ckptFname ? new RcdCheckpoint(ckptFname, ckpt_every) : NULL;
+	rcd(features,labels,n,loss,lambda,w,nThreads, nIter, stop_obj, NULL, NULL, NULL, ckpt);
+	if( ckpt ){
+		cerr << "checkpoints written=" << ckpt->written() << " failed=" << ckpt->failed() << endl;
+		delete ckpt;
+	}
 	
 	int d2;
 	readData(testFname, testdata, testlabels, d2);
@@ -4,7 +4,26 @@
 #include "loss.h"
 #include "util.h"
 #include "omp.h"
-void rcd(vector<Feature*>& features, vector<double>& labels, int n, LossFunc* loss, double lambda,  double* w_ret, int nr_threads, int nIter, double stop_obj){
+#include "checkpoint.h"
+
+//Validation hook of rcd: every `every` iterations, error(w) is called with
+//the weights indexed by feature id (as w_ret), e.g., the loss on held-out
+//rows. rcd stops when the error has not decreased for `patience`
+//consecutive checks, and returns the weights of the smallest error.
+class RcdValidation{
+	public:
+	int every, patience;
+	RcdValidation(int every_, int patience_): every(every_), patience(patience_){}
+	virtual ~RcdValidation(){}
+	virtual double error(const double* w) = 0;
+};
+
+//w_init (optional, indexed by feature id): initial weights for a warm start
+//inst_w (optional, indexed by instance): instance weights, the loss of instance i is multiplied by inst_w[i]
+//val (optional): early stopping on a validation error, see RcdValidation
+//ckpt (optional): checkpoints of the state, and resume from the last one, see RcdCheckpoint in checkpoint.h
+//verbose: print the progress to cout
+void rcd(vector<Feature*>& features, vector<double>& labels, int n, LossFunc* loss, double lambda,  double* w_ret, int nr_threads, int nIter, double stop_obj, double* w_init = NULL, const double* inst_w = NULL, RcdValidation* val = NULL, RcdCheckpoint* ckpt = NULL, bool verbose = true){
 	double* factors = new double[n];
 	
 	int d = features.size();
@@ -14,7 +33,7 @@ void rcd(vector<Feature*>& features, vector<double>& labels, int n, LossFunc* lo
 		Feature* fea = features[r];
 		H_diag[r] = 0.0;
 		for(SparseVec::iterator it=fea->values.begin(); it!=fea->values.end(); it++){
-			H_diag[r] += it->second*it->second;
+			H_diag[r] += (inst_w ? inst_w[it->first] : 1.0) * it->second*it->second;
 		}
 	}
 	
@@ -25,6 +44,17 @@ void rcd(vector<Feature*>& features, vector<double>& labels, int n, LossFunc* lo
 	for (int i=0;i<n;i++){
 		factors[i] = 0.0;
 	}
+	if( w_init != NULL ){
+		for(int r=0;r<d;r++){
+			Feature* fea = features[r];
+			w[r] = w_init[fea->id];
+			if( w[r] == 0.0 )
+				continue;
+			for(SparseVec::iterator it=fea->values.begin(); it!=fea->values.end(); it++){
+				factors[it->first] += w[r]*it->second;
+			}
+		}
+	}
 	int max_iter = nIter;
 	
 	int ins_id;
@@ -37,10 +67,62 @@ void rcd(vector<Feature*>& features, vector<double>& labels, int n, LossFunc* lo
     int Seed = 0;	
     // Seed the RNG
     srandom(Seed);	
+	//validation: weights by feature id, and those of the smallest error
+	int max_id = 0;
+	for(int r=0;r<d;r++)
+		max_id = max(max_id, features[r]->id);
+	vector<double> w_id, w_best;
+	double best_err = 0.0;
+	int num_worse = 0;
+	if( val != NULL )
+		w_id.assign(max_id+1, 0.0);
+
+	//resume: the features are put back in the order of the checkpoint,
+	//and the shuffles go on from a seed of the iteration
+	int iter_start = 1;
+	if( ckpt != NULL ){
+		vector<int> ids(d), pos(max_id+1, -1);
+		vector<double> w_ck(d), factors_ck(n);
+		int iter_ck;
+		bool stopped;
+		bool ok = ckpt->restore(d, n, lambda, max_id, iter_ck, stopped, &(ids[0]), &(w_ck[0]), &(factors_ck[0]), w_best, best_err, num_worse);
+		for(int r=0;ok && r<d;r++)
+			pos[features[r]->id] = r;
+		for(int i=0;ok && i<d;i++){
+			ok = ids[i] >= 0 && ids[i] <= max_id && pos[ids[i]] >= 0;
+			if( ok )
+				pos[ids[i]] = -1; //each id once
+		}
+		if( ok ){
+			if( val == NULL )
+				w_best.clear();
+			for(int r=0;r<d;r++)
+				pos[features[r]->id] = r;
+			vector<Feature*> features_ck(d);
+			vector<double> H_ck(d);
+			for(int i=0;i<d;i++){
+				features_ck[i] = features[pos[ids[i]]];
+				H_ck[i] = H_diag[pos[ids[i]]];
+			}
+			features.swap(features_ck);
+			memcpy(H_diag, &(H_ck[0]), d*sizeof(double));
+			memcpy(w, &(w_ck[0]), d*sizeof(double));
+			memcpy(factors, &(factors_ck[0]), n*sizeof(double));
+			iter_start = stopped ? max_iter+1 : iter_ck+1;
+			srandom(Seed + iter_ck);
+			if( verbose )
+				cout << "resumed from checkpoint at iteration " << iter_ck << (stopped ? " (stopped)" : "") << endl;
+		}else{
+			w_best.clear();
+			num_worse = 0;
+		}
+	}
+
 	int chunk = 10000;
 	double start = omp_get_wtime();
 	double minus_time=0.0;
-	for (int iter=1;iter<=max_iter; iter++){
+	int iter;
+	for (iter=iter_start;iter<=max_iter; iter++){
 	
 		#pragma omp parallel shared(chunk)
 		{
@@ -55,7 +137,7 @@ void rcd(vector<Feature*>& features, vector<double>& labels, int n, LossFunc* lo
 				//update w
 				double gradient =  0.0;
 				for (SparseVec::iterator ii = fea->values.begin(); ii != fea->values.end(); ++ii){
-					gradient += loss->deriv(factors[ii->first],labels[ii->first]) * ii->second;
+					gradient += (inst_w ? inst_w[ii->first] : 1.0) * loss->deriv(factors[ii->first],labels[ii->first]) * ii->second;
 				}
 				double eta = softThd(w[j] - gradient/(Qii),lambda/(Qii)) - w[j];
 				if( fabs(eta)>1e-10 ){
@@ -73,7 +155,7 @@ void rcd(vector<Feature*>& features, vector<double>& labels, int n, LossFunc* lo
 			minus_time -= omp_get_wtime();
 			funval = 0.0;
 			for (int i=0;i<n;i++){
-				funval +=  loss->fval(factors[i],labels[i]);
+				funval +=  (inst_w ? inst_w[i] : 1.0) * loss->fval(factors[i],labels[i]);
 			}
 			int nnz = 0;
 			for (int i=0; i<d;i++){
@@ -93,17 +175,55 @@ void rcd(vector<Feature*>& features, vector<double>& labels, int n, LossFunc* lo
 
 			double end = omp_get_wtime();
 			double time_used = end-start-minus_time;
-			cout  << setprecision(15)<<setw(20) << iter << setw(20) << time_used << setw(20) << funval << setw(10)<<nnz<< endl;
+			if( verbose )
+				cout  << setprecision(15)<<setw(20) << iter << setw(20) << time_used << setw(20) << funval << setw(10)<<nnz<< endl;
 			if( funval < stop_obj ){
 				break;
 			}
 		}
+
+		if( val != NULL && iter % val->every == 0 ){
+			minus_time -= omp_get_wtime();
+			for(int i=0;i<d;i++)
+				w_id[features[i]->id] = w[i];
+			double err = val->error(&(w_id[0]));
+			bool better = w_best.empty() || err < best_err;
+			if( better ){
+				best_err = err;
+				w_best = w_id;
+				num_worse = 0;
+			}else
+				num_worse++;
+			minus_time += omp_get_wtime();
+			if( verbose )
+				cout << "validation" << setw(10) << iter << setw(20) << err << (better ? " *" : "") << endl;
+			if( num_worse >= val->patience )
+				break;
+		}
+
+		if( ckpt != NULL && ckpt->due() ){
+			minus_time -= omp_get_wtime();
+			ckpt->save(iter, false, features, w, factors, n, lambda, max_id, w_best, best_err, num_worse);
+			minus_time += omp_get_wtime();
+		}
+	}
+	//the final state, so that a run resumed after the end of rcd does
+	//not iterate again (or only beyond nIter)
+	if( ckpt != NULL && iter_start <= max_iter ){
+		ckpt->save(min(iter, max_iter), iter <= max_iter, features, w, factors, n, lambda, max_id, w_best, best_err, num_worse);
+		ckpt->flush();
 	}
 	
 	for(int i=0;i<d;i++){
 		int j = features[i]->id;
 		w_ret[j] = w[i];
 	}
+	if( !w_best.empty() ){
+		for(int i=0;i<d;i++){
+			int j = features[i]->id;
+			w_ret[j] = w_best[j];
+		}
+	}
 
 	delete [] H_diag;
 	delete [] factors;
@@ -0,0 +1,442 @@
+#ifndef BINNING_H
+#define BINNING_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <utility>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
+
+#include "Gamma.h"
+#include "util.h"
+#include "rbmodel.h"
+
+using namespace std;
+
+const double NONE_LABEL = -19191.0;
+
+//parse the LibSVM row "label idx:val idx:val ..." of the null-terminated
+//line p into y and x; returns false if the line has no label
+inline bool parse_svm_row(const char* p, vector< pair<int,double> >& x, double& y){
+
+	x.clear();
+	char* end;
+	y = strtod(p, &end);
+	if( end == p )
+		return false;
+	p = end;
+	while( true ){
+		long index = strtol(p, &end, 10);
+		if( end == p || *end != ':' )
+			break;
+		p = end+1;
+		double v = strtod(p, &end);
+		p = end;
+		x.push_back(make_pair((int)index, v));
+	}
+	return true;
+}
+
+//Append the rows of a LibSVM file to ins and labs; d is the largest
+//feature index. An empty line (or one without label) gives an empty
+//row with the label NONE_LABEL. The file is read at once and its
+//lines are parsed in parallel.
+void readSVMfile(const char* f, int& d, vector< vector< pair<int,double> > >& ins, vector<double>& labs){
+
+	d = 0;
+
+	FILE* fp = fopen(f, "rb");
+	if( fp == NULL ){
+		cerr << "error reading file." << endl;
+		return;
+	}
+	vector<char> buf;
+	size_t len = 0;
+	char block[1<<16];
+	size_t got;
+	while( (got = fread(block, 1, sizeof(block), fp)) > 0 ){
+		buf.insert(buf.end(), block, block+got);
+		len += got;
+	}
+	fclose(fp);
+	buf.push_back('\0');
+
+	//split into null-terminated lines
+	vector<size_t> line_start;
+	for(size_t pos=0;pos<len;){
+		line_start.push_back(pos);
+		char* nl = (char*)memchr(&(buf[pos]), '\n', len-pos);
+		if( nl == NULL )
+			break;
+		*nl = '\0';
+		pos = nl - &(buf[0]) + 1;
+	}
+
+	long n0 = ins.size(), l0 = labs.size(), n = line_start.size();
+	ins.resize(n0+n);
+	labs.resize(l0+n);
+	int dmax = 0;
+#pragma omp parallel for schedule(dynamic, 1024) reduction(max:dmax)
+	for(long i=0;i<n;i++){
+		vector< pair<int,double> >& x = ins[n0+i];
+		if( !parse_svm_row(&(buf[line_start[i]]), x, labs[l0+i]) ){
+			x.clear();
+			labs[l0+i] = NONE_LABEL;
+			continue;
+		}
+		for(size_t k=0;k<x.size();k++)
+			if( x[k].first > dmax )
+				dmax = x[k].first;
+	}
+	d = dmax;
+}
+
+//Read up to max_rows rows of a LibSVM file into ins[0..] and labs[0..]
+//(reused across chunks); returns the number read. The lines are read
+//sequentially and parsed in parallel; the empty lines and the lines
+//without label are skipped.
+long read_svm_chunk(ifstream& fs, long max_rows, vector< vector< pair<int,double> > >& ins, vector<double>& labs){
+
+	vector<string> lines;
+	string line;
+	long m = 0;
+	while( m == 0 && fs ){
+		lines.clear();
+		while( (long)lines.size() < max_rows && getline(fs, line) ){
+			if( line.length() < 1 )
+				continue;
+			lines.push_back(line);
+		}
+		long n = lines.size();
+		if( (long)ins.size() < n )
+			ins.resize(n);
+		if( (long)labs.size() < n )
+			labs.resize(n);
+		vector<char> ok(n);
+#pragma omp parallel for schedule(dynamic, 256)
+		for(long i=0;i<n;i++)
+			ok[i] = parse_svm_row(lines[i].c_str(), ins[i], labs[i]);
+
+		for(long i=0;i<n;i++){
+			if( !ok[i] )
+				continue;
+			if( m < i ){
+				ins[m].swap(ins[i]);
+				labs[m] = labs[i];
+			}
+			m++;
+		}
+	}
+	return m;
+}
+
+vector<int>* compute_bin_num( vector<pair<int,double> >* ins, double* delta, double* u, int d ){
+
+	vector<int>* code = new vector<int>();
+	code->resize(d);
+
+	int j=0;
+	for(vector<pair<int,double> >::iterator it=ins->begin(); it!=ins->end(); it++){
+		while( j < it->first ){
+			(*code)[j] = floor((0.0-u[j])/delta[j]) ;
+			j++;
+		}
+
+		(*code)[j] = floor( (it->second-u[j])/delta[j] ) ;
+		j++;
+	}
+	while( j < d ){
+		(*code)[j] = floor((0.0-u[j])/delta[j]) ;
+		j++;
+	}
+
+	return code;
+}
+
+//Random binning of ins_old with D grids, without materializing the
+//feature vectors. On return, bin[(long)i*D+j] is the global (1-based)
+//index of the bin of grid j that contains row i, or 0 if row i is
+//empty; the bins of grid j are offset[j]+1,...,offset[j+1]. Every
+//nonzero feature has the value 1/sqrt(D). The grids are drawn exactly
+//as in random_binning_feature (randFeature_par.cpp), so the indices
+//coincide with the ones written by randFeature_par. If grids is not
+//NULL, the grids and the bin dictionaries are also returned (see
+//rbmodel.h), so that new rows can be binned later. If rng is not NULL,
+//the offsets are drawn from it instead of rand(), e.g., for concurrent
+//calls. Returns the total number of bins.
+int random_binning_index(int d, int D, vector< vector< pair<int,double> > >& ins_old, double gamma, vector<int>& bin, vector<int>& offset, binning_grids* grids = NULL, mt19937* rng = NULL){
+
+	double** delta = new double*[D];
+	double** u = new double*[D];
+
+	Gamma gamma_dist(gamma);
+
+	for(int i = 0; i < D; i++){
+		delta[i] = new double[d];
+		u[i] = new double[d];
+	}
+	for(int i = 0; i < D; i++){
+		for(int j = 0; j < d; j++){
+			delta[i][j] = gamma_dist.generate();
+			double r = rng ? generate_canonical<double, 32>(*rng) : (double)rand()/RAND_MAX;
+			u[i][j] = r*delta[i][j];
+		}
+	}
+
+	int N = ins_old.size();
+	bin.resize((long)N*D);
+	offset.assign(D+1, 0);
+	vector< vector<int> > grid_codes, grid_ind;
+	if( grids ){
+		grid_codes.resize(D);
+		grid_ind.resize(D);
+	}
+
+#pragma omp parallel for
+	for(int j=0; j<D; j++){
+
+		double* delta_j = delta[j];
+		double* u_j = u[j];
+
+		CodeIndexMap code_ind_map;
+		CodeIndexMapIter it;
+		vector<int>* code;
+		for(int i=0;i<N;i++){
+			if( ins_old[i].size() == 0 ){
+				bin[(long)i*D+j] = 0;
+				continue;
+			}
+
+			code = compute_bin_num( &(ins_old[i]), delta_j,  u_j, d );
+			int ind;
+			if( (it=code_ind_map.find(code)) == code_ind_map.end() ){
+				ind = code_ind_map.size();
+				code_ind_map.insert(make_pair(code, ind));
+			}else{
+				ind = it->second;
+				delete code;
+			}
+			bin[(long)i*D+j] = ind + 1;
+		}
+		for(CodeIndexMap::iterator it=code_ind_map.begin(); it!=code_ind_map.end(); it++){
+			if( grids ){ //the map iterates the codes in lexicographic order
+				grid_codes[j].insert(grid_codes[j].end(), it->first->begin(), it->first->end());
+				grid_ind[j].push_back(it->second + 1);
+			}
+			delete (it->first);
+		}
+		offset[j+1] = code_ind_map.size();
+	}
+
+	//prefix sums of the bin counts, then shift the indices of each grid
+	for(int j=1;j<=D;j++){
+		offset[j] += offset[j-1];
+	}
+#pragma omp parallel for schedule(static)
+	for(int i=0;i<N;i++){
+		int* bin_i = &(bin[(long)i*D]);
+		if( bin_i[0] == 0 )
+			continue;
+		for(int j=1;j<D;j++)
+			bin_i[j] += offset[j];
+	}
+
+	if( grids ){
+		grids->d = d;
+		grids->D = D;
+		grids->delta.resize((long)D*d);
+		grids->u.resize((long)D*d);
+		for(int j=0;j<D;j++){
+			memcpy(&(grids->delta[(long)j*d]), delta[j], d*sizeof(double));
+			memcpy(&(grids->u[(long)j*d]), u[j], d*sizeof(double));
+		}
+		grids->offset = offset;
+		grids->codes.resize((long)offset[D]*d);
+		grids->ids.resize(offset[D]);
+#pragma omp parallel for schedule(dynamic)
+		for(int j=0;j<D;j++){
+			if( !grid_codes[j].empty() )
+				memcpy(&(grids->codes[(long)offset[j]*d]), &(grid_codes[j][0]), grid_codes[j].size()*sizeof(int));
+			for(int k=0;k<grid_ind[j].size();k++)
+				grids->ids[offset[j]+k] = grid_ind[j][k] + offset[j];
+		}
+	}
+
+	for(int i = 0; i < D; i++){
+		delete[] delta[i];
+		delete[] u[i];
+	}
+	delete[] delta;
+	delete[] u;
+
+	return offset[D];
+}
+
+//Bin new rows ins against existing grids g (e.g., copied from a model
+//file by rb_model_to_grids). A code found in the dictionary of a grid
+//keeps its index; new codes get new indices, appended after the
+//existing ones, and are merged into the dictionaries. bin is as in
+//random_binning_index. Returns the new total number of bins.
+int extend_binning_index(binning_grids& g, vector< vector< pair<int,double> > >& ins, vector<int>& bin){
+
+	int d = g.d, D = g.D;
+	int N = ins.size();
+	int nbins_old = g.ids.size();
+	bin.resize((long)N*D);
+	vector<int> count(D+1, 0);
+	vector< vector<int> > new_codes(D), new_ind(D);
+
+#pragma omp parallel for schedule(dynamic)
+	for(int j=0; j<D; j++){
+
+		const double* delta_j = &(g.delta[(long)j*d]);
+		const double* u_j = &(g.u[(long)j*d]);
+		vector<int> code(d);
+
+		CodeIndexMap code_ind_map;
+		CodeIndexMapIter it;
+		for(int i=0;i<N;i++){
+			if( ins[i].size() == 0 ){
+				bin[(long)i*D+j] = 0;
+				continue;
+			}
+			rb_code(&(ins[i][0]), ins[i].size(), delta_j, u_j, d, &(code[0]));
+			int k = rb_find(&(g.codes[0]), &(g.ids[0]), g.offset[j], g.offset[j+1], d, &(code[0]));
+			if( k > 0 ){
+				bin[(long)i*D+j] = k;
+				continue;
+			}
+			//new bin: stored as -(local index+1) until the offsets are known
+			int ind;
+			if( (it=code_ind_map.find(&code)) == code_ind_map.end() ){
+				ind = code_ind_map.size();
+				code_ind_map.insert(make_pair(new vector<int>(code), ind));
+			}else{
+				ind = it->second;
+			}
+			bin[(long)i*D+j] = -(ind+1);
+		}
+		for(it=code_ind_map.begin(); it!=code_ind_map.end(); it++){
+			new_codes[j].insert(new_codes[j].end(), it->first->begin(), it->first->end());
+			new_ind[j].push_back(it->second);
+			delete (it->first);
+		}
+		count[j+1] = code_ind_map.size();
+	}
+
+	for(int j=1;j<=D;j++){
+		count[j] += count[j-1];
+	}
+#pragma omp parallel for schedule(static)
+	for(int i=0;i<N;i++){
+		int* bin_i = &(bin[(long)i*D]);
+		for(int j=0;j<D;j++)
+			if( bin_i[j] < 0 )
+				bin_i[j] = nbins_old + count[j] - bin_i[j];
+	}
+
+	//merge the new codes into the sorted dictionaries
+	vector<int> offset(D+1), codes((long)(nbins_old+count[D])*d), ids(nbins_old+count[D]);
+	for(int j=0;j<=D;j++)
+		offset[j] = g.offset[j] + count[j];
+#pragma omp parallel for schedule(dynamic)
+	for(int j=0;j<D;j++){
+		int a = g.offset[j], a_end = g.offset[j+1];
+		int b = 0, b_end = new_ind[j].size();
+		int pos = offset[j];
+		while( a < a_end || b < b_end ){
+			bool take_old = b == b_end || ( a < a_end &&
+				lexicographical_compare(&(g.codes[(long)a*d]), &(g.codes[(long)a*d])+d, &(new_codes[j][(long)b*d]), &(new_codes[j][(long)b*d])+d) );
+			if( take_old ){
+				memcpy(&(codes[(long)pos*d]), &(g.codes[(long)a*d]), d*sizeof(int));
+				ids[pos] = g.ids[a];
+				a++;
+			}else{
+				memcpy(&(codes[(long)pos*d]), &(new_codes[j][(long)b*d]), d*sizeof(int));
+				ids[pos] = nbins_old + count[j] + new_ind[j][b] + 1;
+				b++;
+			}
+			pos++;
+		}
+	}
+	g.offset.swap(offset);
+	g.codes.swap(codes);
+	g.ids.swap(ids);
+
+	return nbins_old + count[D];
+}
+
+//Group the rows rows[0],...,rows[n-1] that fall in the same bin in
+//every grid, i.e., that have the same D bin indices (see
+//random_binning_index) and hence the same binning features. If labs is
+//not NULL, rows with different labels labs[rows[i]] are kept in
+//different groups. On return, group[i] is the group of rows[i], in the
+//order of the first row of each group, and count[u] is the number of
+//rows of group u. Returns the number of groups. The signatures are
+//hashed in parallel; rows with equal hashes are compared in full.
+int group_bin_rows(vector<int>& bin, int D, vector<int>& rows, vector<double>* labs, vector<int>& group, vector<int>& count){
+
+	long n = rows.size();
+	vector< pair<unsigned long long,long> > h(n);
+#pragma omp parallel for schedule(static)
+	for(long i=0;i<n;i++){
+		const int* b = &(bin[(long)rows[i]*D]);
+		unsigned long long z = 0x9E3779B97F4A7C15ULL;
+		for(int j=0;j<D;j++){
+			z ^= (unsigned long long)(unsigned int)b[j] + 0x632BE59BD9B4E019ULL + (z << 6) + (z >> 2);
+			z *= 0xBF58476D1CE4E5B9ULL;
+		}
+		if( labs ){
+			double y = (*labs)[rows[i]];
+			unsigned long long yb;
+			memcpy(&yb, &y, sizeof(yb));
+			z = (z ^ yb) * 0x94D049BB133111EBULL;
+		}
+		h[i] = make_pair(z, i);
+	}
+	sort(h.begin(), h.end());
+
+	//split each run of equal hashes by the full signature
+	vector<long> first(n); //first row with the same signature
+	for(long a=0;a<n;){
+		long e = a+1;
+		while( e < n && h[e].first == h[a].first )
+			e++;
+		for(long k=a;k<e;k++){
+			long i = h[k].second;
+			first[i] = i;
+			for(long l=a;l<k;l++){
+				long i2 = h[l].second;
+				if( first[i2] == i2 && memcmp(&(bin[(long)rows[i]*D]), &(bin[(long)rows[i2]*D]), D*sizeof(int)) == 0 &&
+					( labs == NULL || (*labs)[rows[i]] == (*labs)[rows[i2]] ) ){
+					first[i] = i2;
+					break;
+				}
+			}
+		}
+		a = e;
+	}
+
+	//number the groups in the order of their first rows
+	group.assign(n, -1);
+	count.clear();
+	for(long i=0;i<n;i++){
+		long f = first[i];
+		if( f == i ){
+			group[i] = count.size();
+			count.push_back(0);
+		}else{
+			group[i] = group[f];
+		}
+		count[group[i]]++;
+	}
+	return count.size();
+}
+
+#endif
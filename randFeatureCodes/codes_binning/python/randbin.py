@@ -0,0 +1,190 @@
+#!/usr/bin/env python
+
+# Python interface of random binning and of the solvers on CSR matrices,
+# through ctypes, on the shared library librandbin.so (make capi in the
+# parent directory; see randbin_capi.cpp). The indptr/indices/data of a
+# scipy.sparse.csr_matrix and the numpy arrays of the labels and of the
+# outputs are passed as pointers to their buffers: there is no loop
+# over the rows in Python, and no copy if they already have the types
+# of the C interface (indices int32, data and labels float64; indptr is
+# converted to int64, n+1 entries). ctypes releases the GIL during the
+# calls, so that the OpenMP loops run fully.
+#
+# The liblinear models are the model structures of liblinear.py
+# (liblinear-2.01/python), which needs liblinear.so.3 (make lib there).
+#
+# Example:
+#
+#   rb = RandomBinning(D=128, gamma=1.0)
+#   Ztr = rb.fit_transform(Xtr)            # n x D bin indices
+#   m = train_bins(Ztr, ytr, rb.nbins, '-s 2 -c 1 -q')
+#   labels, dec = predict_bins(m, rb.transform(Xte))
+
+from ctypes import *
+from os import path
+import sys
+
+import numpy as np
+import scipy.sparse as sp
+
+dirname = path.dirname(path.abspath(__file__))
+sys.path.append(path.join(dirname, '../../liblinear-2.01/python'))
+from liblinear import parameter, model, toPyModel
+
+__all__ = ['librandbin', 'RandomBinning', 'train_bins', 'predict_bins',
+           'rcd_bins', 'train_csr', 'predict_csr', 'set_num_threads']
+
+librandbin = CDLL(path.join(dirname, '../librandbin.so'))
+
+c_double_p = POINTER(c_double)
+c_int_p = POINTER(c_int)
+c_long_p = POINTER(c_long)
+
+def fillprototype(f, restype, argtypes):
+	f.restype = restype
+	f.argtypes = argtypes
+
+fillprototype(librandbin.rb_set_num_threads, None, [c_int])
+fillprototype(librandbin.rb_fit_csr, c_void_p, [c_long, c_int, c_long_p, c_int_p, c_double_p, c_int, c_double, c_int, c_int_p, c_int_p])
+fillprototype(librandbin.rb_transform_csr, None, [c_void_p, c_long, c_long_p, c_int_p, c_double_p, c_int_p])
+fillprototype(librandbin.rb_grids_nbins, c_int, [c_void_p])
+fillprototype(librandbin.rb_grids_D, c_int, [c_void_p])
+fillprototype(librandbin.rb_free_grids, None, [c_void_p])
+fillprototype(librandbin.rb_save_model, c_int, [c_char_p, c_void_p, POINTER(model)])
+fillprototype(librandbin.rb_save_rcd_model, c_int, [c_char_p, c_void_p, c_double_p, c_int])
+fillprototype(librandbin.rb_train_bins, POINTER(model), [c_int_p, c_long, c_int, c_int, c_double_p, POINTER(parameter)])
+fillprototype(librandbin.rb_predict_bins, None, [POINTER(model), c_int_p, c_long, c_int, c_double_p, c_double_p])
+fillprototype(librandbin.csr_train, POINTER(model), [c_long, c_int, c_long_p, c_int_p, c_double_p, c_double_p, c_double, POINTER(parameter)])
+fillprototype(librandbin.csr_predict, None, [POINTER(model), c_long, c_long_p, c_int_p, c_double_p, c_double_p, c_double_p])
+fillprototype(librandbin.rb_rcd_bins, None, [c_int_p, c_long, c_int, c_int, c_double_p, c_int, c_double, c_int, c_int, c_double_p, c_int, c_int])
+fillprototype(librandbin.set_prInt_string_function, None, [CFUNCTYPE(None, c_char_p)])
+
+def ptr(a, ctype):
+	return a.ctypes.data_as(POINTER(ctype))
+
+def as_array(a, dtype):
+	"""a as a C-contiguous array of dtype, without a copy if it is one"""
+	return np.ascontiguousarray(a, dtype=dtype)
+
+def csr_buffers(X):
+	"""(n, ncol, indptr, indices, data) of X as a CSR matrix with sorted indices"""
+	if not sp.isspmatrix_csr(X):
+		X = sp.csr_matrix(X)
+	if not X.has_sorted_indices:
+		X = X.sorted_indices()
+	return (X.shape[0], X.shape[1], as_array(X.indptr, np.int64),
+		as_array(X.indices, np.int32), as_array(X.data, np.float64))
+
+def set_num_threads(nr_threads):
+	librandbin.rb_set_num_threads(nr_threads)
+
+class RandomBinning(object):
+	"""
+	Random binning with D grids of widths ~ Gamma(2, 1/gamma), as in
+	randFeature_pipe. fit_transform draws the grids with the seed and
+	bins the rows; transform bins new rows with the same grids, the bins
+	not seen in fit_transform get 0. The rows are returned as an n x D
+	int32 array of 1-based feature indices (0: no feature), every
+	feature with the value 1/sqrt(D).
+	"""
+	def __init__(self, D, gamma, seed=0):
+		self.D = D
+		self.gamma = gamma
+		self.seed = seed
+		self.grids = None
+
+	def __del__(self):
+		if self.grids:
+			librandbin.rb_free_grids(self.grids)
+			self.grids = None
+
+	@property
+	def nbins(self):
+		return librandbin.rb_grids_nbins(self.grids)
+
+	def fit_transform(self, X):
+		n, ncol, indptr, indices, data = csr_buffers(X)
+		bins = np.empty((n, self.D), dtype=np.int32)
+		nbins = c_int()
+		if self.grids:
+			librandbin.rb_free_grids(self.grids)
+		self.grids = librandbin.rb_fit_csr(n, ncol, ptr(indptr, c_long), ptr(indices, c_int),
+			ptr(data, c_double), self.D, self.gamma, self.seed, ptr(bins, c_int), byref(nbins))
+		return bins
+
+	def transform(self, X):
+		if not self.grids:
+			raise ValueError("RandomBinning not fitted")
+		n, ncol, indptr, indices, data = csr_buffers(X)
+		bins = np.empty((n, self.D), dtype=np.int32)
+		librandbin.rb_transform_csr(self.grids, n, ptr(indptr, c_long), ptr(indices, c_int),
+			ptr(data, c_double), ptr(bins, c_int))
+		return bins
+
+	def save_model(self, model_file_name, m):
+		"""save the grids and a model of train_bins as a random binning model file (rbmodel.h)"""
+		if librandbin.rb_save_model(model_file_name.encode(), self.grids, m) != 0:
+			raise IOError("can't save model to file " + model_file_name)
+
+	def save_rcd_model(self, model_file_name, w, loss=0):
+		"""same for the weights of rcd_bins"""
+		w = as_array(w, np.float64)
+		if librandbin.rb_save_rcd_model(model_file_name.encode(), self.grids, ptr(w, c_double), loss) != 0:
+			raise IOError("can't save model to file " + model_file_name)
+
+def nr_decision_values(m):
+	return 1 if m.nr_class == 2 and m.param.solver_type != 4 else m.nr_class
+
+def parse_param(options):
+	param = parameter(options)
+	librandbin.set_prInt_string_function(param.print_func)
+	return param
+
+def train_bins(bins, y, nbins, options=''):
+	"""liblinear model trained on the rows binned by RandomBinning; options as in liblinear train"""
+	bins = as_array(bins, np.int32)
+	y = as_array(y, np.float64)
+	param = parse_param(options)
+	m = librandbin.rb_train_bins(ptr(bins, c_int), bins.shape[0], bins.shape[1], nbins, ptr(y, c_double), param)
+	return toPyModel(m)
+
+def predict_bins(m, bins):
+	"""(labels, decision values) of the binned rows"""
+	bins = as_array(bins, np.int32)
+	n = bins.shape[0]
+	labels = np.empty(n)
+	dec = np.empty((n, nr_decision_values(m)))
+	librandbin.rb_predict_bins(m, ptr(bins, c_int), n, bins.shape[1], ptr(dec, c_double), ptr(labels, c_double))
+	return labels, dec
+
+def rcd_bins(bins, y, nbins, loss=0, lam=1.0, n_iter=10, nr_threads=1, w=None, verbose=False):
+	"""
+	weights (nbins+1, w[0] unused) of parallel RCD on the binned rows,
+	loss 0: square, 1: L2-hinge, 2: logistic, L1 regularization lam;
+	warm-started from w if given; the progress is printed if verbose
+	"""
+	bins = as_array(bins, np.int32)
+	y = as_array(y, np.float64)
+	warm_start = w is not None
+	w = np.array(w, dtype=np.float64) if warm_start else np.zeros(nbins+1)
+	librandbin.rb_rcd_bins(ptr(bins, c_int), bins.shape[0], bins.shape[1], nbins, ptr(y, c_double),
+		loss, lam, nr_threads, n_iter, ptr(w, c_double), int(warm_start), int(verbose))
+	return w
+
+def train_csr(X, y, options=''):
+	"""liblinear model trained on the rows of a CSR matrix; options as in liblinear train, including -B"""
+	n, ncol, indptr, indices, data = csr_buffers(X)
+	y = as_array(y, np.float64)
+	param = parse_param(options)
+	m = librandbin.csr_train(n, ncol, ptr(indptr, c_long), ptr(indices, c_int), ptr(data, c_double),
+		ptr(y, c_double), param.bias, param)
+	return toPyModel(m)
+
+def predict_csr(m, X):
+	"""(labels, decision values) of the rows of a CSR matrix"""
+	n, ncol, indptr, indices, data = csr_buffers(X)
+	labels = np.empty(n)
+	dec = np.empty((n, nr_decision_values(m)))
+	librandbin.csr_predict(m, n, ptr(indptr, c_long), ptr(indices, c_int), ptr(data, c_double),
+		ptr(dec, c_double), ptr(labels, c_double))
+	return labels, dec
@@ -0,0 +1,141 @@
+//Load generator for randFeature_serve. Each client opens a connection
+//to the server socket and sends the rows of a LibSVM file one at a
+//time (client c starts at row c), waiting for each prediction before
+//sending the next row. The client-side latency percentiles and the
+//throughput of the completed requests are reported, followed by the
+//counters of the server.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+int connect_socket(const char* path){
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path)-1);
+	if( fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ){
+		cerr << "can't connect to socket " << path << ": " << strerror(errno) << endl;
+		exit(1);
+	}
+	return fd;
+}
+
+//send a line and read the one-line response
+bool request(int fd, FILE* fin, const string& line, string& resp){
+
+	const char* buf = line.c_str();
+	size_t n = line.size();
+	while( n > 0 ){
+		ssize_t k = write(fd, buf, n);
+		if( k < 0 && errno == EINTR )
+			continue;
+		if( k <= 0 )
+			return false;
+		buf += k;
+		n -= k;
+	}
+	char out[512];
+	if( fgets(out, sizeof(out), fin) == NULL )
+		return false;
+	resp = out;
+	return true;
+}
+
+//lat gets the latency of each completed request
+void client(const char* path, vector<string>* rows, int c, long num_req, vector<double>* lat){
+
+	int fd = connect_socket(path);
+	FILE* fin = fdopen(fd, "r");
+	string resp;
+	for(long r=0;r<num_req;r++){
+		const string& line = (*rows)[(c+r) % rows->size()];
+		Clock::time_point t0 = Clock::now();
+		if( !request(fd, fin, line, resp) ){
+			cerr << "client " << c << ": connection closed" << endl;
+			break;
+		}
+		lat->push_back(chrono::duration<double, micro>(Clock::now() - t0).count());
+	}
+	fclose(fin);
+}
+
+int main(int argc, char* argv[]){
+
+	if(argc < 1+4){
+		cerr << "Usage: " << argv[0] << " [socket] [data] [num_clients] [requests_per_client]" << endl;
+		exit(0);
+	}
+
+	char* path = argv[1];
+	char* dataFile = argv[2];
+	int num_clients = atoi(argv[3]);
+	long num_req = atol(argv[4]);
+	if( num_clients < 1 || num_req < 1 ){
+		cerr << "num_clients and requests_per_client must be positive" << endl;
+		exit(1);
+	}
+
+	vector<string> rows;
+	ifstream fs(dataFile);
+	string line;
+	while( getline(fs, line) ){
+		if( line.length() > 0 )
+			rows.push_back(line + "\n");
+	}
+	if( rows.empty() ){
+		cerr << "no rows in " << dataFile << endl;
+		exit(1);
+	}
+
+	vector< vector<double> > lat(num_clients);
+	for(int c=0;c<num_clients;c++)
+		lat[c].reserve(num_req);
+	vector<thread> clients;
+	Clock::time_point t0 = Clock::now();
+	for(int c=0;c<num_clients;c++)
+		clients.push_back(thread(client, path, &rows, c, num_req, &(lat[c])));
+	for(int c=0;c<num_clients;c++)
+		clients[c].join();
+	double elapsed = chrono::duration<double>(Clock::now() - t0).count();
+
+	vector<double> all;
+	for(int c=0;c<num_clients;c++)
+		all.insert(all.end(), lat[c].begin(), lat[c].end());
+	sort(all.begin(), all.end());
+	long n = all.size();
+	if( n == 0 ){
+		cerr << "no request completed" << endl;
+		exit(1);
+	}
+	cout << "clients=" << num_clients << " requests=" << n
+		<< " p50_us=" << all[n/2] << " p99_us=" << all[(n*99)/100]
+		<< " max_us=" << all[n-1] << " throughput=" << n/elapsed << "/s" << endl;
+
+	int fd = connect_socket(path);
+	FILE* fin = fdopen(fd, "r");
+	string resp;
+	if( request(fd, fin, "stats\n", resp) )
+		cout << "server: " << resp;
+	fclose(fin);
+
+	return 0;
+}
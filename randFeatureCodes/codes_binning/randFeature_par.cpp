@@ -3,8 +3,7 @@
 #include <cfloat>
 
 #include "Gaussian.h"
-#include "Gamma.h"
-#include "util.h"
+#include "binning.h"
 
 #include <string>
 #include <iostream>
@@ -18,64 +17,6 @@
 
 using namespace std;
 
-const double NONE_LABEL = -19191.0;
-
-void readSVMfile(const char* f, int& d, vector< vector< pair<int,double> > >& ins, vector<double>& labs){
-
-	d = 0;
-
-	fstream fs;
-	fs.open(f, fstream::in);
-
-	if(fs.fail()){
-		cerr << "error reading file." << endl;
-		return;
-	}
-
-	double label;
-	int index;
-	char colon;
-	double feature;
-	string line, token;
-
-	while(getline(fs, line)){
-
-		if( line.length() < 1 ){
-
-			labs.push_back(NONE_LABEL);
-			ins.push_back(vector< pair<int,double> >());
-			continue;
-		}
-
-		ins.push_back(vector< pair<int,double> >());
-
-		stringstream ss;
-		ss << line;
-		ss >> label;
-
-		labs.push_back(label);
-
-		while(getline(ss, token, ' ')){
-
-			if(token.size() == 0){
-				continue;
-			}
-
-			stringstream ss2;
-
-			ss2 << token;
-			ss2 >> index >> colon >> feature;
-
-			ins.back().push_back(pair<int,double>(index, feature));
-			if(index > d){
-				d = index;
-			}
-		}
-	}
-
-	fs.close();
-}
-
 void writeSVMfile(const char* f, vector< vector< pair<int,double> > >& ins, vector<double>& labs){
 
 	fstream fs;
@@ -103,29 +44,6 @@ void writeSVMfile(const char* f, vector< vector< pair<int,double> > >& ins, vect
 	fs.close();
 }
 
-vector<int>* compute_bin_num( vector<pair<int,double> >* ins, double* delta, double* u, int d ){
-
-	vector<int>* code = new vector<int>();
-	code->resize(d);
-
-	int j=0;
-	for(vector<pair<int,double> >::iterator it=ins->begin(); it!=ins->end(); it++){
-		while( j < it->first ){
-			(*code)[j] = floor((0.0-u[j])/delta[j]) ;
-			j++;
-		}
-
-		(*code)[j] = floor( (it->second-u[j])/delta[j] ) ;
-		j++;
-	}
-	while( j < d ){
-		(*code)[j] = floor((0.0-u[j])/delta[j]) ;
-		j++;
-	}
-
-	return code;
-}
-
 void random_binning_feature(int d, int D, vector< vector< pair<int,double> > >& ins_old, vector< vector< pair<int,double> > >& ins_new, double gamma ){
 
 	double** delta = new double*[D];
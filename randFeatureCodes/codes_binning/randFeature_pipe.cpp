@@ -0,0 +1,618 @@
+//Single-process pipeline: the random binning features of the train and
+//test data are generated in memory (see random_binning_index in
+//binning.h) and handed directly to a solver, instead of being written
+//as LibSVM text by randFeature_par and parsed again by the solver.
+//Only the model (optional) and the metrics are written. The solver
+//model, together with the grids and the bin dictionaries, can also be
+//written as a random binning model file (see rbmodel.h) that is
+//served by randFeature_serve.
+//
+//Incremental update: given the model file and the binned training rows
+//(rbBinsOut) of a previous run as rbModelIn and rbBinsIn, inTrain holds
+//only the new training rows. They are binned against the existing
+//grids; bins not seen before are appended as new features. The solver
+//is warm-started from the previous weights, padded with zeros for the
+//new features (RCD; liblinear solvers 0 and 2, which accept an initial
+//solution), so that few iterations are needed. The old rows are not
+//binned again.
+//
+//With RCD_dedup=1, the RCD problem is compressed: training rows that
+//fall in the same bin in every grid are merged into one weighted row
+//(see group_bin_rows), which at small gamma can shrink it by orders of
+//magnitude. liblinear has no instance weights, so dedup applies to RCD
+//only.
+//
+//With RCD_early_stop=k > 0, the last 10% of the training rows are held
+//out, and every k iterations RCD computes the mean loss of their
+//predictions; it stops when that has not decreased for 2 checks and
+//keeps the weights of the smallest (see RcdValidation in rcd.h).
+//
+//Scaling: with scale = "lower,upper" (or "lower,upper,y_lower,y_upper"),
+//the features are scaled as by libsvm's svm-scale (see scale.h), with
+//the range of the training rows, right after they are parsed and
+//before they are binned; no scaled copy of the data is written. The
+//range is saved to rangeOut (binary), and rangeIn restores one instead
+//(e.g., the range of the run that wrote rbModelIn).
+//
+//Checkpoints: with ckpt, the state of RCD is written to the file ckpt
+//every ckptEvery seconds (default 600) by a background thread (see
+//RcdCheckpoint in checkpoint.h), and a run with the same arguments,
+//e.g., after a preemption, resumes from it. The first run also caches
+//the binned train and test rows and the grids in ckpt.tr, ckpt.te and
+//ckpt.rbm (see save_bins_cache); when the cache exists, the data are
+//neither read, scaled nor binned again. A checkpoint belongs to one
+//set of arguments: only D and the problem size are checked. liblinear
+//has no checkpoints but uses the cache.
+//
+//Solvers:
+//  0: liblinear train(); the binned rows are stored directly in the
+//     feature_node array of the liblinear problem.
+//  1: parallel RCD rcd(); the binned columns are stored directly in
+//     the Feature lists used by rcd.
+//For kernel ridge regression solved by PCG, use KRR_OneVsAll_RandBin
+//in codes_KRR_randbin, which also bins in memory.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <cfloat>
+
+#include "binning.h"
+#include "scale.h"
+#include "../liblinear-2.01/linear.h"
+#include "../../parallel_RCD/rcd.h"
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <utility>
+#include <vector>
+#include <cmath>
+
+#include <omp.h>
+
+using namespace std;
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type))
+
+void print_null(const char *s) {}
+
+//default stopping tolerance of liblinear train, see train.c
+double default_eps(int solver_type){
+
+	switch(solver_type){
+		case L2R_LR:
+		case L2R_L2LOSS_SVC:
+		case L1R_L2LOSS_SVC:
+		case L1R_LR:
+			return 0.01;
+		case L2R_L2LOSS_SVR:
+			return 0.001;
+		default:
+			return 0.1;
+	}
+}
+
+//build the liblinear problem of the rows in rows[] directly from the bin indices
+void bins_to_problem(vector<int>& bin, int D, int nbins, vector<int>& rows, vector<double>& labs, struct problem& prob, struct feature_node*& x_space){
+
+	long l = rows.size();
+	double scale = sqrt(1.0/D);
+
+	prob.l = l;
+	prob.n = nbins;
+	prob.bias = -1;
+	prob.y = Malloc(double, l);
+	prob.x = Malloc(struct feature_node*, l);
+	x_space = Malloc(struct feature_node, l*(D+1));
+
+#pragma omp parallel for schedule(static)
+	for(long i=0;i<l;i++){
+		int* bin_i = &(bin[(long)rows[i]*D]);
+		struct feature_node* x = &(x_space[i*(D+1)]);
+		for(int j=0;j<D;j++){
+			x[j].index = bin_i[j];
+			x[j].value = scale;
+		}
+		x[D].index = -1;
+		if( bin_i[0] == 0 ) //empty row
+			x[0].index = -1;
+		prob.x[i] = x;
+		prob.y[i] = labs[rows[i]];
+	}
+}
+
+//build the rcd feature columns of the rows in rows[] directly from the
+//bin indices. The bins of a grid are disjoint from those of the other
+//grids, so each column is filled by one thread, in the order of the rows.
+void bins_to_features(vector<int>& bin, int D, int nbins, vector<int>& rows, vector<Feature*>& features){
+
+	long l = rows.size();
+	double scale = sqrt(1.0/D);
+
+	features.resize(nbins+1);
+	for(int k=0;k<=nbins;k++){
+		features[k] = new Feature();
+		features[k]->id = k;
+	}
+
+#pragma omp parallel for schedule(dynamic)
+	for(int j=0;j<D;j++){
+		for(long i=0;i<l;i++){
+			int k = bin[(long)rows[i]*D+j];
+			if( k == 0 ) //empty row
+				continue;
+			features[k]->values.push_back(make_pair((int)i, scale));
+		}
+	}
+}
+
+//labels in the order in which liblinear train() numbers the classes (see group_classes in linear.cpp)
+void liblinear_labels(struct problem& prob, vector<double>& labels){
+
+	labels.clear();
+	for(long i=0;i<prob.l;i++){
+		int this_label = (int)prob.y[i];
+		if( find(labels.begin(), labels.end(), (double)this_label) == labels.end() )
+			labels.push_back(this_label);
+	}
+	if( labels.size() == 2 && labels[0] == -1 && labels[1] == 1 )
+		swap(labels[0], labels[1]);
+}
+
+//write the labels and the bins of the rows in rows[] as a binned set
+//file (see save_rb_bins). Returns 0 on success.
+int save_rows_bins(const char* f, vector<int>& rows, vector<double>& labs, int D, vector<int>& bin){
+
+	long l = rows.size();
+	vector<double> y(l);
+	vector<int> bin_rows(l*D);
+	for(long i=0;i<l;i++){
+		y[i] = labs[rows[i]];
+		memcpy(&(bin_rows[i*D]), &(bin[(long)rows[i]*D]), D*sizeof(int));
+	}
+	return save_rb_bins(f, l, D, l > 0 ? &(y[0]) : NULL, l > 0 ? &(bin_rows[0]) : NULL);
+}
+
+//cache of the binned rows next to the checkpoint file ckpt: the train
+//rows in ckpt.tr, the test rows in ckpt.te, and the grids in ckpt.rbm
+//(a model file with zero weights). Returns 0 on success.
+int save_bins_cache(const char* ckpt, int D, vector<int>& train_rows, vector<int>& test_rows, vector<double>& labs, vector<int>& bin, binning_grids& grids){
+
+	string f(ckpt);
+	vector<double> w(grids.ids.size()+1, 0.0);
+	double labels[2] = {1.0, -1.0};
+	if( save_rows_bins((f+".tr").c_str(), train_rows, labs, D, bin) ||
+		save_rows_bins((f+".te").c_str(), test_rows, labs, D, bin) )
+		return -1;
+	//last, so that the cache is used only if complete
+	return save_rb_model((f+".rbm").c_str(), grids, 1, &(w[0]), RB_BINARY, 2, labels);
+}
+
+//read the cache written by save_bins_cache: the train rows followed by
+//the test rows in labs and bin, the number of train rows in Ntr.
+//Returns 0 on success, and leaves the arguments unchanged otherwise.
+int load_bins_cache(const char* ckpt, int D, vector<double>& labs, vector<int>& bin, int& Ntr, binning_grids& grids){
+
+	string f(ckpt);
+	rb_model m;
+	if( load_rb_model((f+".rbm").c_str(), m) )
+		return -1;
+	bool ok = m.h.D == D;
+	vector<double> labs_c;
+	vector<int> bin_c;
+	ok = ok && load_rb_bins((f+".tr").c_str(), D, labs_c, bin_c) == 0;
+	int ntr = labs_c.size();
+	ok = ok && load_rb_bins((f+".te").c_str(), D, labs_c, bin_c) == 0;
+	if( ok ){
+		rb_model_to_grids(m, grids);
+		labs.swap(labs_c);
+		bin.swap(bin_c);
+		Ntr = ntr;
+	}
+	free_rb_model(m);
+	return ok ? 0 : -1;
+}
+
+//mean loss of the binned rows val_rows with the RCD weights w
+class BinValidation: public RcdValidation{
+	public:
+	BinValidation(int every_, int patience_, vector<int>& bin_, int D_, vector<int>& val_rows_, vector<double>& labs_, LossFunc* loss_):
+		RcdValidation(every_, patience_), bin(bin_), D(D_), val_rows(val_rows_), labs(labs_), loss(loss_){}
+
+	double error(const double* w){
+		double scale = sqrt(1.0/D), sum = 0.0;
+		long l = val_rows.size();
+#pragma omp parallel for schedule(static) reduction(+:sum)
+		for(long i=0;i<l;i++){
+			int* bin_i = &(bin[(long)val_rows[i]*D]);
+			double prod = 0.0;
+			for(int j=0;j<D;j++)
+				prod += w[bin_i[j]] * scale;
+			sum += loss->fval(prod, labs[val_rows[i]]);
+		}
+		return l > 0 ? sum/l : 0.0;
+	}
+
+	private:
+	vector<int>& bin;
+	int D;
+	vector<int>& val_rows;
+	vector<double>& labs;
+	LossFunc* loss;
+};
+
+//argv[k], or NULL if absent or "-"
+char* optional_arg(int argc, char* argv[], int k){
+
+	if( argc > k && strcmp(argv[k], "-") != 0 )
+		return argv[k];
+	return NULL;
+}
+
+int main(int argc, char* argv[]){
+
+	if(argc < 1+9){
+		cerr << "Usage: " << argv[0] << " [inTrain] [inTest] [D] [gamma] [solver(0:liblinear,1:RCD)] [C|L1_lambda] [liblinear_type|RCD_loss(0:square,1:L2-hinge,2:logistic)] [num_threads] [RCD_num_iter] (modelOut) (rbModelOut) (rbBinsOut) (rbModelIn) (rbBinsIn) (RCD_dedup) (RCD_early_stop) (scale) (rangeOut) (rangeIn) (ckpt) (ckptEvery)" << endl;
+		exit(0);
+	}
+
+	char* trainFile = argv[1];
+	char* testFile = argv[2];
+	int D = atoi(argv[3]);
+	double gamma = atof(argv[4]);
+	int solver = atoi(argv[5]);
+	double reg = atof(argv[6]);
+	int type = atoi(argv[7]);
+	int nThreads = atoi(argv[8]);
+	int nIter = atoi(argv[9]);
+	char* modelOut = optional_arg(argc, argv, 10);
+	char* rbModelOut = optional_arg(argc, argv, 11);
+	char* rbBinsOut = optional_arg(argc, argv, 12);
+	char* rbModelIn = optional_arg(argc, argv, 13);
+	char* rbBinsIn = optional_arg(argc, argv, 14);
+	bool dedup = argc > 15 && atoi(argv[15]) != 0;
+	int early_stop = argc > 16 ? atoi(argv[16]) : 0;
+	char* scaleSpec = optional_arg(argc, argv, 17);
+	char* rangeOut = optional_arg(argc, argv, 18);
+	char* rangeIn = optional_arg(argc, argv, 19);
+	char* ckpt = optional_arg(argc, argv, 20);
+	double ckpt_every = argc > 21 ? atof(argv[21]) : 600.0;
+	if( (rbModelIn == NULL) != (rbBinsIn == NULL) ){
+		cerr << "rbModelIn and rbBinsIn must be given together" << endl;
+		exit(1);
+	}
+
+	omp_set_num_threads(nThreads);
+
+	//incremental mode: the old training rows come binned from rbBinsIn
+	//and the new rows are binned against the grids of rbModelIn
+	vector<double> labs;
+	vector<int> bin, offset;
+	binning_grids grids;
+	rb_model model_in;
+	if( rbModelIn ){
+		if( load_rb_model(rbModelIn, model_in) ){
+			cerr << "can't load model from file " << rbModelIn << endl;
+			exit(1);
+		}
+		rb_model_to_grids(model_in, grids);
+		if( D != grids.D )
+			cerr << "D=" << D << " ignored, using D=" << grids.D << " of " << rbModelIn << endl;
+		D = grids.D;
+	}
+
+	//resume: the rows and the grids binned by the first run with ckpt
+	int N_old = 0, Ntr, N, nbins, nbins_old = rbModelIn ? model_in.h.nbins : 0;
+	double start, end;
+	bool cached = ckpt && load_bins_cache(ckpt, D, labs, bin, Ntr, grids) == 0;
+	if( cached ){
+		N = labs.size();
+		nbins = grids.ids.size();
+		cerr << "binned rows from cache " << ckpt << ".{tr,te,rbm}" << endl;
+		cerr << "#train_sample=" << Ntr << endl;
+		cerr << "#test_sample=" << N-Ntr << endl;
+		cerr << "D=" << D << endl;
+		cerr << "max-rf-index=" << nbins << endl;
+	}else{
+		if( rbModelIn && load_rb_bins(rbBinsIn, D, labs, bin) ){
+			cerr << "can't load binned rows from file " << rbBinsIn << endl;
+			exit(1);
+		}
+		N_old = labs.size();
+
+		int dimension, dimension_test;
+		vector< vector< pair<int,double> > > data_old;
+
+		start = omp_get_wtime();
+		readSVMfile(trainFile, dimension, data_old, labs);
+		Ntr = N_old + data_old.size();
+		readSVMfile(testFile, dimension_test, data_old, labs);
+		if( dimension_test > dimension )
+			dimension = dimension_test;
+		dimension += 1;
+		N = N_old + data_old.size();
+		end = omp_get_wtime();
+		cerr << "read time=" << end-start << endl;
+
+		if( scaleSpec || rangeIn ){
+			start = omp_get_wtime();
+			rb_scaling scaling;
+			if( rangeIn ){
+				if( load_scaling(rangeIn, scaling) ){
+					cerr << "can't load range from file " << rangeIn << endl;
+					exit(1);
+				}
+			}else{
+				if( !scaling_parse(scaleSpec, scaling) ){
+					cerr << "inconsistent lower/upper specification " << scaleSpec << endl;
+					exit(1);
+				}
+				scaling_update(scaling, data_old.data(), labs.data()+N_old, Ntr-N_old, NONE_LABEL);
+				if( !scaling_finish(scaling) ){
+					cerr << "no training rows to compute the range from" << endl;
+					exit(1);
+				}
+			}
+			if( rangeOut && save_scaling(rangeOut, scaling) )
+				cerr << "can't save range to file " << rangeOut << endl;
+			scale_rows(scaling, data_old.data(), labs.data()+N_old, N-N_old, NONE_LABEL);
+			end = omp_get_wtime();
+			cerr << "scale time=" << end-start << endl;
+		}
+
+		cerr << "#train_sample=" << Ntr << endl;
+		if( rbModelIn )
+			cerr << "#previous_train_sample=" << N_old << endl;
+		cerr << "#test_sample=" << N-Ntr << endl;
+		cerr << "dim=" << (rbModelIn ? grids.d : dimension) << endl;
+		cerr << "D=" << D << endl;
+
+		start = omp_get_wtime();
+		if( rbModelIn ){
+			vector<int> bin_new;
+			nbins = extend_binning_index(grids, data_old, bin_new);
+			bin.insert(bin.end(), bin_new.begin(), bin_new.end());
+		}else{
+			nbins = random_binning_index(dimension, D, data_old, gamma, bin, offset, (rbModelOut || ckpt) ? &grids : NULL);
+		}
+		end = omp_get_wtime();
+		cerr << "gen time=" << end-start << endl;
+		cerr << "max-rf-index=" << nbins << endl;
+		if( rbModelIn )
+			cerr << "#new_bins=" << nbins-nbins_old << endl;
+	}
+
+	//skip the empty lines
+	vector<int> train_rows, test_rows;
+	for(int i=0;i<N;i++){
+		if( labs[i] == NONE_LABEL )
+			continue;
+		if( i < Ntr )
+			train_rows.push_back(i);
+		else
+			test_rows.push_back(i);
+	}
+	long Nte = test_rows.size();
+	double scale = sqrt(1.0/D);
+
+	if( rbBinsOut && save_rows_bins(rbBinsOut, train_rows, labs, D, bin) )
+		cerr << "can't save binned rows to file " << rbBinsOut << endl;
+	if( ckpt && !cached && save_bins_cache(ckpt, D, train_rows, test_rows, labs, bin, grids) )
+		cerr << "can't save binned rows to cache " << ckpt << ".{tr,te,rbm}" << endl;
+
+	if( solver == 0 ){
+
+		struct problem prob;
+		struct feature_node* x_space;
+		bins_to_problem(bin, D, nbins, train_rows, labs, prob, x_space);
+
+		struct parameter param;
+		param.solver_type = type;
+		param.C = reg;
+		param.eps = default_eps(type);
+		param.p = 0.1;
+		param.nr_weight = 0;
+		param.weight_label = NULL;
+		param.weight = NULL;
+		param.init_sol = NULL;
+		set_prInt_string_function(print_null);
+
+		//warm start from the previous weights, padded with zeros for the
+		//new bins, if the solver supports it and the classes are unchanged
+		if( rbModelIn && (type == L2R_LR || type == L2R_L2LOSS_SVC) ){
+			vector<double> labels_new;
+			liblinear_labels(prob, labels_new);
+			int nr_w = labels_new.size()==2 ? 1 : labels_new.size();
+			if( nr_w == model_in.h.nr_w && (int)labels_new.size() == model_in.h.nr_label &&
+				equal(labels_new.begin(), labels_new.end(), model_in.labels) ){
+				param.init_sol = Malloc(double, (long)nbins*nr_w);
+				memcpy(param.init_sol, model_in.w + nr_w, (long)nbins_old*nr_w*sizeof(double));
+				memset(param.init_sol + (long)nbins_old*nr_w, 0, (long)(nbins-nbins_old)*nr_w*sizeof(double));
+				cerr << "warm start from " << rbModelIn << endl;
+			}else{
+				cerr << "classes changed, cold start" << endl;
+			}
+		}
+
+		const char* error_msg = check_parameter(&prob, &param);
+		if( error_msg ){
+			cerr << "ERROR: " << error_msg << endl;
+			exit(1);
+		}
+
+		start = omp_get_wtime();
+		struct model* model_ = train(&prob, &param);
+		end = omp_get_wtime();
+		cerr << "train time=" << end-start << endl;
+
+		if( param.init_sol ){
+			free(param.init_sol);
+			param.init_sol = NULL;
+		}
+
+		if( modelOut && save_model(modelOut, model_) ){
+			cerr << "can't save model to file " << modelOut << endl;
+		}
+		if( rbModelOut ){
+			int nr_class = model_->nr_class;
+			int nr_w = (nr_class==2 && type != MCSVM_CS) ? 1 : nr_class;
+			vector<double> W((long)(nbins+1)*nr_w, 0.0);
+			memcpy(&(W[nr_w]), model_->w, (long)model_->nr_feature*nr_w*sizeof(double));
+			vector<double> labels(nr_class);
+			for(int k=0;k<nr_class;k++)
+				labels[k] = model_->label[k];
+			int rb_type = check_regression_model(model_) ? RB_REGRESSION : (nr_w==1 ? RB_BINARY : RB_MULTICLASS);
+			if( save_rb_model(rbModelOut, grids, nr_w, &(W[0]), rb_type, nr_class, &(labels[0])) )
+				cerr << "can't save model to file " << rbModelOut << endl;
+		}
+
+		//predict the test rows, building their feature_node arrays on the fly
+		start = omp_get_wtime();
+		bool regression = check_regression_model(model_);
+		double correct = 0.0, sqerr = 0.0;
+#pragma omp parallel reduction(+:correct,sqerr)
+		{
+			vector<struct feature_node> x(D+1);
+			x[D].index = -1;
+#pragma omp for schedule(static)
+			for(long i=0;i<Nte;i++){
+				int* bin_i = &(bin[(long)test_rows[i]*D]);
+				for(int j=0;j<D;j++){
+					x[j].index = bin_i[j];
+					x[j].value = scale;
+				}
+				x[0].index = bin_i[0] == 0 ? -1 : bin_i[0]; //empty row
+				double y = labs[test_rows[i]];
+				double predict_label = predict(model_, &(x[0]));
+				if( predict_label == y )
+					correct += 1.0;
+				sqerr += (predict_label-y)*(predict_label-y);
+			}
+		}
+		end = omp_get_wtime();
+		cerr << "test time=" << end-start << endl;
+
+		if( regression )
+			cout << "test mse = " << sqerr/Nte << endl;
+		else
+			cout << "test acc = " << correct/Nte << endl;
+
+		free_and_destroy_model(&model_);
+		free(prob.y);
+		free(prob.x);
+		free(x_space);
+
+	}else{
+
+		//with dedup, the rows with the same bins (and, except for the
+		//square loss, the same label) are merged into one row weighted
+		//by their number; for the square loss its label is the mean,
+		//which changes the objective by a constant only
+		vector<int> rows_rcd, val_rows;
+		vector<double> labels, inst_w;
+		if( early_stop > 0 ){
+			long l = train_rows.size() - train_rows.size()/10;
+			val_rows.assign(train_rows.begin()+l, train_rows.end());
+			train_rows.resize(l);
+			cerr << "#validation_rows=" << val_rows.size() << endl;
+		}
+		if( dedup ){
+			vector<int> group, count;
+			int ngroups = group_bin_rows(bin, D, train_rows, type==0 ? NULL : &labs, group, count);
+			rows_rcd.assign(ngroups, -1);
+			labels.assign(ngroups, 0.0);
+			inst_w.assign(count.begin(), count.end());
+			for(long i=0;i<train_rows.size();i++){
+				if( rows_rcd[group[i]] < 0 )
+					rows_rcd[group[i]] = train_rows[i];
+				labels[group[i]] += labs[train_rows[i]]/count[group[i]];
+			}
+			cerr << "#distinct_train_rows=" << ngroups << endl;
+		}else{
+			rows_rcd = train_rows;
+			labels.resize(train_rows.size());
+			for(long i=0;i<train_rows.size();i++)
+				labels[i] = labs[train_rows[i]];
+		}
+		vector<Feature*> features;
+		bins_to_features(bin, D, nbins, rows_rcd, features);
+
+		LossFunc* loss;
+		if( type==0 )
+			loss = new SquareLoss();
+		else if( type==1 )
+			loss = new L2hingeLoss();
+		else
+			loss = new LogisticLoss();
+
+		int dd = features.size();
+		double* w = new double[dd];
+		cout << "iterations\ttime(s)\tobjective\tnnz"<< endl;
+		cout << "#samples n="  << rows_rcd.size() <<"; #features d=" << dd << endl;
+		start = omp_get_wtime();
+		//warm start from the previous weights, padded with zeros for the new bins
+		double* w_init = NULL;
+		if( rbModelIn && model_in.h.nr_w == 1 ){
+			w_init = new double[dd];
+			memcpy(w_init, model_in.w, (nbins_old+1)*sizeof(double));
+			memset(w_init+nbins_old+1, 0, (dd-nbins_old-1)*sizeof(double));
+			cerr << "warm start from " << rbModelIn << endl;
+		}
+		BinValidation val(early_stop, 2, bin, D, val_rows, labs, loss);
+		RcdCheckpoint* rcd_ckpt = ckpt ? new RcdCheckpoint(ckpt, ckpt_every) : NULL;
+		rcd(features, labels, rows_rcd.size(), loss, reg, w, nThreads, nIter, -1e300, w_init, dedup ? &(inst_w[0]) : NULL, early_stop > 0 ? &val : NULL, rcd_ckpt);
+		delete[] w_init;
+		if( rcd_ckpt ){
+			cerr << "checkpoints written=" << rcd_ckpt->written() << " failed=" << rcd_ckpt->failed() << endl;
+			delete rcd_ckpt;
+		}
+		end = omp_get_wtime();
+		cerr << "train time=" << end-start << endl;
+
+		if( modelOut ){
+			ofstream fout(modelOut);
+			for(int k=0;k<dd;k++)
+				if( w[k] != 0.0 )
+					fout << k << " " << w[k] << endl;
+			fout.close();
+		}
+		if( rbModelOut ){
+			w[0] = 0.0;
+			double labels[2] = {1.0, -1.0};
+			if( save_rb_model(rbModelOut, grids, 1, w, type==0 ? RB_REGRESSION : RB_BINARY, 2, labels) )
+				cerr << "can't save model to file " << rbModelOut << endl;
+		}
+
+		start = omp_get_wtime();
+		double y_sq_sum = 0.0, sqerr = 0.0, err = 0.0;
+#pragma omp parallel for schedule(static) reduction(+:y_sq_sum,sqerr,err)
+		for(long i=0;i<Nte;i++){
+			int* bin_i = &(bin[(long)test_rows[i]*D]);
+			double y = labs[test_rows[i]];
+			double prod = 0.0;
+			for(int j=0;j<D;j++)
+				prod += w[bin_i[j]] * scale;
+			sqerr += (y-prod)*(y-prod);
+			y_sq_sum += y*y;
+			if( prod*y < 0.0 )
+				err += 1.0;
+		}
+		end = omp_get_wtime();
+		cerr << "test time=" << end-start << endl;
+
+		if( type==0 )
+			cout << "test rmse = " << sqrt(sqerr/y_sq_sum) << endl;
+		else
+			cout << "test acc = " << 1.0-err/Nte << endl;
+
+		for(int k=0;k<dd;k++)
+			delete features[k];
+		delete[] w;
+		delete loss;
+	}
+
+	if( rbModelIn )
+		free_rb_model(model_in);
+
+	return 0;
+}
@@ -0,0 +1,434 @@
+//Scoring daemon for random binning models (see rbmodel.h, written by
+//randFeature_pipe). The model is mapped into memory once. Requests
+//are rows in LibSVM format, one per line (a leading label is optional
+//and ignored); the response to each row is one line holding its
+//prediction. The line "stats" is answered with the latency and
+//throughput counters.
+//
+//Concurrent requests are coalesced into micro-batches: a batch is
+//scored as soon as it holds max_batch rows, or max_wait_us
+//microseconds after its first row arrived. A batch is binned grid by
+//grid with OpenMP (see rb_predict_batch).
+//
+//With socket "-", rows are read from stdin and the predictions are
+//written to stdout, in batches of max_batch rows; the counters are
+//written to stderr at the end.
+//
+//weights selects the weights used for scoring: exact (the doubles of
+//the model file), or a copy quantized at load time (see rb_quantize):
+//fp16, int8 (one scale per class) or int8g (one scale per grid and
+//class). With quantized weights in stdin mode, every batch is also
+//scored with the exact weights, after the latency is measured, and
+//the agreement of the predictions, the largest error of the decision
+//values and, for the rows with a label, the accuracy (or the mean
+//squared error of a regression model) of both are written to stderr.
+//
+//rangeIn is the range file of a model trained on scaled rows (see
+//scale.h, randFeature_pipe): the rows are scaled with it after they are
+//parsed, as the training rows were.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <string>
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <omp.h>
+
+#include "rbmodel.h"
+#include "scale.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+#define LATENCY_WINDOW 65536
+
+struct request{
+	vector< pair<int,double> > x;
+	double y;
+	bool done;
+	Clock::time_point t0;
+};
+
+rb_model model;
+rb_qweights qweights;
+const rb_qweights* qw = NULL; //NULL: exact weights
+rb_scaling scaling;
+const rb_scaling* sc = NULL; //NULL: rows not scaled
+int max_batch = 64;
+long max_wait_us = 200;
+
+mutex mtx;
+condition_variable cv_req, cv_done;
+deque<request*> queue_req;
+
+//counters, protected by mtx
+Clock::time_point t_start;
+long num_requests = 0, num_batches = 0;
+vector<double> latency(LATENCY_WINDOW); //last completed requests, in microseconds
+
+//parse a row "[label] idx:val idx:val ..." (label NaN if absent);
+//returns false on a format error
+bool parse_row(const char* line, vector< pair<int,double> >& x, double* label = NULL){
+
+	x.clear();
+	if( label )
+		*label = NAN;
+	const char* p = line;
+	while( *p ){
+		while( *p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' )
+			p++;
+		if( *p == 0 )
+			break;
+		const char* q = p;
+		while( *q && *q != ' ' && *q != '\t' && *q != '\n' && *q != '\r' && *q != ':' )
+			q++;
+		char* end;
+		if( *q != ':' ){ //label: a number, before the features
+			double y = strtod(p, &end);
+			if( end != q || p != line + strspn(line, " \t") )
+				return false;
+			if( label )
+				*label = y;
+			p = q;
+			continue;
+		}
+		long idx = strtol(p, &end, 10);
+		if( end != q )
+			return false;
+		double val = strtod(q+1, &end);
+		if( end == q+1 )
+			return false;
+		x.push_back(make_pair((int)idx, val));
+		p = end;
+	}
+	return true;
+}
+
+string stats_string(){
+
+	double elapsed = chrono::duration<double>(Clock::now() - t_start).count();
+	long n = min(num_requests, (long)LATENCY_WINDOW);
+	vector<double> lat(latency.begin(), latency.begin()+n);
+	double p50 = 0.0, p99 = 0.0;
+	if( n > 0 ){
+		nth_element(lat.begin(), lat.begin()+n/2, lat.end());
+		p50 = lat[n/2];
+		nth_element(lat.begin(), lat.begin()+(n*99)/100, lat.end());
+		p99 = lat[(n*99)/100];
+	}
+	char buf[512];
+	sprintf(buf, "requests=%ld batches=%ld avg_batch=%g p50_us=%g p99_us=%g throughput=%g/s",
+		num_requests, num_batches, num_batches ? (double)num_requests/num_batches : 0.0,
+		p50, p99, elapsed > 0 ? num_requests/elapsed : 0.0);
+	return string(buf);
+}
+
+//collect micro-batches from the queue and score them
+void batcher(){
+
+	vector<request*> batch;
+	vector< vector< pair<int,double> >* > x;
+	vector<int> bin;
+	vector<double> out;
+
+	unique_lock<mutex> lk(mtx);
+	while( true ){
+		cv_req.wait(lk, []{ return !queue_req.empty(); });
+		Clock::time_point deadline = queue_req.front()->t0 + chrono::microseconds(max_wait_us);
+		while( (int)queue_req.size() < max_batch ){
+			if( cv_req.wait_until(lk, deadline) == cv_status::timeout )
+				break;
+		}
+
+		int n = min((int)queue_req.size(), max_batch);
+		batch.assign(queue_req.begin(), queue_req.begin()+n);
+		queue_req.erase(queue_req.begin(), queue_req.begin()+n);
+		lk.unlock();
+
+		x.resize(n);
+		for(int i=0;i<n;i++)
+			x[i] = &(batch[i]->x);
+		bin.resize((long)n*model.h.D);
+		out.resize(n);
+		rb_predict_batch(model, &(x[0]), n, &(bin[0]), &(out[0]), qw);
+
+		lk.lock();
+		Clock::time_point t1 = Clock::now();
+		for(int i=0;i<n;i++){
+			batch[i]->y = out[i];
+			batch[i]->done = true;
+			latency[num_requests % LATENCY_WINDOW] = chrono::duration<double, micro>(t1 - batch[i]->t0).count();
+			num_requests++;
+		}
+		num_batches++;
+		cv_done.notify_all();
+	}
+}
+
+bool write_all(int fd, const char* buf, size_t n){
+
+	while( n > 0 ){
+		ssize_t k = write(fd, buf, n);
+		if( k < 0 && errno == EINTR )
+			continue;
+		if( k <= 0 )
+			return false;
+		buf += k;
+		n -= k;
+	}
+	return true;
+}
+
+//scale a parsed row (and its label, if any) with the training range
+void scale_request(vector< pair<int,double> >& x, double* label = NULL){
+
+	if( sc == NULL )
+		return;
+	vector< pair<int,double> > out;
+	scale_row(*sc, x, out);
+	x.swap(out);
+	if( label && !std::isnan(*label) )
+		*label = scale_label(*sc, *label);
+}
+
+void serve_connection(int fd){
+
+	FILE* fin = fdopen(fd, "r");
+	char* line = NULL;
+	size_t cap = 0;
+	char buf[64];
+	request req;
+
+	while( getline(&line, &cap, fin) != -1 ){
+
+		string resp;
+		if( strncmp(line, "stats", 5) == 0 ){
+			lock_guard<mutex> lk(mtx);
+			resp = stats_string() + "\n";
+		}else if( !parse_row(line, req.x) ){
+			resp = "error\n";
+		}else{
+			scale_request(req.x);
+			unique_lock<mutex> lk(mtx);
+			req.done = false;
+			req.t0 = Clock::now();
+			queue_req.push_back(&req);
+			cv_req.notify_one();
+			cv_done.wait(lk, [&req]{ return req.done; });
+			lk.unlock();
+			sprintf(buf, "%.10g\n", req.y);
+			resp = buf;
+		}
+		if( !write_all(fd, resp.c_str(), resp.size()) )
+			break;
+	}
+	free(line);
+	fclose(fin);
+}
+
+//exact vs quantized scores of the rows read in stdin mode
+struct quant_report{
+	long n, agree, n_label, correct, correct_q;
+	double max_err, max_dec, sse, sse_q; //sse: regression models
+};
+
+//compare the quantized predictions out_q of n binned rows with their
+//exact scores
+void compare_exact(const int* bin, int n, const double* label, const double* out_q, quant_report& rep){
+
+	int nr_w = model.h.nr_w;
+	vector<double> dec((long)n*nr_w), dec_q((long)n*nr_w), out(n);
+	rb_score_batch(model, NULL, bin, n, &(dec[0]), &(out[0]));
+	rb_score_batch(model, qw, bin, n, &(dec_q[0]), NULL);
+	bool regression = model.h.type == RB_REGRESSION;
+	for(long t=0;t<(long)n*nr_w;t++){
+		rep.max_err = max(rep.max_err, fabs(dec[t] - dec_q[t]));
+		rep.max_dec = max(rep.max_dec, fabs(dec[t]));
+	}
+	for(int i=0;i<n;i++){
+		rep.n++;
+		rep.agree += out[i] == out_q[i] ? 1 : 0;
+		if( std::isnan(label[i]) )
+			continue;
+		rep.n_label++;
+		if( regression ){
+			rep.sse += (out[i]-label[i])*(out[i]-label[i]);
+			rep.sse_q += (out_q[i]-label[i])*(out_q[i]-label[i]);
+			continue;
+		}
+		rep.correct += out[i] == label[i] ? 1 : 0;
+		rep.correct_q += out_q[i] == label[i] ? 1 : 0;
+	}
+}
+
+//stdin/stdout mode
+void serve_stdin(){
+
+	vector< vector< pair<int,double> > > rows(max_batch);
+	vector< vector< pair<int,double> >* > x(max_batch);
+	vector<int> bin((long)max_batch*model.h.D);
+	vector<double> out(max_batch), label(max_batch);
+	vector<char> ok(max_batch); //lines of the batch that parse
+	for(int i=0;i<max_batch;i++)
+		x[i] = &(rows[i]);
+	quant_report rep;
+	memset(&rep, 0, sizeof(rep));
+
+	char* line = NULL;
+	size_t cap = 0;
+	bool eof = false;
+	while( !eof ){
+		int n = 0, nl = 0; //rows scored, lines read
+		Clock::time_point t0 = Clock::now();
+		while( nl < max_batch ){
+			if( getline(&line, &cap, stdin) == -1 ){
+				eof = true;
+				break;
+			}
+			//a malformed line is answered with "error", as in socket
+			//mode, and left out of the batch and of the statistics
+			ok[nl] = parse_row(line, rows[n], &(label[n]));
+			if( ok[nl] ){
+				scale_request(rows[n], &(label[n]));
+				n++;
+			}
+			nl++;
+		}
+		if( nl == 0 )
+			break;
+		if( n > 0 )
+			rb_predict_batch(model, &(x[0]), n, &(bin[0]), &(out[0]), qw);
+		for(int i=0,k=0;i<nl;i++){
+			if( ok[i] )
+				printf("%.10g\n", out[k++]);
+			else
+				printf("error\n");
+		}
+		if( n == 0 )
+			continue;
+		double t = chrono::duration<double, micro>(Clock::now() - t0).count();
+		for(int i=0;i<n;i++)
+			latency[(num_requests+i) % LATENCY_WINDOW] = t;
+		num_requests += n;
+		num_batches++;
+		if( qw ){
+			Clock::time_point t1 = Clock::now();
+			compare_exact(&(bin[0]), n, &(label[0]), &(out[0]), rep);
+			t_start += Clock::now() - t1; //not counted in the throughput
+		}
+	}
+	fflush(stdout);
+	free(line);
+	cerr << stats_string() << endl;
+	if( qw ){
+		cerr << "quantized vs exact: same prediction=" << rep.agree << "/" << rep.n
+			<< " max_dec_error=" << rep.max_err << " (max |dec|=" << rep.max_dec << ")";
+		if( rep.n_label > 0 && model.h.type == RB_REGRESSION )
+			cerr << " mse=" << rep.sse_q/rep.n_label << " (exact " << rep.sse/rep.n_label << ")";
+		else if( rep.n_label > 0 )
+			cerr << " accuracy=" << 100.0*rep.correct_q/rep.n_label << "% (exact " << 100.0*rep.correct/rep.n_label << "%)";
+		cerr << endl;
+	}
+}
+
+int main(int argc, char* argv[]){
+
+	if(argc < 1+2){
+		cerr << "Usage: " << argv[0] << " [rbModel] [socket|-] (max_batch=64) (max_wait_us=200) (num_threads) (weights=exact|fp16|int8|int8g) (rangeIn)" << endl;
+		exit(0);
+	}
+
+	char* modelFile = argv[1];
+	char* socketPath = argv[2];
+	if( argc >= 1+3 )
+		max_batch = atoi(argv[3]);
+	if( argc >= 1+4 )
+		max_wait_us = atol(argv[4]);
+	if( argc >= 1+5 )
+		omp_set_num_threads(atoi(argv[5]));
+	if( max_batch < 1 )
+		max_batch = 1;
+	const char* weights = argc >= 1+6 ? argv[6] : "exact";
+	int wtype;
+	if( strcmp(weights, "exact") == 0 )
+		wtype = RB_W_EXACT;
+	else if( strcmp(weights, "fp16") == 0 )
+		wtype = RB_W_FP16;
+	else if( strcmp(weights, "int8") == 0 )
+		wtype = RB_W_INT8;
+	else if( strcmp(weights, "int8g") == 0 )
+		wtype = RB_W_INT8_GRID;
+	else{
+		cerr << "unknown weights " << weights << endl;
+		exit(1);
+	}
+
+	if( argc >= 1+7 && strcmp(argv[7], "-") ){
+		if( load_scaling(argv[7], scaling) ){
+			cerr << "can't load range from file " << argv[7] << endl;
+			exit(1);
+		}
+		sc = &scaling;
+	}
+
+	if( load_rb_model(modelFile, model) ){
+		cerr << "can't load model from file " << modelFile << endl;
+		exit(1);
+	}
+	cerr << "d=" << model.h.d << " D=" << model.h.D << " nbins=" << model.h.nbins << " nr_w=" << model.h.nr_w << endl;
+	if( wtype != RB_W_EXACT ){
+		rb_quantize(model, wtype, qweights);
+		qw = &qweights;
+		cerr << "weights=" << weights << ": " << rb_weight_bytes(model, qw) << " bytes (exact " << rb_weight_bytes(model, NULL) << " bytes)" << endl;
+	}
+
+	t_start = Clock::now();
+	if( strcmp(socketPath, "-") == 0 ){
+		serve_stdin();
+		free_rb_model(model);
+		return 0;
+	}
+
+	int sfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path)-1);
+	unlink(socketPath);
+	if( sfd < 0 || bind(sfd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(sfd, 128) != 0 ){
+		cerr << "can't listen on socket " << socketPath << ": " << strerror(errno) << endl;
+		exit(1);
+	}
+	cerr << "listening on " << socketPath << endl;
+
+	thread(batcher).detach();
+	while( true ){
+		int fd = accept(sfd, NULL, NULL);
+		if( fd < 0 ){
+			if( errno == EINTR )
+				continue;
+			cerr << "accept: " << strerror(errno) << endl;
+			break;
+		}
+		thread(serve_connection, fd).detach();
+	}
+
+	close(sfd);
+	unlink(socketPath);
+	free_rb_model(model);
+	return 0;
+}
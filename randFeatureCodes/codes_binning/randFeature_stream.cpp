@@ -0,0 +1,360 @@
+//Streaming trainer over random binning features, for training sets
+//larger than memory. The rows are read in chunks of chunk_rows lines,
+//binned, and used for minibatch SGD or AdaGrad updates of the weights;
+//only one chunk of rows and the weights are resident, never the whole
+//feature matrix as in randFeature_pipe or in PCG.
+//
+//Binning: with rbModelIn (a model file of randFeature_pipe, see
+//rbmodel.h), the rows are binned with its grids and dictionaries; a
+//bin not in the dictionary is ignored. Its weights are the initial
+//solution if it has one decision value. Otherwise (rbModelIn "-"),
+//D grids are drawn for dim features as in random_binning_index, and
+//the code of a row in grid j is hashed to one of 2^hash_bits features
+//of the grid, so that no dictionary is needed.
+//
+//Updates: the loss (square, L2-hinge or logistic, see
+//parallel_RCD/loss.h) with the L2 regularization lambda/2*|w|^2 is
+//minimized. In a minibatch, the decision values of the rows are
+//computed in parallel (gather of the D weights of each row); the
+//gradient is then scattered grid by grid: the features of a grid are
+//disjoint from those of the other grids, so each grid is updated by
+//one thread, without locks or atomics. Only the weights of the bins
+//active in the minibatch are updated, including their regularization
+//term. The step is eta/sqrt(epoch+1) (SGD) or eta/sqrt(sum of squared
+//gradients) per feature (AdaGrad). The rows of a chunk are shuffled.
+//
+//Scaling: with scale = "lower,upper" (or "lower,upper,y_lower,y_upper"),
+//a first pass over the training file accumulates the range of the
+//features chunk by chunk, and every chunk of the epochs and of the test
+//rows is then scaled in memory as by svm-scale (see scale.h) before it
+//is binned. rangeOut saves the range (binary); rangeIn restores one
+//and skips the first pass.
+//
+//Each epoch prints its time, rows per second and the average loss of
+//the rows before their update. The test rows, if any, are streamed and
+//scored at the end.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cfloat>
+#include <climits>
+
+#include "binning.h"
+#include "scale.h"
+#include "../../parallel_RCD/loss.h"
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include <omp.h>
+
+using namespace std;
+
+//bins of the rows of a chunk, in grid-major order for the dictionary
+//lookups, from a model file or by hashing the codes
+struct stream_binner{
+
+	const rb_model* model;   //NULL: hashing mode
+	binning_grids grids;     //hashing mode
+	int d, D, hash_bits;
+	long nbins;
+
+	const double* delta(int j) const { return model ? model->delta+(long)j*d : &(grids.delta[(long)j*d]); }
+	const double* u(int j) const { return model ? model->u+(long)j*d : &(grids.u[(long)j*d]); }
+
+	//bin[(long)i*D+j]: feature index (1-based) of row i in grid j, or 0
+	void bin(vector< vector< pair<int,double> > >& rows, long n, int* bin) const {
+
+		unsigned long long mask = (1ULL << hash_bits) - 1;
+#pragma omp parallel
+		{
+			vector<int> code(d);
+#pragma omp for schedule(static) collapse(2)
+			for(int j=0;j<D;j++){
+				for(long i=0;i<n;i++){
+					const vector< pair<int,double> >& x = rows[i];
+					if( x.empty() ){
+						bin[i*D+j] = 0;
+						continue;
+					}
+					rb_code(&(x[0]), x.size(), delta(j), u(j), d, &(code[0]));
+					if( model ){
+						bin[i*D+j] = rb_lookup(*model, j, &(code[0]));
+						continue;
+					}
+					unsigned long long z = 0x9E3779B97F4A7C15ULL * (j+1);
+					for(int t=0;t<d;t++){
+						z ^= (unsigned long long)(unsigned int)code[t] + 0x632BE59BD9B4E019ULL + (z << 6) + (z >> 2);
+						z *= 0xBF58476D1CE4E5B9ULL;
+					}
+					z ^= z >> 31;
+					bin[i*D+j] = (int)( ((unsigned long long)j << hash_bits) + (z & mask) + 1 );
+				}
+			}
+		}
+	}
+};
+
+//draw the grids of D bins of d features, as in random_binning_index
+void draw_grids(int d, int D, double gamma, binning_grids& g){
+
+	Gamma gamma_dist(gamma);
+	g.d = d;
+	g.D = D;
+	g.delta.resize((long)D*d);
+	g.u.resize((long)D*d);
+	for(long k=0;k<(long)D*d;k++){
+		g.delta[k] = gamma_dist.generate();
+		g.u[k] = ((double)rand()/RAND_MAX)*g.delta[k];
+	}
+}
+
+//average loss of the rows before their update, accumulated over an epoch
+struct epoch_stats{
+	long rows;
+	double loss;
+};
+
+//one minibatch: rows b[0],...,b[nb-1] of the chunk
+void minibatch_update(const int* bin, const double* labs, const int* b, int nb, int D, LossFunc* loss, double lambda, double step, bool adagrad, double* w, double* h, double* grad, double* dec, epoch_stats& st){
+
+	double scale = sqrt(1.0/D);
+	double loss_sum = 0.0;
+
+	//gather: decision values and loss derivatives with the current w
+#pragma omp parallel for schedule(static) reduction(+:loss_sum)
+	for(int r=0;r<nb;r++){
+		const int* bin_i = bin + (long)b[r]*D;
+		double v = 0.0;
+		for(int j=0;j<D;j++)
+			v += w[bin_i[j]];
+		v *= scale;
+		double y = labs[b[r]];
+		loss_sum += loss->fval(v, y);
+		dec[r] = loss->deriv(v, y) * scale / nb;
+	}
+
+	//scatter: the features of grid j are only touched by its thread
+#pragma omp parallel for schedule(static)
+	for(int j=0;j<D;j++){
+		for(int r=0;r<nb;r++){
+			int k = bin[(long)b[r]*D+j];
+			if( k > 0 )
+				grad[k] += dec[r];
+		}
+		for(int r=0;r<nb;r++){
+			int k = bin[(long)b[r]*D+j];
+			if( k <= 0 || grad[k] == DBL_MAX )
+				continue;
+			double g = grad[k] + lambda*w[k];
+			if( adagrad ){
+				h[k] += g*g;
+				w[k] -= step*g/(sqrt(h[k])+1e-12);
+			}else{
+				w[k] -= step*g;
+			}
+			grad[k] = DBL_MAX; //updated; reset below
+		}
+		for(int r=0;r<nb;r++){
+			int k = bin[(long)b[r]*D+j];
+			if( k > 0 )
+				grad[k] = 0.0;
+		}
+	}
+	w[0] = 0.0; //the empty rows and the bins not found
+
+	st.rows += nb;
+	st.loss += loss_sum;
+}
+
+int main(int argc, char* argv[]){
+
+	if(argc < 1+15){
+		cerr << "Usage: " << argv[0] << " [inTrain] [inTest|-] [rbModelIn|-] [D] [gamma] [dim] [hash_bits] [loss(0:square,1:L2-hinge,2:logistic)] [lambda] [eta] [num_epochs] [batch] [chunk_rows] [num_threads] [adagrad] (rbModelOut) (scale) (rangeOut) (rangeIn)" << endl;
+		exit(0);
+	}
+
+	char* trainFile = argv[1];
+	char* testFile = strcmp(argv[2], "-") ? argv[2] : NULL;
+	char* rbModelIn = strcmp(argv[3], "-") ? argv[3] : NULL;
+	int D = atoi(argv[4]);
+	double gamma = atof(argv[5]);
+	int dim = atoi(argv[6]);
+	int hash_bits = atoi(argv[7]);
+	int type = atoi(argv[8]);
+	double lambda = atof(argv[9]);
+	double eta = atof(argv[10]);
+	int nEpochs = atoi(argv[11]);
+	int batch = atoi(argv[12]);
+	long chunk = atol(argv[13]);
+	int nThreads = atoi(argv[14]);
+	bool adagrad = atoi(argv[15]) != 0;
+	char* rbModelOut = argc > 16 && strcmp(argv[16], "-") ? argv[16] : NULL;
+	char* scaleSpec = argc > 17 && strcmp(argv[17], "-") ? argv[17] : NULL;
+	char* rangeOut = argc > 18 && strcmp(argv[18], "-") ? argv[18] : NULL;
+	char* rangeIn = argc > 19 && strcmp(argv[19], "-") ? argv[19] : NULL;
+
+	omp_set_num_threads(nThreads);
+
+	stream_binner binner;
+	rb_model model_in;
+	if( rbModelIn ){
+		if( load_rb_model(rbModelIn, model_in) ){
+			cerr << "can't load model from file " << rbModelIn << endl;
+			exit(1);
+		}
+		binner.model = &model_in;
+		binner.d = model_in.h.d;
+		binner.D = model_in.h.D;
+		binner.hash_bits = 0;
+		binner.nbins = model_in.h.nbins;
+	}else{
+		if( rbModelOut )
+			cerr << "rbModelOut ignored in hashing mode (no dictionaries)" << endl;
+		rbModelOut = NULL;
+		binner.model = NULL;
+		binner.d = dim+1; //the indices start from 1, as in randFeature_pipe
+		binner.D = D;
+		binner.hash_bits = hash_bits;
+		binner.nbins = (long)D << hash_bits;
+		if( binner.nbins >= INT_MAX ){
+			cerr << "D*2^hash_bits too large" << endl;
+			exit(1);
+		}
+		draw_grids(binner.d, D, gamma, binner.grids);
+	}
+	D = binner.D;
+	long nbins = binner.nbins;
+	cerr << "D=" << D << " dim=" << binner.d << " #features=" << nbins << (rbModelIn ? "" : " (hashed)") << endl;
+
+	LossFunc* loss;
+	if( type==0 )
+		loss = new SquareLoss();
+	else if( type==1 )
+		loss = new L2hingeLoss();
+	else
+		loss = new LogisticLoss();
+
+	vector<double> w(nbins+1, 0.0), h(adagrad ? nbins+1 : 0, 0.0), grad(nbins+1, 0.0);
+	if( rbModelIn && model_in.h.nr_w == 1 ){
+		memcpy(&(w[0]), model_in.w, (nbins+1)*sizeof(double));
+		cerr << "warm start from " << rbModelIn << endl;
+	}
+
+	vector< vector< pair<int,double> > > rows;
+	vector<double> labs;
+
+	rb_scaling scaling;
+	bool scaled = scaleSpec || rangeIn;
+	if( rangeIn ){
+		if( load_scaling(rangeIn, scaling) ){
+			cerr << "can't load range from file " << rangeIn << endl;
+			exit(1);
+		}
+	}else if( scaleSpec ){
+		if( !scaling_parse(scaleSpec, scaling) ){
+			cerr << "inconsistent lower/upper specification " << scaleSpec << endl;
+			exit(1);
+		}
+		double start = omp_get_wtime();
+		ifstream fs(trainFile);
+		if( fs.fail() ){
+			cerr << "error reading file." << endl;
+			exit(1);
+		}
+		long n;
+		while( (n = read_svm_chunk(fs, chunk, rows, labs)) > 0 )
+			scaling_update(scaling, &(rows[0]), &(labs[0]), n, NONE_LABEL);
+		if( !scaling_finish(scaling) ){
+			cerr << "no training rows to compute the range from" << endl;
+			exit(1);
+		}
+		cerr << "range time=" << omp_get_wtime()-start << " rows=" << scaling.rows << " dim=" << scaling.d << endl;
+	}
+	if( rangeOut && scaled && save_scaling(rangeOut, scaling) )
+		cerr << "can't save range to file " << rangeOut << endl;
+	vector<int> bin, order;
+	vector<double> dec(batch);
+	double total_time = 0.0;
+	for(int epoch=0;epoch<nEpochs;epoch++){
+
+		double start = omp_get_wtime(), bin_time = 0.0;
+		double step = adagrad ? eta : eta/sqrt(epoch+1.0);
+		epoch_stats st = {0, 0.0};
+		ifstream fs(trainFile);
+		if( fs.fail() ){
+			cerr << "error reading file." << endl;
+			exit(1);
+		}
+		long n;
+		while( (n = read_svm_chunk(fs, chunk, rows, labs)) > 0 ){
+			double t0 = omp_get_wtime();
+			if( scaled )
+				scale_rows(scaling, &(rows[0]), &(labs[0]), n, NONE_LABEL);
+			bin.resize(n*D);
+			binner.bin(rows, n, &(bin[0]));
+			bin_time += omp_get_wtime()-t0;
+			order.resize(n);
+			for(long i=0;i<n;i++)
+				order[i] = i;
+			random_shuffle(order.begin(), order.end());
+			for(long i0=0;i0<n;i0+=batch){
+				int nb = min((long)batch, n-i0);
+				minibatch_update(&(bin[0]), &(labs[0]), &(order[i0]), nb, D, loss, lambda, step, adagrad, &(w[0]), adagrad ? &(h[0]) : NULL, &(grad[0]), &(dec[0]), st);
+			}
+		}
+		double end = omp_get_wtime();
+		total_time += end-start;
+		cerr << "epoch=" << epoch+1 << " time=" << end-start << " bin_time=" << bin_time
+			<< " rows/s=" << st.rows/(end-start) << " avg_loss=" << st.loss/max(st.rows, 1L) << endl;
+	}
+	cerr << "train time=" << total_time << endl;
+
+	if( testFile ){
+		double start = omp_get_wtime();
+		ifstream fs(testFile);
+		long n, Nte = 0, hit = 0;
+		double sqerr = 0.0, scale = sqrt(1.0/D);
+		while( (n = read_svm_chunk(fs, chunk, rows, labs)) > 0 ){
+			if( scaled )
+				scale_rows(scaling, &(rows[0]), &(labs[0]), n, NONE_LABEL);
+			bin.resize(n*D);
+			binner.bin(rows, n, &(bin[0]));
+#pragma omp parallel for schedule(static) reduction(+:hit,sqerr)
+			for(long i=0;i<n;i++){
+				double v = 0.0;
+				for(int j=0;j<D;j++)
+					v += w[bin[i*D+j]];
+				v *= scale;
+				if( (v > 0) == (labs[i] > 0) )
+					hit++;
+				sqerr += (v-labs[i])*(v-labs[i]);
+			}
+			Nte += n;
+		}
+		cerr << "test time=" << omp_get_wtime()-start << endl;
+		if( type == 0 )
+			cerr << "test rmse = " << sqrt(sqerr/max(Nte, 1L)) << endl;
+		cerr << "test acc = " << (double)hit/max(Nte, 1L) << endl;
+	}
+
+	if( rbModelOut ){
+		binning_grids grids;
+		rb_model_to_grids(model_in, grids);
+		w[0] = 0.0;
+		double labels[2] = {1.0, -1.0};
+		if( save_rb_model(rbModelOut, grids, 1, &(w[0]), type==0 ? RB_REGRESSION : RB_BINARY, 2, labels) )
+			cerr << "can't save model to file " << rbModelOut << endl;
+	}
+	if( rbModelIn )
+		free_rb_model(model_in);
+	delete loss;
+
+	return 0;
+}
@@ -0,0 +1,315 @@
+//C interface of random binning and of the solvers on CSR arrays, built
+//as the shared library librandbin.so (make capi) and used from Python
+//through ctypes by python/randbin.py. The arrays are the buffers of the
+//caller (e.g., the indptr/indices/data of a scipy.sparse.csr_matrix and
+//numpy arrays for the labels and the outputs); nothing is copied on the
+//Python side, and the rows are converted to the solver formats here, in
+//parallel. ctypes releases the GIL during the calls, so the OpenMP
+//loops run while other Python threads proceed.
+//
+//CSR rows: n rows, the columns of row i are indices[indptr[i]],...,
+//indices[indptr[i+1]-1] (0-based, sorted) with values data[...]. Column
+//c is the LibSVM index c+1, as in randFeature_pipe.
+//
+//Binned rows: bin[(long)i*D+j] is the 1-based feature index of the bin
+//of grid j that contains row i, or 0 if none (empty row, or a bin not
+//seen when fitting); every nonzero feature has the value 1/sqrt(D).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <cfloat>
+
+#include "binning.h"
+#include "../liblinear-2.01/linear.h"
+#include "../../parallel_RCD/rcd.h"
+
+#include <vector>
+#include <cmath>
+
+#include <omp.h>
+
+using namespace std;
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type))
+
+//row i of a CSR matrix as a sparse row with LibSVM indices
+static void csr_row(const long* indptr, const int* indices, const double* data, long i, vector< pair<int,double> >& row){
+
+	row.clear();
+	for(long k=indptr[i];k<indptr[i+1];k++)
+		if( data[k] != 0 )
+			row.push_back(make_pair(indices[k]+1, data[k]));
+}
+
+//number of decision values of a liblinear model, see predict_values in linear.cpp
+static int nr_decision_values(const struct model* model_){
+
+	if( model_->nr_class == 2 && model_->param.solver_type != MCSVM_CS )
+		return 1;
+	return model_->nr_class;
+}
+
+//predict the rows 0,...,n-1, whose feature_node arrays are built by
+//fill(i, x) in a buffer of each thread
+template<class Fill>
+static void predict_rows(const struct model* model_, long n, int max_nnz, Fill fill, double* dec, double* label){
+
+	int nr_w = nr_decision_values(model_);
+#pragma omp parallel
+	{
+		vector<struct feature_node> x(max_nnz+2);
+		vector<double> dec_i(model_->nr_class);
+#pragma omp for schedule(static)
+		for(long i=0;i<n;i++){
+			fill(i, &(x[0]));
+			double y = predict_values(model_, &(x[0]), &(dec_i[0]));
+			if( label )
+				label[i] = y;
+			if( dec )
+				memcpy(&(dec[i*nr_w]), &(dec_i[0]), nr_w*sizeof(double));
+		}
+	}
+}
+
+extern "C" {
+
+void rb_set_num_threads(int nr_threads){
+	omp_set_num_threads(nr_threads);
+}
+
+//Draw D grids for the rows of the CSR matrix (ncol columns), the
+//offsets from an mt19937 seeded by seed (not rand(), so that
+//concurrent calls do not interfere), and bin the rows into bin (n*D). Returns the grids and the bin dictionaries, to be
+//released by rb_free_grids; *nbins is the number of features.
+binning_grids* rb_fit_csr(long n, int ncol, const long* indptr, const int* indices, const double* data, int D, double gamma, int seed, int* bin, int* nbins){
+
+	vector< vector< pair<int,double> > > ins(n);
+#pragma omp parallel for schedule(static)
+	for(long i=0;i<n;i++)
+		csr_row(indptr, indices, data, i, ins[i]);
+
+	mt19937 rng(seed);
+	binning_grids* g = new binning_grids();
+	vector<int> bin_v, offset;
+	*nbins = random_binning_index(ncol+1, D, ins, gamma, bin_v, offset, g, &rng);
+	if( n > 0 )
+		memcpy(bin, &(bin_v[0]), (long)n*D*sizeof(int));
+	return g;
+}
+
+//Bin the rows of a CSR matrix with the grids g, without changing them:
+//bins not seen by rb_fit_csr get 0
+void rb_transform_csr(const binning_grids* g, long n, const long* indptr, const int* indices, const double* data, int* bin){
+
+	int d = g->d, D = g->D;
+#pragma omp parallel
+	{
+		vector< pair<int,double> > row;
+		vector<int> code(d);
+#pragma omp for schedule(static)
+		for(long i=0;i<n;i++){
+			csr_row(indptr, indices, data, i, row);
+			int* bin_i = &(bin[i*D]);
+			if( row.empty() ){
+				memset(bin_i, 0, D*sizeof(int));
+				continue;
+			}
+			for(int j=0;j<D;j++){
+				rb_code(&(row[0]), row.size(), &(g->delta[(long)j*d]), &(g->u[(long)j*d]), d, &(code[0]));
+				bin_i[j] = rb_find(&(g->codes[0]), &(g->ids[0]), g->offset[j], g->offset[j+1], d, &(code[0]));
+			}
+		}
+	}
+}
+
+int rb_grids_nbins(const binning_grids* g){
+	return g->ids.size();
+}
+
+int rb_grids_D(const binning_grids* g){
+	return g->D;
+}
+
+void rb_free_grids(binning_grids* g){
+	delete g;
+}
+
+//Save the grids and the weights of a liblinear model trained on their
+//bins as a random binning model file (see rbmodel.h), which is served
+//by randFeature_serve. Returns 0 on success.
+int rb_save_model(const char* f, binning_grids* g, const struct model* model_){
+
+	int nbins = g->ids.size();
+	int nr_class = model_->nr_class;
+	int nr_w = nr_decision_values(model_);
+	vector<double> W((long)(nbins+1)*nr_w, 0.0);
+	memcpy(&(W[nr_w]), model_->w, min((long)model_->nr_feature, (long)nbins)*nr_w*sizeof(double));
+	vector<double> labels(nr_class);
+	for(int k=0;k<nr_class;k++)
+		labels[k] = model_->label ? model_->label[k] : 0.0;
+	int rb_type = check_regression_model(model_) ? RB_REGRESSION : (nr_w==1 ? RB_BINARY : RB_MULTICLASS);
+	return save_rb_model(f, *g, nr_w, &(W[0]), rb_type, nr_class, &(labels[0]));
+}
+
+//Same for the weights w (nbins+1) of rb_rcd_bins with the labels +1/-1
+int rb_save_rcd_model(const char* f, binning_grids* g, const double* w, int loss_type){
+
+	vector<double> W(w, w+g->ids.size()+1);
+	W[0] = 0.0;
+	double labels[2] = {1.0, -1.0};
+	return save_rb_model(f, *g, 1, &(W[0]), loss_type==0 ? RB_REGRESSION : RB_BINARY, 2, labels);
+}
+
+//liblinear train() on the binned rows; the model is released by
+//free_and_destroy_model
+struct model* rb_train_bins(const int* bin, long n, int D, int nbins, const double* y, const struct parameter* param){
+
+	double scale = sqrt(1.0/D);
+	struct problem prob;
+	prob.l = n;
+	prob.n = nbins;
+	prob.bias = -1;
+	prob.y = (double*)y;
+	prob.x = Malloc(struct feature_node*, n);
+	struct feature_node* x_space = Malloc(struct feature_node, n*(D+1));
+#pragma omp parallel for schedule(static)
+	for(long i=0;i<n;i++){
+		struct feature_node* x = &(x_space[i*(D+1)]);
+		int nnz = 0;
+		for(int j=0;j<D;j++){
+			if( bin[i*D+j] == 0 )
+				continue;
+			x[nnz].index = bin[i*D+j];
+			x[nnz].value = scale;
+			nnz++;
+		}
+		x[nnz].index = -1;
+		prob.x[i] = x;
+	}
+	struct model* model_ = train(&prob, param);
+	free(prob.x);
+	free(x_space);
+	return model_;
+}
+
+//predicted labels (n) and decision values (n*nr_w, row major) of the
+//binned rows; either may be NULL
+void rb_predict_bins(const struct model* model_, const int* bin, long n, int D, double* dec, double* label){
+
+	double scale = sqrt(1.0/D);
+	predict_rows(model_, n, D, [&](long i, struct feature_node* x){
+		int nnz = 0;
+		for(int j=0;j<D;j++){
+			if( bin[i*D+j] == 0 )
+				continue;
+			x[nnz].index = bin[i*D+j];
+			x[nnz].value = scale;
+			nnz++;
+		}
+		x[nnz].index = -1;
+	}, dec, label);
+}
+
+//liblinear train() on the rows of a CSR matrix, with a bias feature
+//ncol+1 if bias >= 0
+struct model* csr_train(long n, int ncol, const long* indptr, const int* indices, const double* data, const double* y, double bias, const struct parameter* param){
+
+	struct problem prob;
+	prob.l = n;
+	prob.n = ncol + (bias >= 0 ? 1 : 0);
+	prob.bias = bias;
+	prob.y = (double*)y;
+	prob.x = Malloc(struct feature_node*, n);
+	struct feature_node* x_space = Malloc(struct feature_node, indptr[n]-indptr[0] + 2*n);
+#pragma omp parallel for schedule(static)
+	for(long i=0;i<n;i++){
+		struct feature_node* x = &(x_space[indptr[i]-indptr[0] + 2*i]);
+		int nnz = 0;
+		for(long k=indptr[i];k<indptr[i+1];k++){
+			x[nnz].index = indices[k]+1;
+			x[nnz].value = data[k];
+			nnz++;
+		}
+		if( bias >= 0 ){
+			x[nnz].index = ncol+1;
+			x[nnz].value = bias;
+			nnz++;
+		}
+		x[nnz].index = -1;
+		prob.x[i] = x;
+	}
+	struct model* model_ = train(&prob, param);
+	free(prob.x);
+	free(x_space);
+	return model_;
+}
+
+//as rb_predict_bins, for the rows of a CSR matrix; columns beyond the
+//features of the model are ignored
+void csr_predict(const struct model* model_, long n, const long* indptr, const int* indices, const double* data, double* dec, double* label){
+
+	int max_nnz = 0;
+	for(long i=0;i<n;i++)
+		max_nnz = max(max_nnz, (int)(indptr[i+1]-indptr[i]));
+	int nr_feature = model_->nr_feature;
+	double bias = model_->bias;
+	predict_rows(model_, n, max_nnz, [&](long i, struct feature_node* x){
+		int nnz = 0;
+		for(long k=indptr[i];k<indptr[i+1];k++){
+			if( indices[k] >= nr_feature )
+				continue;
+			x[nnz].index = indices[k]+1;
+			x[nnz].value = data[k];
+			nnz++;
+		}
+		if( bias >= 0 ){
+			x[nnz].index = nr_feature+1;
+			x[nnz].value = bias;
+			nnz++;
+		}
+		x[nnz].index = -1;
+	}, dec, label);
+}
+
+//parallel RCD (see rcd.h) on the binned rows, loss 0: square, 1:
+//L2-hinge, 2: logistic, with L1 regularization lambda; w has nbins+1
+//entries (w[0] unused), and is the initial solution if warm_start;
+//the progress is printed to stdout if verbose
+void rb_rcd_bins(const int* bin, long n, int D, int nbins, const double* y, int loss_type, double lambda, int nr_threads, int nIter, double* w, int warm_start, int verbose){
+
+	double scale = sqrt(1.0/D);
+	vector<Feature*> features(nbins+1);
+	for(int k=0;k<=nbins;k++){
+		features[k] = new Feature();
+		features[k]->id = k;
+	}
+	//the bins of a grid are disjoint from those of the other grids
+#pragma omp parallel for schedule(dynamic)
+	for(int j=0;j<D;j++){
+		for(long i=0;i<n;i++){
+			int k = bin[i*D+j];
+			if( k > 0 )
+				features[k]->values.push_back(make_pair((int)i, scale));
+		}
+	}
+	vector<double> labels(y, y+n);
+
+	LossFunc* loss;
+	if( loss_type==0 )
+		loss = new SquareLoss();
+	else if( loss_type==1 )
+		loss = new L2hingeLoss();
+	else
+		loss = new LogisticLoss();
+
+	vector<double> w_init;
+	if( warm_start )
+		w_init.assign(w, w+nbins+1);
+	rcd(features, labels, n, loss, lambda, w, nr_threads, nIter, -1e300, warm_start ? &(w_init[0]) : NULL, NULL, NULL, NULL, verbose != 0);
+
+	delete loss;
+	for(int k=0;k<=nbins;k++)
+		delete features[k];
+}
+
+}
@@ -0,0 +1,487 @@
+//Random binning model file: the grids, the bin dictionaries and the
+//weights of a linear model trained on the binning features, in one
+//binary file that can be mapped into memory and used without parsing.
+//
+//Layout (every section starts at a multiple of 8 bytes):
+//  rb_header
+//  double labels[nr_label]
+//  double delta[D*d], u[D*d]     grid j is at j*d
+//  int    offset[D+1]            the bins of grid j are offset[j],...,offset[j+1]-1
+//  int    codes[nbins*d]         bin codes of each grid, in lexicographic order
+//  int    ids[nbins]             global (1-based) feature index of each code
+//  double w[(nbins+1)*nr_w]      weights of feature index k at k*nr_w (row 0 unused)
+//
+//Prediction (type): 0 regression, the decision value; 1 binary,
+//labels[0] if the decision value is positive and labels[1] otherwise;
+//2 multiclass, labels[k] of the largest of the nr_w decision values.
+//
+//Quantized weights (rb_quantize): the weights w of a mapped model can
+//be converted at load time to a compact copy, scored by rb_score_batch
+//in place of w:
+//  RB_W_FP16       IEEE half precision, 2 bytes per weight
+//  RB_W_INT8       int8 with one scale per class; the D weights of a
+//                  row are summed in int32 and scaled once
+//  RB_W_INT8_GRID  int8 with one scale per grid and class
+
+#ifndef RBMODEL_H
+#define RBMODEL_H
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+enum { RB_REGRESSION, RB_BINARY, RB_MULTICLASS };
+enum { RB_W_EXACT, RB_W_FP16, RB_W_INT8, RB_W_INT8_GRID };
+
+struct rb_header{
+	char magic[8];
+	int d, D, nbins, nr_w, type, nr_label;
+};
+
+//grids and dictionaries, as produced by random_binning_index
+struct binning_grids{
+	int d, D;
+	vector<double> delta, u;
+	vector<int> offset, codes, ids;
+};
+
+//read-only view of a model file
+struct rb_model{
+	rb_header h;
+	const double* labels;
+	const double* delta;
+	const double* u;
+	const int* offset;
+	const int* codes;
+	const int* ids;
+	const double* w;
+	void* map;
+	size_t map_size;
+};
+
+//quantized copy of the weights of a model, (nbins+1)*nr_w entries
+//(row 0 zero) in h (fp16) or q (int8)
+struct rb_qweights{
+	int type, nr_w;
+	vector<uint16_t> h;
+	vector<int8_t> q;
+	vector<float> scale; //RB_W_INT8: nr_w; RB_W_INT8_GRID: D*nr_w, grid j at j*nr_w
+};
+
+inline size_t rb_align8(size_t n){
+	return (n+7) & ~(size_t)7;
+}
+
+//write the model; w has (nbins+1)*nr_w entries. Returns 0 on success.
+int save_rb_model(const char* f, binning_grids& g, int nr_w, const double* w, int type, int nr_label, const double* labels){
+
+	FILE* fp = fopen(f, "wb");
+	if( fp == NULL )
+		return -1;
+
+	rb_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, "RBMODEL1", 8);
+	h.d = g.d;
+	h.D = g.D;
+	h.nbins = g.ids.size();
+	h.nr_w = nr_w;
+	h.type = type;
+	h.nr_label = nr_label;
+
+	char zeros[8] = {0};
+	const void* data[7] = { labels, &(g.delta[0]), &(g.u[0]), &(g.offset[0]), &(g.codes[0]), &(g.ids[0]), w };
+	size_t bytes[7] = { nr_label*sizeof(double), g.delta.size()*sizeof(double), g.u.size()*sizeof(double),
+		g.offset.size()*sizeof(int), g.codes.size()*sizeof(int), g.ids.size()*sizeof(int),
+		(size_t)(h.nbins+1)*nr_w*sizeof(double) };
+
+	fwrite(&h, sizeof(h), 1, fp);
+	for(int s=0;s<7;s++){
+		if( bytes[s] > 0 )
+			fwrite(data[s], 1, bytes[s], fp);
+		fwrite(zeros, 1, rb_align8(bytes[s])-bytes[s], fp);
+	}
+	int err = ferror(fp);
+	fclose(fp);
+	return err ? -1 : 0;
+}
+
+//map a model file into memory. Returns 0 on success.
+int load_rb_model(const char* f, rb_model& m){
+
+	int fd = open(f, O_RDONLY);
+	if( fd < 0 )
+		return -1;
+	struct stat st;
+	if( fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(rb_header) ){
+		close(fd);
+		return -1;
+	}
+	m.map_size = st.st_size;
+	m.map = mmap(NULL, m.map_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if( m.map == MAP_FAILED )
+		return -1;
+
+	const char* p = (const char*)m.map;
+	memcpy(&(m.h), p, sizeof(rb_header));
+	if( memcmp(m.h.magic, "RBMODEL1", 8) != 0 ){
+		munmap(m.map, m.map_size);
+		return -1;
+	}
+	size_t pos = rb_align8(sizeof(rb_header));
+	long Dd = (long)m.h.D*m.h.d;
+	m.labels = (const double*)(p+pos); pos += rb_align8(m.h.nr_label*sizeof(double));
+	m.delta = (const double*)(p+pos);  pos += rb_align8(Dd*sizeof(double));
+	m.u = (const double*)(p+pos);      pos += rb_align8(Dd*sizeof(double));
+	m.offset = (const int*)(p+pos);    pos += rb_align8((m.h.D+1)*sizeof(int));
+	m.codes = (const int*)(p+pos);     pos += rb_align8((long)m.h.nbins*m.h.d*sizeof(int));
+	m.ids = (const int*)(p+pos);       pos += rb_align8(m.h.nbins*sizeof(int));
+	m.w = (const double*)(p+pos);      pos += (size_t)(m.h.nbins+1)*m.h.nr_w*sizeof(double);
+	if( pos > m.map_size ){
+		munmap(m.map, m.map_size);
+		return -1;
+	}
+	return 0;
+}
+
+void free_rb_model(rb_model& m){
+	munmap(m.map, m.map_size);
+}
+
+//copy the grids and the dictionaries of a model, e.g., to extend them
+void rb_model_to_grids(const rb_model& m, binning_grids& g){
+
+	long Dd = (long)m.h.D*m.h.d;
+	g.d = m.h.d;
+	g.D = m.h.D;
+	g.delta.assign(m.delta, m.delta+Dd);
+	g.u.assign(m.u, m.u+Dd);
+	g.offset.assign(m.offset, m.offset+m.h.D+1);
+	g.codes.assign(m.codes, m.codes+(long)m.h.nbins*m.h.d);
+	g.ids.assign(m.ids, m.ids+m.h.nbins);
+}
+
+//Binned training set file: the labels and the N*D bin indices (see
+//random_binning_index) of the rows a model was trained on, so that
+//the model can be updated with new rows without binning the old ones
+//again.
+//  char magic[8]; long N; long D
+//  double labels[N]
+//  int    bin[N*D]
+int save_rb_bins(const char* f, long N, int D, const double* labels, const int* bin){
+
+	FILE* fp = fopen(f, "wb");
+	if( fp == NULL )
+		return -1;
+	long DD = D;
+	fwrite("RBBINS01", 1, 8, fp);
+	fwrite(&N, sizeof(long), 1, fp);
+	fwrite(&DD, sizeof(long), 1, fp);
+	fwrite(labels, sizeof(double), N, fp);
+	fwrite(bin, sizeof(int), N*D, fp);
+	int err = ferror(fp);
+	fclose(fp);
+	return err ? -1 : 0;
+}
+
+//append the rows of a binned training set file to labels and bin. Returns 0 on success.
+int load_rb_bins(const char* f, int D, vector<double>& labels, vector<int>& bin){
+
+	FILE* fp = fopen(f, "rb");
+	if( fp == NULL )
+		return -1;
+	char magic[8];
+	long N = 0, DD = 0;
+	if( fread(magic, 1, 8, fp) != 8 || memcmp(magic, "RBBINS01", 8) != 0 ||
+		fread(&N, sizeof(long), 1, fp) != 1 || fread(&DD, sizeof(long), 1, fp) != 1 || DD != D ){
+		fclose(fp);
+		return -1;
+	}
+	size_t l0 = labels.size(), b0 = bin.size();
+	labels.resize(l0+N);
+	bin.resize(b0+N*D);
+	bool ok = fread(&(labels[l0]), sizeof(double), N, fp) == (size_t)N &&
+		fread(&(bin[b0]), sizeof(int), N*D, fp) == (size_t)(N*D);
+	fclose(fp);
+	return ok ? 0 : -1;
+}
+
+//code of the sparse row x (sorted indices) in the grid (delta_j, u_j)
+inline void rb_code(const pair<int,double>* x, int nnz, const double* delta_j, const double* u_j, int d, int* code){
+
+	int j=0;
+	for(int k=0;k<nnz && x[k].first<d;k++){
+		while( j < x[k].first ){
+			code[j] = floor((0.0-u_j[j])/delta_j[j]);
+			j++;
+		}
+		code[j] = floor((x[k].second-u_j[j])/delta_j[j]);
+		j++;
+	}
+	while( j < d ){
+		code[j] = floor((0.0-u_j[j])/delta_j[j]);
+		j++;
+	}
+}
+
+//global feature index of a code among the sorted codes lo,...,hi-1, or 0 if not found
+inline int rb_find(const int* codes, const int* ids, int lo, int hi, int d, const int* code){
+
+	while( lo < hi ){
+		int mid = lo + (hi-lo)/2;
+		const int* c = codes + (long)mid*d;
+		int cmp = 0;
+		for(int k=0;k<d;k++){
+			if( c[k] != code[k] ){
+				cmp = c[k] < code[k] ? -1 : 1;
+				break;
+			}
+		}
+		if( cmp == 0 )
+			return ids[mid];
+		if( cmp < 0 )
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	return 0;
+}
+
+//global feature index of a code in grid j, or 0 if the bin was not seen in training
+inline int rb_lookup(const rb_model& m, int j, const int* code){
+	return rb_find(m.codes, m.ids, m.offset[j], m.offset[j+1], m.h.d, code);
+}
+
+//IEEE half precision of f, rounded to nearest even; saturates to the
+//largest finite half
+inline uint16_t rb_float_to_half(float f){
+
+	uint32_t x;
+	memcpy(&x, &f, sizeof(x));
+	uint16_t sign = (x >> 16) & 0x8000;
+	float a = fabs(f);
+	if( !(a < 65504.0f) )
+		return sign | 0x7bff;
+	if( a < 6.103515625e-05f ){ //subnormal: multiples of 2^-24
+		return sign | (uint16_t)nearbyintf(a * 16777216.0f);
+	}
+	memcpy(&x, &a, sizeof(x));
+	uint32_t mant = x & 0x7fffff;
+	uint32_t h = ((x >> 23) - 112) << 10 | (mant >> 13);
+	uint32_t rest = mant & 0x1fff;
+	if( rest > 0x1000 || (rest == 0x1000 && (h & 1)) )
+		h++; //carries into the exponent if needed
+	return sign | (uint16_t)h;
+}
+
+//float of the finite half h, without branches: the exponent and the
+//mantissa are moved to their float positions and rebiased by a
+//multiplication by 2^112, which also normalizes the subnormals
+inline float rb_half_to_float(uint16_t h){
+
+	uint32_t x = (uint32_t)(h & 0x7fff) << 13;
+	float f;
+	memcpy(&f, &x, sizeof(f));
+	f *= 5.192296858534828e+33f;
+	memcpy(&x, &f, sizeof(x));
+	x |= (uint32_t)(h & 0x8000) << 16;
+	memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+//quantize the weights of m to type (RB_W_FP16, RB_W_INT8 or RB_W_INT8_GRID)
+void rb_quantize(const rb_model& m, int type, rb_qweights& qw){
+
+	int D = m.h.D, nr_w = m.h.nr_w;
+	long n = (long)(m.h.nbins+1)*nr_w;
+	qw.type = type;
+	qw.nr_w = nr_w;
+	qw.h.clear();
+	qw.q.clear();
+	qw.scale.clear();
+	if( type == RB_W_FP16 ){
+		qw.h.resize(n);
+		for(long k=0;k<n;k++)
+			qw.h[k] = rb_float_to_half((float)m.w[k]);
+		for(int k=0;k<nr_w;k++)
+			qw.h[k] = 0;
+		return;
+	}
+
+	//grid of each feature index; the scale of a grid is that of its row
+	//in scale, or of the single row for RB_W_INT8
+	int nr_scale = type == RB_W_INT8_GRID ? D : 1;
+	vector<int> grid(m.h.nbins+1, 0);
+	if( type == RB_W_INT8_GRID )
+		for(int j=0;j<D;j++)
+			for(int c=m.offset[j];c<m.offset[j+1];c++)
+				grid[m.ids[c]] = j;
+	vector<double> wmax((long)nr_scale*nr_w, 0.0);
+	for(long b=1;b<=m.h.nbins;b++)
+		for(int k=0;k<nr_w;k++){
+			double& a = wmax[(long)grid[b]*nr_w+k];
+			a = max(a, fabs(m.w[b*nr_w+k]));
+		}
+	qw.scale.resize(wmax.size());
+	for(size_t t=0;t<wmax.size();t++)
+		qw.scale[t] = wmax[t] > 0 ? (float)(wmax[t]/127.0) : 1.0f;
+	qw.q.assign(n, 0);
+	for(long b=1;b<=m.h.nbins;b++)
+		for(int k=0;k<nr_w;k++)
+			qw.q[b*nr_w+k] = (int8_t)lrint(m.w[b*nr_w+k] / qw.scale[(long)grid[b]*nr_w+k]);
+}
+
+//bytes of the weights, exact (qw NULL) or quantized
+inline long rb_weight_bytes(const rb_model& m, const rb_qweights* qw){
+
+	long n = (long)(m.h.nbins+1)*m.h.nr_w;
+	if( qw == NULL || qw->type == RB_W_EXACT )
+		return n*sizeof(double);
+	return qw->type == RB_W_FP16 ? n*sizeof(uint16_t) : n*sizeof(int8_t) + qw->scale.size()*sizeof(float);
+}
+
+//prediction from the nr_w decision values
+inline double rb_predict_label(const rb_model& m, const double* dec){
+
+	if( m.h.type == RB_REGRESSION )
+		return dec[0];
+	if( m.h.type == RB_BINARY )
+		return dec[0] > 0 ? m.labels[0] : m.labels[1];
+	int k_max = 0;
+	for(int k=1;k<m.h.nr_w;k++)
+		if( dec[k] > dec[k_max] )
+			k_max = k;
+	return m.labels[k_max];
+}
+
+//bin a batch of n rows into bin (n*D). The batch is processed grid by
+//grid, so that the grid and its dictionary stay in cache while all
+//the rows are binned.
+void rb_bin_batch(const rb_model& m, vector< pair<int,double> >* const* rows, int n, int* bin){
+
+	int d = m.h.d, D = m.h.D;
+
+#pragma omp parallel
+	{
+		vector<int> code(d);
+#pragma omp for schedule(static) collapse(2)
+		for(int j=0;j<D;j++){
+			for(int i=0;i<n;i++){
+				const vector< pair<int,double> >& x = *(rows[i]);
+				rb_code(x.empty() ? NULL : &(x[0]), x.size(), m.delta+(long)j*d, m.u+(long)j*d, d, &(code[0]));
+				bin[(long)i*D+j] = rb_lookup(m, j, &(code[0]));
+			}
+		}
+	}
+}
+
+//decision values dec (nr_w) of the binned row bin_i: the sum of the
+//weights of its D bins, from w or from the quantized weights qw. The
+//loops over the classes are vectorized by the compiler; with F16C
+//(e.g., -mf16c), the halves are converted 8 at a time.
+inline void rb_score_row(const rb_model& m, const rb_qweights* qw, const int* bin_i, double* dec, vector<float>& acc, vector<int>& iacc){
+
+	int D = m.h.D, nr_w = m.h.nr_w;
+	double scale = sqrt(1.0/D);
+	int type = qw ? qw->type : RB_W_EXACT;
+
+	if( type == RB_W_EXACT ){
+		for(int k=0;k<nr_w;k++)
+			dec[k] = 0.0;
+		for(int j=0;j<D;j++){
+			const double* w_j = m.w + (long)bin_i[j]*nr_w;
+			for(int k=0;k<nr_w;k++)
+				dec[k] += w_j[k];
+		}
+		for(int k=0;k<nr_w;k++)
+			dec[k] *= scale;
+		return;
+	}
+
+	if( type == RB_W_INT8 ){
+		int* a = &(iacc[0]);
+		for(int k=0;k<nr_w;k++)
+			a[k] = 0;
+		for(int j=0;j<D;j++){
+			const int8_t* q_j = &(qw->q[(long)bin_i[j]*nr_w]);
+			for(int k=0;k<nr_w;k++)
+				a[k] += q_j[k];
+		}
+		for(int k=0;k<nr_w;k++)
+			dec[k] = scale * qw->scale[k] * a[k];
+		return;
+	}
+
+	float* a = &(acc[0]);
+	for(int k=0;k<nr_w;k++)
+		a[k] = 0.0f;
+	if( type == RB_W_INT8_GRID ){
+		for(int j=0;j<D;j++){
+			const int8_t* q_j = &(qw->q[(long)bin_i[j]*nr_w]);
+			const float* s_j = &(qw->scale[(long)j*nr_w]);
+			for(int k=0;k<nr_w;k++)
+				a[k] += s_j[k] * q_j[k];
+		}
+	}else{
+		for(int j=0;j<D;j++){
+			const uint16_t* h_j = &(qw->h[(long)bin_i[j]*nr_w]);
+			int k = 0;
+#ifdef __F16C__
+			for(;k+8<=nr_w;k+=8){
+				__m128i h8 = _mm_loadu_si128((const __m128i*)(h_j+k));
+				_mm256_storeu_ps(a+k, _mm256_add_ps(_mm256_loadu_ps(a+k), _mm256_cvtph_ps(h8)));
+			}
+#endif
+			for(;k<nr_w;k++)
+				a[k] += rb_half_to_float(h_j[k]);
+		}
+	}
+	for(int k=0;k<nr_w;k++)
+		dec[k] = scale * a[k];
+}
+
+//decision values (n*nr_w, row major; may be NULL) and predictions
+//(may be NULL) of a batch of n binned rows, scored with w if qw is
+//NULL and with the quantized weights otherwise
+void rb_score_batch(const rb_model& m, const rb_qweights* qw, const int* bin, int n, double* dec, double* out){
+
+	int D = m.h.D, nr_w = m.h.nr_w;
+
+#pragma omp parallel
+	{
+		vector<double> dec_i(nr_w);
+		vector<float> acc(nr_w);
+		vector<int> iacc(nr_w);
+#pragma omp for schedule(static)
+		for(int i=0;i<n;i++){
+			rb_score_row(m, qw, bin + (long)i*D, &(dec_i[0]), acc, iacc);
+			if( dec )
+				memcpy(dec + (long)i*nr_w, &(dec_i[0]), nr_w*sizeof(double));
+			if( out )
+				out[i] = rb_predict_label(m, &(dec_i[0]));
+		}
+	}
+}
+
+//predict a batch of n rows: rb_bin_batch, then rb_score_batch with
+//the weights of the model, or with qw if it is not NULL. bin is a
+//work array of n*D ints.
+void rb_predict_batch(const rb_model& m, vector< pair<int,double> >* const* rows, int n, int* bin, double* out, const rb_qweights* qw = NULL){
+
+	rb_bin_batch(m, rows, n, bin);
+	rb_score_batch(m, qw, bin, n, NULL, out);
+}
+
+#endif
@@ -0,0 +1,244 @@
+//Feature scaling as in libsvm's svm-scale, applied to the rows in
+//memory as they are read (readSVMfile, read_svm_chunk in binning.h)
+//instead of writing a scaled copy of the data file:
+//
+//  x_k -> lower + (upper-lower)*(x_k-fmin[k])/(fmax[k]-fmin[k])
+//
+//for the features k = 1..d, where the range fmin[k], fmax[k] counts
+//the features absent from a row as zeros. As in svm-scale, a feature
+//with fmin[k] = fmax[k] is dropped, and an absent feature becomes a
+//nonzero when its scaled zero is not 0 (e.g., lower = -1); with
+//y_scaling the labels are scaled likewise to [y_lower, y_upper].
+//Unlike the text output of svm-scale, the values are not rounded to 6
+//digits, and the features above d (not seen in the range) are dropped.
+//
+//The range is accumulated over the training rows chunk by chunk, in
+//parallel (scaling_update), then closed by scaling_finish. It can be
+//saved to and restored from a binary range file, so that the test rows
+//or the rows of a server are scaled the same way:
+//  char magic[8]; int d, y_scaling
+//  double lower, upper, y_lower, y_upper, y_min, y_max
+//  double fmin[d+1], fmax[d+1]     (index 0 unused)
+
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <cfloat>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <omp.h>
+
+using namespace std;
+
+struct rb_scaling{
+	int d, y_scaling;
+	double lower, upper, y_lower, y_upper, y_min, y_max;
+	vector<double> fmin, fmax;
+	long rows;          //rows accumulated (scaling_update)
+	vector<long> nnz;   //rows with feature k present
+};
+
+void scaling_init(rb_scaling& s, double lower, double upper, int y_scaling = 0, double y_lower = 0.0, double y_upper = 0.0){
+
+	s.d = 0;
+	s.lower = lower;
+	s.upper = upper;
+	s.y_scaling = y_scaling;
+	s.y_lower = y_lower;
+	s.y_upper = y_upper;
+	s.y_min = DBL_MAX;
+	s.y_max = -DBL_MAX;
+	s.fmin.assign(1, DBL_MAX);
+	s.fmax.assign(1, -DBL_MAX);
+	s.rows = 0;
+	s.nnz.assign(1, 0);
+}
+
+//parse "lower,upper" or "lower,upper,y_lower,y_upper"; returns false
+//if the limits are not lower < upper (and y_lower < y_upper)
+bool scaling_parse(const char* spec, rb_scaling& s){
+
+	double v[4];
+	int k = sscanf(spec, "%lf,%lf,%lf,%lf", &v[0], &v[1], &v[2], &v[3]);
+	if( (k != 2 && k != 4) || !(v[1] > v[0]) || (k == 4 && !(v[3] > v[2])) )
+		return false;
+	scaling_init(s, v[0], v[1], k == 4, k == 4 ? v[2] : 0.0, k == 4 ? v[3] : 0.0);
+	return true;
+}
+
+//add the n rows ins[0],...,ins[n-1] with the labels labs[0],...,
+//labs[n-1] to the range; the rows with the label skip_label (e.g.,
+//NONE_LABEL for the empty lines) are ignored
+void scaling_update(rb_scaling& s, vector< pair<int,double> >* ins, double* labs, long n, double skip_label){
+
+	if( n <= 0 )
+		return;
+	int dmax = s.d;
+#pragma omp parallel for schedule(static) reduction(max:dmax)
+	for(long i=0;i<n;i++)
+		if( !ins[i].empty() && ins[i].back().first > dmax )
+			dmax = ins[i].back().first;
+	s.d = dmax;
+	s.fmin.resize(s.d+1, DBL_MAX);
+	s.fmax.resize(s.d+1, -DBL_MAX);
+	s.nnz.resize(s.d+1, 0);
+
+	long rows = 0;
+#pragma omp parallel reduction(+:rows)
+	{
+		vector<double> fmin(s.d+1, DBL_MAX), fmax(s.d+1, -DBL_MAX);
+		vector<long> nnz(s.d+1, 0);
+		double y_min = DBL_MAX, y_max = -DBL_MAX;
+#pragma omp for schedule(static)
+		for(long i=0;i<n;i++){
+			if( labs[i] == skip_label )
+				continue;
+			rows++;
+			y_min = min(y_min, labs[i]);
+			y_max = max(y_max, labs[i]);
+			for(size_t t=0;t<ins[i].size();t++){
+				int k = ins[i][t].first;
+				if( k < 1 )
+					continue;
+				fmin[k] = min(fmin[k], ins[i][t].second);
+				fmax[k] = max(fmax[k], ins[i][t].second);
+				nnz[k]++;
+			}
+		}
+#pragma omp critical(scaling_update)
+		{
+			for(int k=1;k<=s.d;k++){
+				s.fmin[k] = min(s.fmin[k], fmin[k]);
+				s.fmax[k] = max(s.fmax[k], fmax[k]);
+				s.nnz[k] += nnz[k];
+			}
+			s.y_min = min(s.y_min, y_min);
+			s.y_max = max(s.y_max, y_max);
+		}
+	}
+	s.rows += rows;
+}
+
+//count the absent features as zeros; call once, after the last update.
+//Returns false if no row was accumulated: the range is undefined.
+bool scaling_finish(rb_scaling& s){
+
+	if( s.rows == 0 )
+		return false;
+	for(int k=1;k<=s.d;k++){
+		if( s.nnz[k] < s.rows ){
+			s.fmin[k] = min(s.fmin[k], 0.0);
+			s.fmax[k] = max(s.fmax[k], 0.0);
+		}
+	}
+	return true;
+}
+
+inline double scale_value(double v, double vmin, double vmax, double lower, double upper){
+
+	if( v == vmin )
+		return lower;
+	else if( v == vmax )
+		return upper;
+	else
+		return lower + (upper-lower)*(v-vmin)/(vmax-vmin);
+}
+
+//scale the row x (sorted indices) into out
+void scale_row(const rb_scaling& s, const vector< pair<int,double> >& x, vector< pair<int,double> >& out){
+
+	out.clear();
+	size_t t = 0;
+	while( t < x.size() && x[t].first < 1 )
+		t++;
+	for(int k=1;k<=s.d;k++){
+		double v = 0.0;
+		if( t < x.size() && x[t].first == k )
+			v = x[t++].second;
+		if( s.fmin[k] == s.fmax[k] )
+			continue;
+		v = scale_value(v, s.fmin[k], s.fmax[k], s.lower, s.upper);
+		if( v != 0 )
+			out.push_back(make_pair(k, v));
+	}
+}
+
+inline double scale_label(const rb_scaling& s, double y){
+	return s.y_scaling ? scale_value(y, s.y_min, s.y_max, s.y_lower, s.y_upper) : y;
+}
+
+//scale the n rows ins[0],...,ins[n-1] and their labels labs[0],...,
+//labs[n-1] in place, in parallel; the rows with the label skip_label
+//are left as they are
+void scale_rows(const rb_scaling& s, vector< pair<int,double> >* ins, double* labs, long n, double skip_label){
+
+	if( n <= 0 )
+		return;
+#pragma omp parallel
+	{
+		vector< pair<int,double> > out;
+#pragma omp for schedule(dynamic, 256)
+		for(long i=0;i<n;i++){
+			if( labs[i] == skip_label )
+				continue;
+			scale_row(s, ins[i], out);
+			ins[i].swap(out);
+			labs[i] = scale_label(s, labs[i]);
+		}
+	}
+}
+
+//write the range. Returns 0 on success.
+int save_scaling(const char* f, const rb_scaling& s){
+
+	FILE* fp = fopen(f, "wb");
+	if( fp == NULL )
+		return -1;
+	double limits[6] = { s.lower, s.upper, s.y_lower, s.y_upper, s.y_min, s.y_max };
+	fwrite("RBSCALE1", 1, 8, fp);
+	fwrite(&(s.d), sizeof(int), 1, fp);
+	fwrite(&(s.y_scaling), sizeof(int), 1, fp);
+	fwrite(limits, sizeof(double), 6, fp);
+	fwrite(&(s.fmin[0]), sizeof(double), s.d+1, fp);
+	fwrite(&(s.fmax[0]), sizeof(double), s.d+1, fp);
+	int err = ferror(fp);
+	fclose(fp);
+	return err ? -1 : 0;
+}
+
+//read a range written by save_scaling. Returns 0 on success.
+int load_scaling(const char* f, rb_scaling& s){
+
+	FILE* fp = fopen(f, "rb");
+	if( fp == NULL )
+		return -1;
+	char magic[8];
+	double limits[6];
+	bool ok = fread(magic, 1, 8, fp) == 8 && memcmp(magic, "RBSCALE1", 8) == 0 &&
+		fread(&(s.d), sizeof(int), 1, fp) == 1 && s.d >= 0 &&
+		fread(&(s.y_scaling), sizeof(int), 1, fp) == 1 &&
+		fread(limits, sizeof(double), 6, fp) == 6;
+	if( ok ){
+		s.fmin.resize(s.d+1);
+		s.fmax.resize(s.d+1);
+		ok = fread(&(s.fmin[0]), sizeof(double), s.d+1, fp) == (size_t)(s.d+1) &&
+			fread(&(s.fmax[0]), sizeof(double), s.d+1, fp) == (size_t)(s.d+1);
+	}
+	fclose(fp);
+	if( !ok )
+		return -1;
+	s.lower = limits[0];
+	s.upper = limits[1];
+	s.y_lower = limits[2];
+	s.y_upper = limits[3];
+	s.y_min = limits[4];
+	s.y_max = limits[5];
+	s.rows = 0;
+	s.nnz.assign(s.d+1, 0);
+	return 0;
+}
+
+#endif
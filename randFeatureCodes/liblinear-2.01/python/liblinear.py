@@ -26,6 +26,11 @@ except:
 	else:
 		raise Exception('LIBLINEAR library not found.')
 
+# util.h defines Int as long and uses it for every int of linear.h,
+# including the name of set_print_string_function
+c_Int = c_long
+liblinear.set_print_string_function = liblinear.set_prInt_string_function
+
 L2R_LR = 0
 L2R_L2LOSS_SVC_DUAL = 1 
 L2R_L2LOSS_SVC = 2 
@@ -51,7 +56,7 @@ def fillprototype(f, restype, argtypes):
 
 class feature_node(Structure):
 	_names = ["index", "value"]
-	_types = [c_int, c_double]
+	_types = [c_Int, c_double]
 	_fields_ = genFields(_names, _types)
 
 	def __str__(self):
@@ -86,7 +91,7 @@ def gen_feature_nodearray(xi, feature_max=None, issparse=True):
 
 class problem(Structure):
 	_names = ["l", "n", "y", "x", "bias"]
-	_types = [c_int, c_int, POINTER(c_double), POINTER(POINTER(feature_node)), c_double]
+	_types = [c_Int, c_Int, POINTER(c_double), POINTER(POINTER(feature_node)), c_double]
 	_fields_ = genFields(_names, _types)
 
 	def __init__(self, y, x, bias = -1):
@@ -128,7 +133,7 @@ class problem(Structure):
 
 class parameter(Structure):
 	_names = ["solver_type", "eps", "C", "nr_weight", "weight_label", "weight", "p", "init_sol"]
-	_types = [c_int, c_double, c_double, c_int, POINTER(c_int), POINTER(c_double), c_double, POINTER(c_double)]
+	_types = [c_Int, c_double, c_double, c_Int, POINTER(c_Int), POINTER(c_double), c_double, POINTER(c_double)]
 	_fields_ = genFields(_names, _types)
 
 	def __init__(self, options = None):
@@ -215,7 +220,7 @@ class parameter(Structure):
 			i += 1
 
 		liblinear.set_print_string_function(self.print_func)
-		self.weight_label = (c_int*self.nr_weight)()
+		self.weight_label = (c_Int*self.nr_weight)()
 		self.weight = (c_double*self.nr_weight)()
 		for i in range(self.nr_weight): 
 			self.weight[i] = weight[i]
@@ -245,7 +250,7 @@ class parameter(Structure):
 
 class model(Structure):
 	_names = ["param", "nr_class", "nr_feature", "w", "label", "bias"]
-	_types = [parameter, c_int, c_int, POINTER(c_double), POINTER(c_int), c_double]
+	_types = [parameter, c_Int, c_Int, POINTER(c_double), POINTER(c_Int), c_double]
 	_fields_ = genFields(_names, _types)
 
 	def __init__(self):
@@ -264,7 +269,7 @@ class model(Structure):
 
 	def get_labels(self):
 		nr_class = self.get_nr_class()
-		labels = (c_int * nr_class)()
+		labels = (c_Int * nr_class)()
 		liblinear.get_labels(self, labels)
 		return labels[:nr_class]
 
@@ -298,26 +303,26 @@ def toPyModel(model_ptr):
 	return m
 
 fillprototype(liblinear.train, POINTER(model), [POINTER(problem), POINTER(parameter)])
-fillprototype(liblinear.find_parameter_C, None, [POINTER(problem), POINTER(parameter), c_int, c_double, c_double, POINTER(c_double), POINTER(c_double)])
-fillprototype(liblinear.cross_validation, None, [POINTER(problem), POINTER(parameter), c_int, POINTER(c_double)])
+fillprototype(liblinear.find_parameter_C, None, [POINTER(problem), POINTER(parameter), c_Int, c_double, c_double, POINTER(c_double), POINTER(c_double)])
+fillprototype(liblinear.cross_validation, None, [POINTER(problem), POINTER(parameter), c_Int, POINTER(c_double)])
 
 fillprototype(liblinear.predict_values, c_double, [POINTER(model), POINTER(feature_node), POINTER(c_double)])
 fillprototype(liblinear.predict, c_double, [POINTER(model), POINTER(feature_node)])
 fillprototype(liblinear.predict_probability, c_double, [POINTER(model), POINTER(feature_node), POINTER(c_double)])
 
-fillprototype(liblinear.save_model, c_int, [c_char_p, POINTER(model)])
+fillprototype(liblinear.save_model, c_Int, [c_char_p, POINTER(model)])
 fillprototype(liblinear.load_model, POINTER(model), [c_char_p])
 
-fillprototype(liblinear.get_nr_feature, c_int, [POINTER(model)])
-fillprototype(liblinear.get_nr_class, c_int, [POINTER(model)])
-fillprototype(liblinear.get_labels, None, [POINTER(model), POINTER(c_int)])
-fillprototype(liblinear.get_decfun_coef, c_double, [POINTER(model), c_int, c_int])
-fillprototype(liblinear.get_decfun_bias, c_double, [POINTER(model), c_int])
+fillprototype(liblinear.get_nr_feature, c_Int, [POINTER(model)])
+fillprototype(liblinear.get_nr_class, c_Int, [POINTER(model)])
+fillprototype(liblinear.get_labels, None, [POINTER(model), POINTER(c_Int)])
+fillprototype(liblinear.get_decfun_coef, c_double, [POINTER(model), c_Int, c_Int])
+fillprototype(liblinear.get_decfun_bias, c_double, [POINTER(model), c_Int])
 
 fillprototype(liblinear.free_model_content, None, [POINTER(model)])
 fillprototype(liblinear.free_and_destroy_model, None, [POINTER(POINTER(model))])
 fillprototype(liblinear.destroy_param, None, [POINTER(parameter)])
 fillprototype(liblinear.check_parameter, c_char_p, [POINTER(problem), POINTER(parameter)])
-fillprototype(liblinear.check_probability_model, c_int, [POINTER(model)])
-fillprototype(liblinear.check_regression_model, c_int, [POINTER(model)])
+fillprototype(liblinear.check_probability_model, c_Int, [POINTER(model)])
+fillprototype(liblinear.check_regression_model, c_Int, [POINTER(model)])
 fillprototype(liblinear.set_print_string_function, None, [CFUNCTYPE(None, c_char_p)])
@@ -71,76 +71,106 @@ void predict(FILE *input, FILE *output)
 		}
 	}
 
+	// the rows are read in blocks of block_rows, which are predicted
+	// together by svm_predict_values_batch (in parallel with OpenMP);
+	// x holds the nodes of the rows of the block
+	int block_rows = 4096;
+	int *row_start = (int *) malloc(block_rows*sizeof(int));
+	double *target_labels = (double *) malloc(block_rows*sizeof(double));
+	double *predict_labels = (double *) malloc(block_rows*sizeof(double));
+	const struct svm_node **rows = (const struct svm_node **) malloc(block_rows*sizeof(struct svm_node *));
+
 	max_line_len = 1024;
 	line = (char *)malloc(max_line_len*sizeof(char));
-	while(readline(input) != NULL)
+	while(1)
 	{
-		int i = 0;
-		double target_label, predict_label;
-		char *idx, *val, *label, *endptr;
-		int inst_max_index = -1; // strtol gives 0 if wrong format, and precomputed kernel has <index> start from 0
+		int nb = 0, k = 0;
+		while(nb < block_rows && readline(input) != NULL)
+		{
+			double target_label;
+			char *idx, *val, *label, *endptr;
+			int inst_max_index = -1; // strtol gives 0 if wrong format, and precomputed kernel has <index> start from 0
 
-		label = strtok(line," \t\n");
-		if(label == NULL) // empty line
-			exit_input_error(total+1);
+			label = strtok(line," \t\n");
+			if(label == NULL) // empty line
+				exit_input_error(total+nb+1);
 
-		target_label = strtod(label,&endptr);
-		if(endptr == label || *endptr != '\0')
-			exit_input_error(total+1);
+			target_label = strtod(label,&endptr);
+			if(endptr == label || *endptr != '\0')
+				exit_input_error(total+nb+1);
 
-		while(1)
-		{
-			if(i>=max_nr_attr-1)	// need one more for index = -1
+			row_start[nb] = k;
+			while(1)
 			{
-				max_nr_attr *= 2;
-				x = (struct svm_node *) realloc(x,max_nr_attr*sizeof(struct svm_node));
-			}
+				if(k>=max_nr_attr-1)	// need one more for index = -1
+				{
+					max_nr_attr *= 2;
+					x = (struct svm_node *) realloc(x,max_nr_attr*sizeof(struct svm_node));
+				}
 
-			idx = strtok(NULL,":");
-			val = strtok(NULL," \t");
+				idx = strtok(NULL,":");
+				val = strtok(NULL," \t");
 
-			if(val == NULL)
-				break;
-			errno = 0;
-			x[i].index = (int) strtol(idx,&endptr,10);
-			if(endptr == idx || errno != 0 || *endptr != '\0' || x[i].index <= inst_max_index)
-				exit_input_error(total+1);
-			else
-				inst_max_index = x[i].index;
-
-			errno = 0;
-			x[i].value = strtod(val,&endptr);
-			if(endptr == val || errno != 0 || (*endptr != '\0' && !isspace(*endptr)))
-				exit_input_error(total+1);
-
-			++i;
+				if(val == NULL)
+					break;
+				errno = 0;
+				x[k].index = (int) strtol(idx,&endptr,10);
+				if(endptr == idx || errno != 0 || *endptr != '\0' || x[k].index <= inst_max_index)
+					exit_input_error(total+nb+1);
+				else
+					inst_max_index = x[k].index;
+
+				errno = 0;
+				x[k].value = strtod(val,&endptr);
+				if(endptr == val || errno != 0 || (*endptr != '\0' && !isspace(*endptr)))
+					exit_input_error(total+nb+1);
+
+				++k;
+			}
+			x[k++].index = -1;
+			target_labels[nb++] = target_label;
 		}
-		x[i].index = -1;
+		if(nb == 0)
+			break;
+		for(j=0;j<nb;j++)
+			rows[j] = x+row_start[j];
 
 		if (predict_probability && (svm_type==C_SVC || svm_type==NU_SVC))
 		{
-			predict_label = svm_predict_probability(model,x,prob_estimates);
-			fprintf(output,"%g",predict_label);
-			for(j=0;j<nr_class;j++)
-				fprintf(output," %g",prob_estimates[j]);
-			fprintf(output,"\n");
+			for(j=0;j<nb;j++)
+			{
+				predict_labels[j] = svm_predict_probability(model,rows[j],prob_estimates);
+				fprintf(output,"%g",predict_labels[j]);
+				for(int c=0;c<nr_class;c++)
+					fprintf(output," %g",prob_estimates[c]);
+				fprintf(output,"\n");
+			}
 		}
 		else
 		{
-			predict_label = svm_predict(model,x);
-			fprintf(output,"%g\n",predict_label);
+			svm_predict_values_batch(model,rows,nb,NULL,predict_labels);
+			for(j=0;j<nb;j++)
+				fprintf(output,"%g\n",predict_labels[j]);
 		}
 
-		if(predict_label == target_label)
-			++correct;
-		error += (predict_label-target_label)*(predict_label-target_label);
-		sump += predict_label;
-		sumt += target_label;
-		sumpp += predict_label*predict_label;
-		sumtt += target_label*target_label;
-		sumpt += predict_label*target_label;
-		++total;
+		for(j=0;j<nb;j++)
+		{
+			double predict_label = predict_labels[j], target_label = target_labels[j];
+			if(predict_label == target_label)
+				++correct;
+			error += (predict_label-target_label)*(predict_label-target_label);
+			sump += predict_label;
+			sumt += target_label;
+			sumpp += predict_label*predict_label;
+			sumtt += target_label*target_label;
+			sumpt += predict_label*target_label;
+			++total;
+		}
 	}
+	free(row_start);
+	free(target_labels);
+	free(predict_labels);
+	free(rows);
 	if (svm_type==NU_SVR || svm_type==EPSILON_SVR)
 	{
 		info("Mean squared error = %g (regression)\n",error/total);
@@ -32,6 +32,10 @@ void exit_with_help()
 	"-n nu : set the parameter nu of nu-SVC, one-class SVM, and nu-SVR (default 0.5)\n"
 	"-p epsilon : set the epsilon in loss function of epsilon-SVR (default 0.1)\n"
 	"-m cachesize : set cache memory size in MB (default 100)\n"
+	"-f cache_format : set format of the cached kernel values (default 0)\n"
+	"	0 -- float\n"
+	"	1 -- half precision: twice the columns, for kernel values below 65504\n"
+	"	2 -- bfloat16: twice the columns, fewer bits\n"
 	"-e epsilon : set tolerance of termination criterion (default 0.001)\n"
 	"-h shrinking : whether to use the shrinking heuristics, 0 or 1 (default 1)\n"
 	"-b probability_estimates : whether to train a SVC or SVR model for probability estimates, 0 or 1 (default 0)\n"
@@ -58,6 +62,7 @@ struct svm_model *model;
 struct svm_node *x_space;
 int cross_validation;
 int nr_fold;
+int quiet;
 
 static char *line = NULL;
 static int max_line_len;
@@ -110,6 +115,14 @@ int main(int argc, char **argv)
 		}
 		svm_free_and_destroy_model(&model);
 	}
+	if(!quiet)
+	{
+		struct svm_cache_stats stats;
+		svm_get_cache_stats(&stats);
+		long int total = stats.hit + stats.miss;
+		printf("Kernel cache: hit = %ld, miss = %ld, eviction = %ld, hit rate = %g%%\n",
+			stats.hit, stats.miss, stats.eviction, total > 0 ? 100.0*(double)stats.hit/(double)total : 0.0);
+	}
 	svm_destroy_param(&param);
 	free(prob.y);
 	free(prob.x);
@@ -180,6 +193,7 @@ void parse_command_line(int argc, char **argv, char *input_file_name, char *mode
 	param.weight_label = NULL;
 	param.weight = NULL;
 	cross_validation = 0;
+	quiet = 0;
 
 	// parse options
 	for(i=1;i<argc;i++)
@@ -210,6 +224,14 @@ void parse_command_line(int argc, char **argv, char *input_file_name, char *mode
 			case 'm':
 				param.cache_size = atof(argv[i]);
 				break;
+			case 'f':
+				if(atoi(argv[i]) < CACHE_FLOAT || atoi(argv[i]) > CACHE_BF16)
+				{
+					fprintf(stderr,"unknown cache format %s\n",argv[i]);
+					exit_with_help();
+				}
+				svm_set_cache_format(atoi(argv[i]));
+				break;
 			case 'c':
 				param.C = atof(argv[i]);
 				break;
@@ -227,6 +249,7 @@ void parse_command_line(int argc, char **argv, char *input_file_name, char *mode
 				break;
 			case 'q':
 				print_func = &print_null;
+				quiet = 1;
 				i--;
 				break;
 			case 'v':
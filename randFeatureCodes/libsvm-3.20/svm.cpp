@@ -7,6 +7,12 @@
 #include <stdarg.h>
 #include <limits.h>
 #include <locale.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
 #include "svm.h"
 int libsvm_version = LIBSVM_VERSION;
 typedef float Qfloat;
@@ -63,25 +69,34 @@ static void info(const char *fmt,...) {}
 //
 // l is the number of total data items
 // size is the cache size limit in bytes
+// format is the storage of the cached entries: CACHE_FLOAT (Qfloat),
+// CACHE_FP16 (IEEE half) or CACHE_BF16 (bfloat16); the 2-byte formats
+// hold twice as many entries and are decoded to Qfloat on access
 //
 class Cache
 {
 public:
-	Cache(int l,long int size);
+	Cache(int l,long int size,int format = CACHE_FLOAT);
 	~Cache();
 
 	// request data [0,len)
 	// return some position p where [p,len) need to be filled
 	// (p >= len if nothing needs to be filled)
+	// with a 2-byte format, data is a decoding buffer which stays
+	// valid until the second next call
 	int get_data(const int index, Qfloat **data, int len);
+	// store [start,len) of data filled after get_data; with a 2-byte
+	// format, the entries are rounded to the format in data as well
+	void set_data(const int index, Qfloat *data, int start, int len);
 	void swap_index(int i, int j);
 private:
 	int l;
 	long int size;
+	int format;
 	struct head_t
 	{
 		head_t *prev, *next;	// a circular list
-		Qfloat *data;
+		void *data;
 		int len;		// data[0,len) is cached in this entry
 	};
 
@@ -89,15 +104,122 @@ private:
 	head_t lru_head;
 	void lru_delete(head_t *h);
 	void lru_insert(head_t *h);
+	void free_entry(head_t *h);
+
+	Qfloat *buffer[2];
+	int next_buffer;
+	long int nr_hit, nr_miss, nr_eviction;
 };
 
-Cache::Cache(int l_,long int size_):l(l_),size(size_)
+static int cache_format = CACHE_FLOAT;
+static svm_cache_stats cache_stats = {0, 0, 0};
+
+static inline unsigned short float_to_half(float f)
+{
+	unsigned int x;
+	memcpy(&x, &f, sizeof(x));
+	unsigned short sign = (unsigned short)((x >> 16) & 0x8000);
+	float a = fabsf(f);
+	if(!(a < 65504.0f))	// saturate
+		return sign | 0x7bff;
+	if(a < 6.103515625e-05f)	// subnormal: multiples of 2^-24
+		return sign | (unsigned short)nearbyintf(a * 16777216.0f);
+	memcpy(&x, &a, sizeof(x));
+	unsigned int mant = x & 0x7fffff;
+	unsigned int h = ((x >> 23) - 112) << 10 | (mant >> 13);
+	unsigned int rest = mant & 0x1fff;
+	if(rest > 0x1000 || (rest == 0x1000 && (h & 1)))
+		h++;
+	return sign | (unsigned short)h;
+}
+
+// without branches, so that the loops of decode vectorize: the bits are
+// moved to their float positions and rebiased by a product with 2^112
+static inline float half_to_float(unsigned short h)
+{
+	unsigned int x = (unsigned int)(h & 0x7fff) << 13;
+	float f;
+	memcpy(&f, &x, sizeof(f));
+	f *= 5.192296858534828e+33f;
+	memcpy(&x, &f, sizeof(x));
+	x |= (unsigned int)(h & 0x8000) << 16;
+	memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+static inline unsigned short float_to_bf16(float f)
+{
+	unsigned int x;
+	memcpy(&x, &f, sizeof(x));
+	x += 0x7fff + ((x >> 16) & 1);	// round to nearest even
+	return (unsigned short)(x >> 16);
+}
+
+static inline float bf16_to_float(unsigned short h)
+{
+	unsigned int x = (unsigned int)h << 16;
+	float f;
+	memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+static void encode(int format, const Qfloat *src, unsigned short *dst, int n)
+{
+	int i = 0;
+	if(format == CACHE_FP16)
+	{
+#ifdef __F16C__
+		// saturated as in float_to_half
+		const __m256 big = _mm256_set1_ps(65504.0f), nbig = _mm256_set1_ps(-65504.0f);
+		for(;i+8<=n;i+=8)
+		{
+			__m256 v = _mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(src+i), big), nbig);
+			_mm_storeu_si128((__m128i *)(dst+i), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+		}
+#endif
+		for(;i<n;i++)
+			dst[i] = float_to_half(src[i]);
+	}
+	else
+		for(;i<n;i++)
+			dst[i] = float_to_bf16(src[i]);
+}
+
+static void decode(int format, const unsigned short *src, Qfloat *dst, int n)
+{
+	int i = 0;
+	if(format == CACHE_FP16)
+	{
+#ifdef __F16C__
+		for(;i+8<=n;i+=8)
+			_mm256_storeu_ps(dst+i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(src+i))));
+#endif
+		for(;i<n;i++)
+			dst[i] = half_to_float(src[i]);
+	}
+	else
+		for(;i<n;i++)
+			dst[i] = bf16_to_float(src[i]);
+}
+
+Cache::Cache(int l_,long int size_,int format_):l(l_),size(size_),format(format_)
 {
 	head = (head_t *)calloc(l,sizeof(head_t));	// initialized to 0
-	size /= sizeof(Qfloat);
-	size -= l * sizeof(head_t) / sizeof(Qfloat);
+	long int entry_size = format == CACHE_FLOAT ? (long int)sizeof(Qfloat) : 2;
+	size /= entry_size;
+	size -= l * sizeof(head_t) / entry_size;
+	if(format != CACHE_FLOAT)
+		size -= 2 * l * sizeof(Qfloat) / entry_size;	// decoding buffers
 	size = max(size, 2 * (long int) l);	// cache must be large enough for two columns
 	lru_head.next = lru_head.prev = &lru_head;
+	buffer[0] = buffer[1] = NULL;
+	if(format != CACHE_FLOAT)
+	{
+		buffer[0] = Malloc(Qfloat,l);
+		buffer[1] = Malloc(Qfloat,l);
+	}
+	next_buffer = 0;
+	nr_hit = nr_miss = nr_eviction = 0;
 }
 
 Cache::~Cache()
@@ -105,6 +227,16 @@ Cache::~Cache()
 	for(head_t *h = lru_head.next; h != &lru_head; h=h->next)
 		free(h->data);
 	free(head);
+	free(buffer[0]);
+	free(buffer[1]);
+#ifdef _OPENMP
+#pragma omp critical(svm_cache_stats)
+#endif
+	{
+		cache_stats.hit += nr_hit;
+		cache_stats.miss += nr_miss;
+		cache_stats.eviction += nr_eviction;
+	}
 }
 
 void Cache::lru_delete(head_t *h)
@@ -123,6 +255,16 @@ void Cache::lru_insert(head_t *h)
 	h->next->prev = h;
 }
 
+void Cache::free_entry(head_t *h)
+{
+	lru_delete(h);
+	free(h->data);
+	size += h->len;
+	h->data = 0;
+	h->len = 0;
+	++nr_eviction;
+}
+
 int Cache::get_data(const int index, Qfloat **data, int len)
 {
 	head_t *h = &head[index];
@@ -131,28 +273,40 @@ int Cache::get_data(const int index, Qfloat **data, int len)
 
 	if(more > 0)
 	{
+		++nr_miss;
 		// free old space
 		while(size < more)
-		{
-			head_t *old = lru_head.next;
-			lru_delete(old);
-			free(old->data);
-			size += old->len;
-			old->data = 0;
-			old->len = 0;
-		}
+			free_entry(lru_head.next);
 
 		// allocate new space
-		h->data = (Qfloat *)realloc(h->data,sizeof(Qfloat)*len);
+		h->data = realloc(h->data,(format == CACHE_FLOAT ? sizeof(Qfloat) : 2)*len);
 		size -= more;
 		swap(h->len,len);
 	}
+	else
+		++nr_hit;
 
 	lru_insert(h);
-	*data = h->data;
+	if(format == CACHE_FLOAT)
+		*data = (Qfloat *)h->data;
+	else
+	{
+		*data = buffer[next_buffer];
+		next_buffer = 1 - next_buffer;
+		decode(format, (unsigned short *)h->data, *data, len);
+	}
 	return len;
 }
 
+void Cache::set_data(const int index, Qfloat *data, int start, int len)
+{
+	if(format == CACHE_FLOAT || start >= len)
+		return;
+	unsigned short *h_data = (unsigned short *)head[index].data;
+	encode(format, data+start, h_data+start, len-start);
+	decode(format, h_data+start, data+start, len-start);
+}
+
 void Cache::swap_index(int i, int j)
 {
 	if(i==j) return;
@@ -170,15 +324,16 @@ void Cache::swap_index(int i, int j)
 		if(h->len > i)
 		{
 			if(h->len > j)
-				swap(h->data[i],h->data[j]);
+			{
+				if(format == CACHE_FLOAT)
+					swap(((Qfloat *)h->data)[i],((Qfloat *)h->data)[j]);
+				else
+					swap(((unsigned short *)h->data)[i],((unsigned short *)h->data)[j]);
+			}
 			else
 			{
 				// give up
-				lru_delete(h);
-				free(h->data);
-				size += h->len;
-				h->data = 0;
-				h->len = 0;
+				free_entry(h);
 			}
 		}
 	}
@@ -1270,7 +1425,7 @@ public:
 	:Kernel(prob.l, prob.x, param)
 	{
 		clone(y,y_,prob.l);
-		cache = new Cache(prob.l,(long int)(param.cache_size*(1<<20)));
+		cache = new Cache(prob.l,(long int)(param.cache_size*(1<<20)),cache_format);
 		QD = new double[prob.l];
 		for(int i=0;i<prob.l;i++)
 			QD[i] = (this->*kernel_function)(i,i);
@@ -1284,6 +1439,7 @@ public:
 		{
 			for(j=start;j<len;j++)
 				data[j] = (Qfloat)(y[i]*y[j]*(this->*kernel_function)(i,j));
+			cache->set_data(i,data,start,len);
 		}
 		return data;
 	}
@@ -1319,7 +1475,7 @@ public:
 	ONE_CLASS_Q(const svm_problem& prob, const svm_parameter& param)
 	:Kernel(prob.l, prob.x, param)
 	{
-		cache = new Cache(prob.l,(long int)(param.cache_size*(1<<20)));
+		cache = new Cache(prob.l,(long int)(param.cache_size*(1<<20)),cache_format);
 		QD = new double[prob.l];
 		for(int i=0;i<prob.l;i++)
 			QD[i] = (this->*kernel_function)(i,i);
@@ -1333,6 +1489,7 @@ public:
 		{
 			for(j=start;j<len;j++)
 				data[j] = (Qfloat)(this->*kernel_function)(i,j);
+			cache->set_data(i,data,start,len);
 		}
 		return data;
 	}
@@ -1366,7 +1523,7 @@ public:
 	:Kernel(prob.l, prob.x, param)
 	{
 		l = prob.l;
-		cache = new Cache(l,(long int)(param.cache_size*(1<<20)));
+		cache = new Cache(l,(long int)(param.cache_size*(1<<20)),cache_format);
 		QD = new double[2*l];
 		sign = new schar[2*l];
 		index = new int[2*l];
@@ -1399,6 +1556,7 @@ public:
 		{
 			for(j=0;j<l;j++)
 				data[j] = (Qfloat)(this->*kernel_function)(real_i,j);
+			cache->set_data(real_i,data,0,l);
 		}
 
 		// reorder and copy
@@ -2086,6 +2244,28 @@ static void svm_group_classes(const svm_problem *prob, int *nr_class_ret, int **
 	free(data_label);
 }
 
+// Binary problem of the classes i (+1) and j (-1) of the grouped data x
+static void svm_pair_problem(svm_node **x, const int *start, const int *count,
+	int i, int j, svm_problem *sub_prob)
+{
+	int si = start[i], sj = start[j];
+	int ci = count[i], cj = count[j];
+	sub_prob->l = ci+cj;
+	sub_prob->x = Malloc(svm_node *,sub_prob->l);
+	sub_prob->y = Malloc(double,sub_prob->l);
+	int k;
+	for(k=0;k<ci;k++)
+	{
+		sub_prob->x[k] = x[si+k];
+		sub_prob->y[k] = +1;
+	}
+	for(k=0;k<cj;k++)
+	{
+		sub_prob->x[ci+k] = x[sj+k];
+		sub_prob->y[ci+k] = -1;
+	}
+}
+
 //
 // Interface functions
 //
@@ -2176,55 +2356,71 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 		}
 
 		// train k*(k-1)/2 models
-		
+
+		int nr_pair = nr_class*(nr_class-1)/2;
+		int *pair_i = Malloc(int,nr_pair);
+		int *pair_j = Malloc(int,nr_pair);
+		int p = 0;
+		for(i=0;i<nr_class;i++)
+			for(int j=i+1;j<nr_class;j++)
+			{
+				pair_i[p] = i;
+				pair_j[p] = j;
+				++p;
+			}
+
 		bool *nonzero = Malloc(bool,l);
 		for(i=0;i<l;i++)
 			nonzero[i] = false;
-		decision_function *f = Malloc(decision_function,nr_class*(nr_class-1)/2);
+		decision_function *f = Malloc(decision_function,nr_pair);
 
 		double *probA=NULL,*probB=NULL;
 		if (param->probability)
 		{
-			probA=Malloc(double,nr_class*(nr_class-1)/2);
-			probB=Malloc(double,nr_class*(nr_class-1)/2);
-		}
-
-		int p = 0;
-		for(i=0;i<nr_class;i++)
-			for(int j=i+1;j<nr_class;j++)
+			probA=Malloc(double,nr_pair);
+			probB=Malloc(double,nr_pair);
+			// sequential: the folds are drawn with rand()
+			for(p=0;p<nr_pair;p++)
 			{
 				svm_problem sub_prob;
-				int si = start[i], sj = start[j];
-				int ci = count[i], cj = count[j];
-				sub_prob.l = ci+cj;
-				sub_prob.x = Malloc(svm_node *,sub_prob.l);
-				sub_prob.y = Malloc(double,sub_prob.l);
-				int k;
-				for(k=0;k<ci;k++)
-				{
-					sub_prob.x[k] = x[si+k];
-					sub_prob.y[k] = +1;
-				}
-				for(k=0;k<cj;k++)
-				{
-					sub_prob.x[ci+k] = x[sj+k];
-					sub_prob.y[ci+k] = -1;
-				}
-
-				if(param->probability)
-					svm_binary_svc_probability(&sub_prob,param,weighted_C[i],weighted_C[j],probA[p],probB[p]);
-
-				f[p] = svm_train_one(&sub_prob,param,weighted_C[i],weighted_C[j]);
-				for(k=0;k<ci;k++)
-					if(!nonzero[si+k] && fabs(f[p].alpha[k]) > 0)
-						nonzero[si+k] = true;
-				for(k=0;k<cj;k++)
-					if(!nonzero[sj+k] && fabs(f[p].alpha[ci+k]) > 0)
-						nonzero[sj+k] = true;
+				svm_pair_problem(x,start,count,pair_i[p],pair_j[p],&sub_prob);
+				svm_binary_svc_probability(&sub_prob,param,weighted_C[pair_i[p]],weighted_C[pair_j[p]],probA[p],probB[p]);
 				free(sub_prob.x);
 				free(sub_prob.y);
-				++p;
 			}
+		}
+
+		// The pairs are independent and are solved in parallel, each
+		// with its own kernel cache of cache_size/nr_thread MB; each
+		// solution is the same as in the sequential order.
+		svm_parameter pair_param = *param;
+#ifdef _OPENMP
+		int nr_thread = min(omp_get_max_threads(), nr_pair);
+		if(nr_thread > 1)
+			pair_param.cache_size = param->cache_size/nr_thread;
+#pragma omp parallel for schedule(dynamic) if(nr_thread > 1)
+#endif
+		for(p=0;p<nr_pair;p++)
+		{
+			svm_problem sub_prob;
+			svm_pair_problem(x,start,count,pair_i[p],pair_j[p],&sub_prob);
+			f[p] = svm_train_one(&sub_prob,&pair_param,weighted_C[pair_i[p]],weighted_C[pair_j[p]]);
+			free(sub_prob.x);
+			free(sub_prob.y);
+		}
+
+		for(p=0;p<nr_pair;p++)
+		{
+			int si = start[pair_i[p]], sj = start[pair_j[p]];
+			int ci = count[pair_i[p]], cj = count[pair_j[p]];
+			int k;
+			for(k=0;k<ci;k++)
+				if(!nonzero[si+k] && fabs(f[p].alpha[k]) > 0)
+					nonzero[si+k] = true;
+			for(k=0;k<cj;k++)
+				if(!nonzero[sj+k] && fabs(f[p].alpha[ci+k]) > 0)
+					nonzero[sj+k] = true;
+		}
 
 		// build output
 
@@ -2331,6 +2527,8 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 		free(f);
 		free(nz_count);
 		free(nz_start);
+		free(pair_i);
+		free(pair_j);
 	}
 	return model;
 }
@@ -2498,7 +2696,9 @@ double svm_get_svr_probability(const svm_model *model)
 	}
 }
 
-double svm_predict_values(const svm_model *model, const svm_node *x, double* dec_values)
+// Decision values and prediction from the kernel values kvalue[i] =
+// K(x,SV[i]) of a test vector x
+static double svm_predict_kvalue(const svm_model *model, const double *kvalue, double* dec_values)
 {
 	int i;
 	if(model->param.svm_type == ONE_CLASS ||
@@ -2508,7 +2708,7 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 		double *sv_coef = model->sv_coef[0];
 		double sum = 0;
 		for(i=0;i<model->l;i++)
-			sum += sv_coef[i] * Kernel::k_function(x,model->SV[i],model->param);
+			sum += sv_coef[i] * kvalue[i];
 		sum -= model->rho[0];
 		*dec_values = sum;
 
@@ -2520,11 +2720,6 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 	else
 	{
 		int nr_class = model->nr_class;
-		int l = model->l;
-		
-		double *kvalue = Malloc(double,l);
-		for(i=0;i<l;i++)
-			kvalue[i] = Kernel::k_function(x,model->SV[i],model->param);
 
 		int *start = Malloc(int,nr_class);
 		start[0] = 0;
@@ -2567,13 +2762,73 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 			if(vote[i] > vote[vote_max_idx])
 				vote_max_idx = i;
 
-		free(kvalue);
 		free(start);
 		free(vote);
 		return model->label[vote_max_idx];
 	}
 }
 
+static int svm_nr_dec_values(const svm_model *model)
+{
+	if(model->param.svm_type == ONE_CLASS ||
+	   model->param.svm_type == EPSILON_SVR ||
+	   model->param.svm_type == NU_SVR)
+		return 1;
+	else
+		return model->nr_class*(model->nr_class-1)/2;
+}
+
+double svm_predict_values(const svm_model *model, const svm_node *x, double* dec_values)
+{
+	int l = model->l;
+	double *kvalue = Malloc(double,l);
+	for(int i=0;i<l;i++)
+		kvalue[i] = Kernel::k_function(x,model->SV[i],model->param);
+	double pred_result = svm_predict_kvalue(model, kvalue, dec_values);
+	free(kvalue);
+	return pred_result;
+}
+
+// Size of the test-SV kernel block of svm_predict_values_batch
+#define KVALUE_BLOCK_SIZE (32<<20)
+
+void svm_predict_values_batch(const svm_model *model, const svm_node *const *x, int n,
+	double* dec_values, double* pred_results)
+{
+	int l = max(model->l, 1);
+	int nr_dec = svm_nr_dec_values(model);
+	int block = (int)min((long int)n, max(1L, (long int)(KVALUE_BLOCK_SIZE/(sizeof(double)*l))));
+	if(block <= 0)
+		return;
+	double *kvalue = Malloc(double,(long int)block*l);
+	double *dec_block = dec_values ? NULL : Malloc(double,(long int)block*max(nr_dec,1));
+
+	for(int b=0;b<n;b+=block)
+	{
+		int nb = min(block, n-b);
+		// kernel block K(x[b+i],SV[k]), all the pairs in parallel
+		long int nk = (long int)nb*model->l;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(guided)
+#endif
+		for(long int t=0;t<nk;t++)
+		{
+			long int i = t/model->l, k = t%model->l;
+			kvalue[i*l+k] = Kernel::k_function(x[b+i],model->SV[k],model->param);
+		}
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+		for(int i=0;i<nb;i++)
+		{
+			double *dec = dec_values ? dec_values+(long int)(b+i)*nr_dec : dec_block+(long int)i*nr_dec;
+			pred_results[b+i] = svm_predict_kvalue(model, kvalue+(long int)i*l, dec);
+		}
+	}
+	free(kvalue);
+	free(dec_block);
+}
+
 double svm_predict(const svm_model *model, const svm_node *x)
 {
 	int nr_class = model->nr_class;
@@ -3155,6 +3410,21 @@ int svm_check_probability_model(const svm_model *model)
 		 model->probA!=NULL);
 }
 
+void svm_set_cache_format(int format)
+{
+	cache_format = format;
+}
+
+void svm_get_cache_stats(struct svm_cache_stats *stats)
+{
+	*stats = cache_stats;
+}
+
+void svm_reset_cache_stats()
+{
+	cache_stats.hit = cache_stats.miss = cache_stats.eviction = 0;
+}
+
 void svm_set_print_string_function(void (*print_func)(const char *))
 {
 	if(print_func == NULL)
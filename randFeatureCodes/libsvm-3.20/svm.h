@@ -24,6 +24,7 @@ struct svm_problem
 
 enum { C_SVC, NU_SVC, ONE_CLASS, EPSILON_SVR, NU_SVR };	/* svm_type */
 enum { LINEAR, POLY, RBF, SIGMOID, PRECOMPUTED }; /* kernel_type */
+enum { CACHE_FLOAT, CACHE_FP16, CACHE_BF16 };	/* cache format */
 
 struct svm_parameter
 {
@@ -85,6 +86,7 @@ int svm_get_nr_sv(const struct svm_model *model);
 double svm_get_svr_probability(const struct svm_model *model);
 
 double svm_predict_values(const struct svm_model *model, const struct svm_node *x, double* dec_values);
+void svm_predict_values_batch(const struct svm_model *model, const struct svm_node *const *x, int n, double* dec_values, double* pred_results);
 double svm_predict(const struct svm_model *model, const struct svm_node *x);
 double svm_predict_probability(const struct svm_model *model, const struct svm_node *x, double* prob_estimates);
 
@@ -97,6 +99,18 @@ int svm_check_probability_model(const struct svm_model *model);
 
 void svm_set_print_string_function(void (*print_func)(const char *));
 
+/* kernel cache of the solvers */
+struct svm_cache_stats
+{
+	long int hit;		/* columns found in the cache */
+	long int miss;		/* columns (partly) computed */
+	long int eviction;	/* columns removed to make room or by shrinking */
+};
+
+void svm_set_cache_format(int format);
+void svm_get_cache_stats(struct svm_cache_stats *stats);
+void svm_reset_cache_stats(void);
+
 #ifdef __cplusplus
 }
 #endif